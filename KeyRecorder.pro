@@ -1,8 +1,31 @@
-QT       += core gui concurrent
+QT       += core gui concurrent network
 
 win32 {
     LIBS += -lUser32
     LIBS += -lwinmm
+
+    # 录制和播放界面只支持 Windows, 其他系统只编译命令行功能
+    SOURCES += \
+        mainwindow.cpp \
+        sendinputemitter.cpp
+
+    HEADERS += \
+        mainwindow.h \
+        sendinputemitter.h
+
+    FORMS += \
+        mainwindow.ui
+}
+
+linux {
+    # XTest 发送后端, 需要 libx11-dev 和 libxtst-dev
+    LIBS += -lX11 -lXtst
+
+    SOURCES += \
+        x11emitter.cpp
+
+    HEADERS += \
+        x11emitter.h
 }
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
@@ -14,15 +37,67 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    actionlog.cpp \
+    actiontransform.cpp \
+    commandline.cpp \
+    eventbus.cpp \
+    inputemitter.cpp \
+    loopbackemitter.cpp \
+    macroprogram.cpp \
     main.cpp \
-    mainwindow.cpp
+    metricsserver.cpp \
+    multitrackplayer.cpp \
+    playbackclock.cpp \
+    playbackscheduler.cpp \
+    playbackstats.cpp \
+    recordbatch.cpp \
+    recordcompactor.cpp \
+    recorddirwatcher.cpp \
+    recordeditor.cpp \
+    recorderstats.cpp \
+    recordfile.cpp \
+    recordgenerator.cpp \
+    recordpipeline.cpp \
+    recordplayer.cpp \
+    recordsequencer.cpp \
+    recordverifier.cpp \
+    timelinepyramid.cpp \
+    timelinewidget.cpp \
+    timingprofile.cpp \
+    timingwheel.cpp \
+    tracer.cpp
 
 HEADERS += \
+    actionlog.h \
+    actiontransform.h \
+    commandline.h \
+    eventbus.h \
+    heldkeytracker.h \
+    inputemitter.h \
     key_map.h \
-    mainwindow.h
-
-FORMS += \
-    mainwindow.ui
+    loopbackemitter.h \
+    macroprogram.h \
+    metricsserver.h \
+    multitrackplayer.h \
+    playbackclock.h \
+    playbackscheduler.h \
+    playbackstats.h \
+    recordbatch.h \
+    recordcompactor.h \
+    recorddirwatcher.h \
+    recordeditor.h \
+    recorderstats.h \
+    recordfile.h \
+    recordgenerator.h \
+    recordpipeline.h \
+    recordplayer.h \
+    recordsequencer.h \
+    recordverifier.h \
+    timelinepyramid.h \
+    timelinewidget.h \
+    timingprofile.h \
+    timingwheel.h \
+    tracer.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,90 @@
+#include "actionlog.h"
+
+ActionChunkPool::ActionChunkPool(int maxFree)
+    : m_maxFree(maxFree)
+{
+}
+
+ActionChunkPool::~ActionChunkPool(){
+    for(ActionChunk *chunk : m_free){
+        delete chunk;
+    }
+}
+
+void ActionChunkPool::reserve(int count){
+    while(int(m_free.size()) < count){
+        m_free.push_back(new ActionChunk);
+    }
+}
+
+ActionChunk *ActionChunkPool::acquire(){
+    if(m_free.empty()){
+        return new ActionChunk;
+    }
+
+    ActionChunk *chunk = m_free.back();
+    m_free.pop_back();
+    return chunk;
+}
+
+void ActionChunkPool::release(ActionChunk *chunk){
+    if(int(m_free.size()) >= m_maxFree){
+        delete chunk;
+        return;
+    }
+
+    chunk->count = 0;
+    chunk->next = nullptr;
+    m_free.push_back(chunk);
+}
+
+ActionLog::ActionLog(ActionChunkPool *pool)
+    : m_pool(pool)
+{
+}
+
+ActionLog::~ActionLog(){
+    clear();
+}
+
+void ActionLog::addChunk(){
+    ActionChunk *chunk = m_pool->acquire();
+    if(m_tail){
+        m_tail->next = chunk;
+    }else{
+        m_head = chunk;
+    }
+    m_tail = chunk;
+    m_chunkCount++;
+}
+
+void ActionLog::clear(){
+    ActionChunk *chunk = m_head;
+    while(chunk){
+        ActionChunk *next = chunk->next;
+        m_pool->release(chunk);
+        chunk = next;
+    }
+
+    m_head = m_tail = nullptr;
+    m_size = 0;
+    m_chunkCount = 0;
+    m_firstX = m_firstY = 0;
+}
+
+bool ActionLog::save(const QString &filePath, RecordFormat format, QString *errorMsg) const{
+    RecordWriter writer;
+    if(!writer.open(filePath, format, m_firstX, m_firstY, errorMsg)){
+        return false;
+    }
+
+    for(const ActionInfo &actionInfo : *this){
+        writer.write(actionInfo);
+    }
+
+    if(!writer.close(errorMsg)){
+        writer.discard();
+        return false;
+    }
+    return true;
+}
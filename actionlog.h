@@ -0,0 +1,116 @@
+#ifndef ACTIONLOG_H
+#define ACTIONLOG_H
+
+#include "recordfile.h"
+
+#include <vector>
+
+// 日志块的大小, 每块 ACTION_CHUNK_SIZE 个操作
+#define ACTION_CHUNK_SIZE 2048
+
+// 日志块: 固定数量的操作, 串成单向链表
+struct ActionChunk
+{
+    ActionInfo actions[ACTION_CHUNK_SIZE];
+    int count = 0;
+    ActionChunk *next = nullptr;
+};
+
+// 可复用的日志块池, 日志清空时块归还到池中, 下一次录制直接取用, 不再分配内存
+// 不加锁, 与使用它的日志在同一把锁内访问
+class ActionChunkPool
+{
+public:
+    // maxFree 为池中最多保留的空闲块数, 超出的块直接释放
+    explicit ActionChunkPool(int maxFree = 64);
+    ~ActionChunkPool();
+
+    // 预先分配块, 使开始录制后的前 count 块不需要分配内存
+    void reserve(int count);
+
+    ActionChunk *acquire();
+    void release(ActionChunk *chunk);
+
+    int freeCount() const { return int(m_free.size()); }
+
+private:
+    std::vector<ActionChunk *> m_free;
+    int m_maxFree;
+};
+
+// 录制时内存中的操作日志
+// 追加为 O(1): 写入当前块的下一个位置, 块满时从池中取一个新块接在后面, 已有的数据从不移动或复制
+// 保存时按顺序遍历
+class ActionLog
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const ActionChunk *chunk, int index) : m_chunk(chunk), m_index(index) {}
+
+        const ActionInfo &operator*() const { return m_chunk->actions[m_index]; }
+        const ActionInfo *operator->() const { return &m_chunk->actions[m_index]; }
+        const_iterator &operator++(){
+            if(++m_index == m_chunk->count && m_chunk->next){
+                m_chunk = m_chunk->next;
+                m_index = 0;
+            }
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const { return m_chunk == other.m_chunk && m_index == other.m_index; }
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+    private:
+        const ActionChunk *m_chunk;
+        int m_index;
+    };
+
+    explicit ActionLog(ActionChunkPool *pool);
+    // 所有块归还到池中
+    ~ActionLog();
+
+    ActionLog(const ActionLog &) = delete;
+    ActionLog &operator=(const ActionLog &) = delete;
+
+    // 录制开始时的鼠标位置
+    void setInitialPos(int x, int y) { m_firstX = x, m_firstY = y; }
+    int firstX() const { return m_firstX; }
+    int firstY() const { return m_firstY; }
+
+    void append(const ActionInfo &actionInfo){
+        if(!m_tail || m_tail->count == ACTION_CHUNK_SIZE){
+            addChunk();
+        }
+        m_tail->actions[m_tail->count++] = actionInfo;
+        m_size++;
+    }
+
+    // 清空日志, 块归还到池中
+    void clear();
+
+    qint64 size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    // 已写入和已占用的字节数
+    qint64 usedBytes() const { return m_size * qint64(sizeof(ActionInfo)); }
+    qint64 allocatedBytes() const { return m_chunkCount * qint64(sizeof(ActionChunk)); }
+
+    const_iterator begin() const { return m_head && m_head->count > 0 ? const_iterator(m_head, 0) : end(); }
+    const_iterator end() const { return m_tail ? const_iterator(m_tail, m_tail->count) : const_iterator(nullptr, 0); }
+
+    // 保存为录制文件
+    bool save(const QString &filePath, RecordFormat format = RECORD_FORMAT_TEXT, QString *errorMsg = nullptr) const;
+
+private:
+    void addChunk();
+
+    ActionChunkPool *m_pool;
+    ActionChunk *m_head = nullptr;
+    ActionChunk *m_tail = nullptr;
+    qint64 m_size = 0;
+    int m_chunkCount = 0;
+    int m_firstX = 0;
+    int m_firstY = 0;
+};
+
+#endif // ACTIONLOG_H
@@ -0,0 +1,226 @@
+#include "actiontransform.h"
+#include "key_map.h"
+
+#include <QFile>
+#include <QTextStream>
+
+bool DynamicTransformChain::apply(ActionInfo &actionInfo){
+    for(const std::unique_ptr<ActionTransform> &stage : m_stages){
+        if(!stage->apply(actionInfo)){
+            return false;
+        }
+    }
+    return true;
+}
+
+void DynamicTransformChain::reset(){
+    for(const std::unique_ptr<ActionTransform> &stage : m_stages){
+        stage->reset();
+    }
+}
+
+qint64 DynamicTransformChain::duration(qint64 sourceDuration) const{
+    for(const std::unique_ptr<ActionTransform> &stage : m_stages){
+        sourceDuration = stage->duration(sourceDuration);
+    }
+    return sourceDuration;
+}
+
+// 按键名称转为类型和按键码
+static bool parseKeyName(const QString &name, ActionType *type, int *keyCode){
+    short code = findMouseButton(name);
+    if(code >= 0){
+        *type = ACTION_MOUSE_BUTTON;
+        *keyCode = code;
+        return true;
+    }
+    code = findScanCode(name);
+    if(code >= 0){
+        *type = ACTION_KEYBOARD;
+        *keyCode = code;
+        return true;
+    }
+    return false;
+}
+
+bool loadTransformFile(const QString &filePath, QList<TransformRule> *rules, QString *errorMsg){
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法打开文件:" + filePath;
+        }
+        return false;
+    }
+
+    rules->clear();
+
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while(!in.atEnd()){
+        QString line = in.readLine().trimmed();
+        lineNumber++;
+
+        // 空行和注释
+        if(line.isEmpty() || line.startsWith('#')){
+            continue;
+        }
+
+        // 按键名称可能包含空格, 只按第一个空格分开规则名称和参数
+        int spaceIndex = line.indexOf(' ');
+        QString name = spaceIndex < 0 ? line : line.left(spaceIndex);
+        QString argument = spaceIndex < 0 ? QString() : line.mid(spaceIndex + 1).trimmed();
+
+        auto fail = [&](const QString &reason){
+            if(errorMsg){
+                *errorMsg = QString("%1 第%2行%3: %4").arg(filePath).arg(lineNumber).arg(reason, line);
+            }
+            return false;
+        };
+
+        TransformRule rule;
+        if(name == "drop"){
+            rule.kind = TransformRule::DROP;
+            if(argument == MOUSE_MOVE_NAME){
+                rule.type = ACTION_MOUSE_MOVE;
+            }else if(!parseKeyName(argument, &rule.type, &rule.keyCode)){
+                return fail("未知按键");
+            }
+        }else if(name == "remap"){
+            rule.kind = TransformRule::REMAP;
+            int arrowIndex = argument.indexOf("->");
+            if(arrowIndex < 0
+                || !parseKeyName(argument.left(arrowIndex).trimmed(), &rule.type, &rule.keyCode)
+                || !parseKeyName(argument.mid(arrowIndex + 2).trimmed(), &rule.toType, &rule.toKeyCode)){
+                return fail("映射格式应为 \"remap 按键 -> 按键\"");
+            }
+        }else if(name == "time-scale" || name == "mouse-scale" || name == "offset-ms"){
+            bool ok;
+            rule.value = argument.toDouble(&ok);
+            if(!ok){
+                return fail("参数不是数字");
+            }
+            if(name == "offset-ms"){
+                rule.kind = TransformRule::TIME_OFFSET;
+                rule.value *= 1000000;
+            }else if(rule.value <= 0){
+                return fail("倍数必须大于0");
+            }else{
+                rule.kind = name == "time-scale" ? TransformRule::TIME_SCALE : TransformRule::MOUSE_SCALE;
+            }
+        }else{
+            return fail("未知规则");
+        }
+
+        rules->append(rule);
+    }
+
+    return true;
+}
+
+// 把一条规则加到对应的步骤, 同类规则叠加
+static void configure(DropKeysStage &stage, const TransformRule &rule){
+    if(rule.type == ACTION_MOUSE_MOVE){
+        stage.dropMouseMoves();
+    }else{
+        stage.dropKey(rule.type, rule.keyCode);
+    }
+}
+
+static void configure(RemapStage &stage, const TransformRule &rule){
+    stage.remap(rule.type, rule.keyCode, rule.toType, rule.toKeyCode);
+}
+
+static void configure(TimeScaleStage &stage, const TransformRule &rule){
+    stage.setScale(stage.scale() * rule.value);
+}
+
+static void configure(TimeOffsetStage &stage, const TransformRule &rule){
+    stage.setOffset(stage.offset() + qint64(rule.value));
+}
+
+static void configure(MouseScaleStage &stage, const TransformRule &rule){
+    stage.setScale(stage.scale() * rule.value);
+}
+
+// 用 func 处理规则对应类型的步骤
+template<class Func>
+static void withStageType(TransformRule::Kind kind, Func &&func){
+    switch(kind){
+    case TransformRule::DROP:
+        func(DropKeysStage());
+        break;
+    case TransformRule::REMAP:
+        func(RemapStage());
+        break;
+    case TransformRule::TIME_SCALE:
+        func(TimeScaleStage());
+        break;
+    case TransformRule::TIME_OFFSET:
+        func(TimeOffsetStage());
+        break;
+    case TransformRule::MOUSE_SCALE:
+        func(MouseScaleStage());
+        break;
+    }
+}
+
+std::unique_ptr<ActionTransform> makeTransform(const QList<TransformRule> &rules){
+    if(rules.isEmpty()){
+        return nullptr;
+    }
+
+    // 规则类型的值与 StandardTransformChain 中的顺序相同, 相邻的同类规则为一组, 各组类型递增时可以使用编译时组合
+    bool standardOrder = true;
+    for(int i = 1; i < rules.size(); i++){
+        if(rules[i].kind < rules[i - 1].kind){
+            standardOrder = false;
+            break;
+        }
+    }
+
+    if(standardOrder){
+        auto transform = std::make_unique<TransformAdapter<StandardTransformChain>>();
+        StandardTransformChain &chain = transform->transform();
+        for(const TransformRule &rule : rules){
+            withStageType(rule.kind, [&](auto stageType){
+                configure(chain.stage<decltype(stageType)>(), rule);
+            });
+        }
+        return transform;
+    }
+
+    auto transform = std::make_unique<DynamicTransformChain>();
+    for(int first = 0; first < rules.size();){
+        int last = first;
+        while(last + 1 < rules.size() && rules[last + 1].kind == rules[first].kind){
+            last++;
+        }
+
+        withStageType(rules[first].kind, [&](auto stageType){
+            auto stage = std::make_unique<TransformAdapter<decltype(stageType)>>();
+            for(int i = first; i <= last; i++){
+                configure(stage->transform(), rules[i]);
+            }
+            transform->append(std::move(stage));
+        });
+
+        first = last + 1;
+    }
+    return transform;
+}
+
+RecordData transformRecord(const RecordData &data, ActionTransform *transform){
+    RecordData result;
+    result.name = data.name;
+    result.firstX = data.firstX;
+    result.firstY = data.firstY;
+    result.actionList.reserve(data.actionList.size());
+
+    transform->reset();
+    for(ActionInfo actionInfo : data.actionList){
+        if(transform->apply(actionInfo)){
+            result.actionList.append(actionInfo);
+        }
+    }
+    return result;
+}
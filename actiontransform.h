@@ -0,0 +1,259 @@
+#ifndef ACTIONTRANSFORM_H
+#define ACTIONTRANSFORM_H
+
+#include "heldkeytracker.h"
+#include "recordfile.h"
+
+#include <QList>
+#include <QString>
+
+#include <bitset>
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#define TRANSFORM_SUFFIX ".transform"
+
+// 播放时对每个操作做的变换, 不需要改写录制文件
+// 每一步是一个带 apply 的类, 返回false时丢弃该操作; 常用的顺序在编译时组合为 TransformChain, 调用全部内联
+// 规则顺序不同时由 DynamicTransformChain 在运行时按顺序调用, 每一步一次虚函数调用
+// 处理操作时不分配内存, 所有表在配置时准备好
+
+// 丢弃指定的按键, 或所有鼠标移动
+class DropKeysStage
+{
+public:
+    void dropKey(ActionType type, int keyCode){
+        m_drop.set(bitOf(type, keyCode));
+    }
+    void dropMouseMoves() { m_dropMoves = true; }
+
+    bool apply(ActionInfo &actionInfo) const{
+        if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+            return !m_dropMoves;
+        }
+        return !m_drop.test(bitOf(actionInfo.actionType, actionInfo.keyCode));
+    }
+    void reset() {}
+    qint64 duration(qint64 sourceDuration) const { return sourceDuration; }
+
+private:
+    // 与 HeldKeyTracker 使用相同的位置
+    static int bitOf(ActionType type, int keyCode){
+        return type == ACTION_KEYBOARD ? (keyCode & 0xFF) : HELD_MOUSE_BASE + (keyCode & 0x07);
+    }
+
+    std::bitset<HELD_KEY_BITS> m_drop;
+    bool m_dropMoves = false;
+};
+
+// 按键映射, 可以把键盘按键映射为鼠标按键, 反之亦然
+class RemapStage
+{
+public:
+    RemapStage(){
+        for(Target &target : m_targets){
+            target.type = -1;
+        }
+    }
+
+    void remap(ActionType fromType, int fromCode, ActionType toType, int toCode){
+        m_targets[indexOf(fromType, fromCode)] = Target{qint8(toType), qint16(toCode)};
+    }
+
+    bool apply(ActionInfo &actionInfo) const{
+        if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+            return true;
+        }
+        const Target &target = m_targets[indexOf(actionInfo.actionType, actionInfo.keyCode)];
+        if(target.type >= 0){
+            actionInfo.actionType = ActionType(target.type);
+            actionInfo.keyCode = target.code;
+        }
+        return true;
+    }
+    void reset() {}
+    qint64 duration(qint64 sourceDuration) const { return sourceDuration; }
+
+private:
+    struct Target
+    {
+        qint8 type;// 映射后的类型, -1 表示不映射
+        qint16 code;
+    };
+
+    static int indexOf(ActionType type, int keyCode){
+        return type == ACTION_KEYBOARD ? (keyCode & 0xFF) : HELD_MOUSE_BASE + (keyCode & 0x07);
+    }
+
+    Target m_targets[HELD_KEY_BITS];
+};
+
+// 时间缩放, 大于1时变慢
+class TimeScaleStage
+{
+public:
+    void setScale(double scale) { m_scale = scale; }
+    double scale() const { return m_scale; }
+
+    bool apply(ActionInfo &actionInfo) const{
+        actionInfo.actionTime = qint64(actionInfo.actionTime * m_scale);
+        return true;
+    }
+    void reset() {}
+    qint64 duration(qint64 sourceDuration) const { return qint64(sourceDuration * m_scale); }
+
+private:
+    double m_scale = 1.0;
+};
+
+// 所有操作推迟(或提前) offset ns, 提前到0之前的操作在0发送
+class TimeOffsetStage
+{
+public:
+    void setOffset(qint64 offset) { m_offset = offset; }
+    qint64 offset() const { return m_offset; }
+
+    bool apply(ActionInfo &actionInfo) const{
+        actionInfo.actionTime = qMax<qint64>(0, actionInfo.actionTime + m_offset);
+        return true;
+    }
+    void reset() {}
+    qint64 duration(qint64 sourceDuration) const { return qMax<qint64>(0, sourceDuration + m_offset); }
+
+private:
+    qint64 m_offset = 0;
+};
+
+// 鼠标移动量缩放, 不足1像素的部分累积到下一次移动, 总移动量不会因为取整而偏移
+// 缩放后移动量为0的操作被丢弃
+class MouseScaleStage
+{
+public:
+    void setScale(double scale) { m_scale = scale; }
+    double scale() const { return m_scale; }
+
+    bool apply(ActionInfo &actionInfo){
+        if(actionInfo.actionType != ACTION_MOUSE_MOVE || m_scale == 1.0){
+            return true;
+        }
+        double x = actionInfo.dx * m_scale + m_restX;
+        double y = actionInfo.dy * m_scale + m_restY;
+        actionInfo.dx = int(std::lround(x));
+        actionInfo.dy = int(std::lround(y));
+        m_restX = x - actionInfo.dx;
+        m_restY = y - actionInfo.dy;
+        return actionInfo.dx != 0 || actionInfo.dy != 0;
+    }
+    // 每轮开始时清除累积的余数
+    void reset() { m_restX = m_restY = 0; }
+    qint64 duration(qint64 sourceDuration) const { return sourceDuration; }
+
+private:
+    double m_scale = 1.0;
+    double m_restX = 0;
+    double m_restY = 0;
+};
+
+// 编译时组合的变换, 按模板参数的顺序调用, 任一步丢弃后不再调用后面的步骤
+template<class... Stages>
+class TransformChain
+{
+public:
+    bool apply(ActionInfo &actionInfo){
+        return std::apply([&](Stages &...stages){ return (stages.apply(actionInfo) && ...); }, m_stages);
+    }
+    void reset(){
+        std::apply([](Stages &...stages){ (stages.reset(), ...); }, m_stages);
+    }
+    qint64 duration(qint64 sourceDuration) const{
+        std::apply([&](const Stages &...stages){ ((sourceDuration = stages.duration(sourceDuration)), ...); }, m_stages);
+        return sourceDuration;
+    }
+
+    template<class Stage>
+    Stage &stage() { return std::get<Stage>(m_stages); }
+
+private:
+    std::tuple<Stages...> m_stages;
+};
+
+// 最常用的顺序: 丢弃 -> 映射 -> 时间缩放 -> 时间偏移 -> 鼠标缩放
+using StandardTransformChain = TransformChain<DropKeysStage, RemapStage, TimeScaleStage, TimeOffsetStage, MouseScaleStage>;
+
+// 播放器使用的变换接口, 整个变换一次虚函数调用
+class ActionTransform
+{
+public:
+    virtual ~ActionTransform() = default;
+
+    // 变换一个操作, 返回false表示丢弃
+    virtual bool apply(ActionInfo &actionInfo) = 0;
+    // 每轮播放开始时调用
+    virtual void reset() {}
+    // 变换后一轮的时长
+    virtual qint64 duration(qint64 sourceDuration) const { return sourceDuration; }
+};
+
+// 把一个步骤或编译时组合的变换包装为 ActionTransform
+template<class Transform>
+class TransformAdapter : public ActionTransform
+{
+public:
+    Transform &transform() { return m_transform; }
+
+    bool apply(ActionInfo &actionInfo) override { return m_transform.apply(actionInfo); }
+    void reset() override { m_transform.reset(); }
+    qint64 duration(qint64 sourceDuration) const override { return m_transform.duration(sourceDuration); }
+
+private:
+    Transform m_transform;
+};
+
+// 运行时按顺序组合的变换
+class DynamicTransformChain : public ActionTransform
+{
+public:
+    void append(std::unique_ptr<ActionTransform> stage) { m_stages.push_back(std::move(stage)); }
+    int stageCount() const { return int(m_stages.size()); }
+
+    bool apply(ActionInfo &actionInfo) override;
+    void reset() override;
+    qint64 duration(qint64 sourceDuration) const override;
+
+private:
+    std::vector<std::unique_ptr<ActionTransform>> m_stages;
+};
+
+// 变换文件中的一条规则
+struct TransformRule
+{
+    enum Kind
+    {
+        DROP,           // drop <按键名称>, 或 drop mouseMove
+        REMAP,          // remap <按键名称> -> <按键名称>
+        TIME_SCALE,     // time-scale <倍数>
+        TIME_OFFSET,    // offset-ms <毫秒>
+        MOUSE_SCALE     // mouse-scale <倍数>
+    };
+
+    Kind kind;
+    ActionType type = ACTION_KEYBOARD;// 按键, 鼠标移动表示所有鼠标移动
+    int keyCode = 0;
+    ActionType toType = ACTION_KEYBOARD;// 映射后的按键
+    int toKeyCode = 0;
+    double value = 0;// 倍数, 或偏移 ns
+};
+
+// 读取变换文件, 每行一条规则, 以#开头的行为注释
+bool loadTransformFile(const QString &filePath, QList<TransformRule> *rules, QString *errorMsg = nullptr);
+
+// 由规则生成变换, 没有规则时返回空
+// 相邻的同类规则合并为一步; 各步符合 StandardTransformChain 的顺序时使用编译时组合, 否则按规则顺序在运行时组合
+std::unique_ptr<ActionTransform> makeTransform(const QList<TransformRule> &rules);
+
+// 对整个录制做一次变换, 用于保存或与播放结果比较
+RecordData transformRecord(const RecordData &data, ActionTransform *transform);
+
+#endif // ACTIONTRANSFORM_H
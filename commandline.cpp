@@ -0,0 +1,1325 @@
+#include "commandline.h"
+#include "actiontransform.h"
+#include "eventbus.h"
+#include "loopbackemitter.h"
+#include "macroprogram.h"
+#include "metricsserver.h"
+#include "playbackclock.h"
+#include "playbackscheduler.h"
+#include "recordbatch.h"
+#include "recordcompactor.h"
+#include "recordeditor.h"
+#include "recordgenerator.h"
+#include "recordsequencer.h"
+#include "recordverifier.h"
+#include "timingprofile.h"
+#include "timelinewidget.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QPainter>
+#include <QScopedPointer>
+#include <QThread>
+#include <QTextStream>
+
+#include <cmath>
+#include <cstdio>
+
+#ifdef Q_OS_WIN
+#include "sendinputemitter.h"
+
+#include <windows.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include "x11emitter.h"
+
+#include <csignal>
+#endif
+
+// 子命令
+struct CommandInfo
+{
+    const char *name;// 命令名称
+    const char *description;// 命令说明
+    int (*func)(const QStringList &arguments);// 参数第一项为程序名, 已去掉命令名称
+    bool gui = false;// 是否需要绘图, 需要时创建 QGuiApplication, 可用 -platform offscreen 在无窗口环境运行
+};
+
+static QTextStream &out(){
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+static QTextStream &err(){
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+// 读取毫秒参数并转为 ns
+static qint64 msOption(const QCommandLineParser &parser, const QString &name, qint64 defaultNs){
+    if(!parser.isSet(name)){
+        return defaultNs;
+    }
+    return qint64(parser.value(name).toDouble() * 1000000);
+}
+
+// 读取数值参数并检查范围, minimumExclusive 为 true 时不允许等于 minimum, 不符合时输出错误
+static bool rangeOption(const QCommandLineParser &parser, const QString &name, double minimum, double maximum,
+                        bool minimumExclusive, double *value){
+    bool ok = false;
+    *value = parser.value(name).toDouble(&ok);
+    if(!ok || !std::isfinite(*value)){
+        err() << "--" << name << " 不是数字: " << parser.value(name) << Qt::endl;
+        return false;
+    }
+    if(*value < minimum || (minimumExclusive && *value == minimum) || *value > maximum){
+        err() << "--" << name << " 超出范围 " << (minimumExclusive ? "(" : "[") << minimum << ", " << maximum << "]: "
+              << parser.value(name) << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+// 精简录制文件
+static int compactCommand(const QStringList &arguments){
+    CompactOptions options;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("按规则精简录制文件, 输出每条规则的精简结果");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件");
+    parser.addPositionalArgument("output", "精简后的文件, 省略时只输出报告");
+    parser.addOption({"chatter-ms", "按键抖动阈值, 0表示不启用", "ms", QString::number(options.chatterThreshold / 1000000.0)});
+    parser.addOption({"jitter-ms", "鼠标抖动时间窗口, 0表示不启用", "ms", QString::number(options.jitterWindow / 1000000.0)});
+    parser.addOption({"lead-ms", "开头最多保留的空闲时长, 0表示不启用", "ms", QString::number(options.maxLeadingIdle / 1000000.0)});
+    parser.addOption({"max-gap-ms", "操作之间最多保留的空闲时长, 0表示不启用", "ms", QString::number(options.maxIdleGap / 1000000.0)});
+    parser.addOption({"keep-trailing-moves", "保留最后一个按键操作之后的鼠标移动"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    options.chatterThreshold = msOption(parser, "chatter-ms", options.chatterThreshold);
+    options.jitterWindow = msOption(parser, "jitter-ms", options.jitterWindow);
+    options.maxLeadingIdle = msOption(parser, "lead-ms", options.maxLeadingIdle);
+    options.maxIdleGap = msOption(parser, "max-gap-ms", options.maxIdleGap);
+    options.trimTrailingMoves = !parser.isSet("keep-trailing-moves");
+
+    RecordData data;
+    QString errorMsg;
+    if(!loadRecordFile(positional[0], &data, &errorMsg)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    CompactReport report = compactRecord(&data, options);
+    out() << report.toText();
+
+    if(positional.size() > 1 && !saveRecordFile(positional[1], data, &errorMsg)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// 以下为逐个复制数组的编辑, 与 RecordEditor 的各个操作结果相同, 用于 edit --check
+// 返回是否有修改, 与 RecordEditor 相同, 没有修改时不记入撤销
+static bool naiveCut(QList<ActionInfo> *actions, qint64 from, qint64 to, bool closeGap){
+    from = qBound<qint64>(0, from, actions->size());
+    to = qBound<qint64>(from, to, actions->size());
+    if(from == to){
+        return false;
+    }
+
+    qint64 shift = closeGap && to < actions->size() ? actions->at(from).actionTime - actions->at(to).actionTime : 0;
+    actions->remove(from, to - from);
+    for(qint64 i = from; i < actions->size(); i++){
+        (*actions)[i].actionTime += shift;
+    }
+    return true;
+}
+
+static bool naiveInsert(QList<ActionInfo> *actions, qint64 index, const QList<ActionInfo> &source, qint64 gap){
+    index = qBound<qint64>(0, index, actions->size());
+    if(source.isEmpty()){
+        return false;
+    }
+
+    qint64 prevTime = index > 0 ? actions->at(index - 1).actionTime : 0;
+    qint64 firstTime = source.first().actionTime;
+    qint64 span = source.last().actionTime - firstTime;
+    for(qint64 i = index; i < actions->size(); i++){
+        (*actions)[i].actionTime += gap + span;
+    }
+    for(qint64 i = 0; i < source.size(); i++){
+        ActionInfo actionInfo = source[i];
+        actionInfo.actionTime += prevTime + gap - firstTime;
+        actions->insert(index + i, actionInfo);
+    }
+    return true;
+}
+
+static bool naiveShiftTime(QList<ActionInfo> *actions, qint64 from, qint64 to, qint64 delta){
+    from = qBound<qint64>(0, from, actions->size());
+    to = qBound<qint64>(from, to, actions->size());
+    if(from == to || delta == 0){
+        return false;
+    }
+
+    if(delta < 0){
+        qint64 prevTime = from > 0 ? actions->at(from - 1).actionTime : 0;
+        delta = qMax(delta, prevTime - actions->at(from).actionTime);
+    }else if(to < actions->size()){
+        delta = qMin(delta, actions->at(to).actionTime - actions->at(to - 1).actionTime);
+    }
+    if(delta == 0){
+        return false;
+    }
+    for(qint64 i = from; i < to; i++){
+        (*actions)[i].actionTime += delta;
+    }
+    return true;
+}
+
+static bool naiveRemoveKeyPress(QList<ActionInfo> *actions, qint64 index){
+    if(index < 0 || index >= actions->size()){
+        return false;
+    }
+
+    ActionInfo press = actions->at(index);
+    if(press.actionType == ACTION_MOUSE_MOVE || press.isRelease){
+        return false;
+    }
+
+    for(qint64 i = index + 1; i < actions->size(); i++){
+        const ActionInfo &actionInfo = actions->at(i);
+        if(actionInfo.actionType == press.actionType && actionInfo.keyCode == press.keyCode){
+            if(actionInfo.isRelease){
+                actions->removeAt(i);
+            }
+            break;
+        }
+    }
+    actions->removeAt(index);
+    return true;
+}
+
+// 编辑结果与数组不同的第一个位置, 相同时返回-1
+static qint64 firstDifference(const RecordEditor &editor, const QList<ActionInfo> &actions){
+    qint64 index = 0;
+    qint64 difference = -1;
+    editor.forEach([&](const ActionInfo &actionInfo){
+        if(difference < 0){
+            if(index >= actions.size()){
+                difference = index;
+            }else{
+                const ActionInfo &expected = actions[index];
+                if(actionInfo.actionTime != expected.actionTime || actionInfo.keyCode != expected.keyCode || actionInfo.dx != expected.dx
+                    || actionInfo.dy != expected.dy || actionInfo.isRelease != expected.isRelease || actionInfo.actionType != expected.actionType){
+                    difference = index;
+                }
+            }
+        }
+        index++;
+    });
+    if(difference < 0 && index != actions.size()){
+        difference = qMin<qint64>(index, actions.size());
+    }
+    return difference;
+}
+
+// 按顺序对录制执行剪切、插入、平移时间、删除按键、撤销和重做
+static int editCommand(const QStringList &arguments){
+    QCommandLineParser parser;
+    parser.setApplicationDescription("按 --edit 的顺序编辑录制, 不复制操作列表; 序号从0开始, 时间为毫秒\n"
+                                     "  cut,开始,结束          删除 [开始, 结束) 的操作, 之后的操作提前\n"
+                                     "  cut-keep,开始,结束     删除操作, 不改变其它操作的时间\n"
+                                     "  shift,开始,结束,ms     平移 [开始, 结束) 的操作, 不越过前后相邻的操作\n"
+                                     "  insert,序号,间隔ms,文件 在序号前插入另一个录制的全部操作\n"
+                                     "  remove-key,序号        删除一个按下操作和对应的松开\n"
+                                     "  undo / redo            撤销 / 重做");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件");
+    parser.addPositionalArgument("output", "编辑后的文件, 省略时只输出结果");
+    parser.addOption({"edit", "一步编辑, 可以有多个, 按顺序执行", "op"});
+    parser.addOption({"format", "输出格式 text/binary", "format", "text"});
+    parser.addOption({"check", "同时逐个复制数组执行相同的编辑, 每一步比较结果, 不一致时退出码为1"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    RecordFormat format;
+    if(!parseRecordFormat(parser.value("format"), &format)){
+        err() << "未知格式:" << parser.value("format") << Qt::endl;
+        return 1;
+    }
+
+    RecordData data;
+    QString errorMsg;
+    if(!loadRecordFile(positional[0], &data, &errorMsg)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    bool check = parser.isSet("check");
+    QList<ActionInfo> naive = data.actionList;
+    QList<QList<ActionInfo>> naiveUndo, naiveRedo;
+
+    RecordEditor editor(data);
+    qint64 editTime = 0, naiveTime = 0;
+    QElapsedTimer timer;
+    const QStringList edits = parser.values("edit");
+    for(int step = 0; step < edits.size(); step++){
+        const QStringList fields = edits[step].split(',');
+        const QString &op = fields[0];
+        auto number = [&](int i){
+            return i < fields.size() ? fields[i].trimmed().toLongLong() : 0;
+        };
+        auto ms = [&](int i){
+            return i < fields.size() ? qint64(fields[i].trimmed().toDouble() * 1000000) : 0;
+        };
+
+        // 插入的录制先加载, 不计入编辑的耗时
+        RecordData source;
+        if(op == "insert"){
+            if(fields.size() < 4){
+                err() << "缺少插入的文件:" << edits[step] << Qt::endl;
+                return 1;
+            }
+            if(!loadRecordFile(fields.mid(3).join(','), &source, &errorMsg)){
+                err() << errorMsg << Qt::endl;
+                return 1;
+            }
+        }
+
+        timer.start();
+        if(op == "cut" || op == "cut-keep"){
+            editor.cut(number(1), number(2), op == "cut");
+        }else if(op == "shift"){
+            editor.shiftTime(number(1), number(2), ms(3));
+        }else if(op == "insert"){
+            editor.insert(number(1), source, 0, -1, ms(2));
+        }else if(op == "remove-key"){
+            if(!editor.removeKeyPress(number(1))){
+                err() << "第 " << number(1) << " 个操作不是按下操作:" << edits[step] << Qt::endl;
+            }
+        }else if(op == "undo"){
+            editor.undo();
+        }else if(op == "redo"){
+            editor.redo();
+        }else{
+            err() << "未知的编辑:" << edits[step] << Qt::endl;
+            return 1;
+        }
+        editTime += timer.nsecsElapsed();
+
+        if(!check){
+            continue;
+        }
+
+        timer.start();
+        QList<ActionInfo> before = naive;
+        bool changed = false;
+        if(op == "cut" || op == "cut-keep"){
+            changed = naiveCut(&naive, number(1), number(2), op == "cut");
+        }else if(op == "shift"){
+            changed = naiveShiftTime(&naive, number(1), number(2), ms(3));
+        }else if(op == "insert"){
+            changed = naiveInsert(&naive, number(1), source.actionList, ms(2));
+        }else if(op == "remove-key"){
+            changed = naiveRemoveKeyPress(&naive, number(1));
+        }else if(op == "undo" && !naiveUndo.isEmpty()){
+            naiveRedo.append(naive);
+            naive = naiveUndo.takeLast();
+        }else if(op == "redo" && !naiveRedo.isEmpty()){
+            naiveUndo.append(naive);
+            naive = naiveRedo.takeLast();
+        }
+        if(changed){
+            naiveUndo.append(before);
+            naiveRedo.clear();
+        }
+        naiveTime += timer.nsecsElapsed();
+
+        qint64 difference = firstDifference(editor, naive);
+        if(difference >= 0){
+            err() << "第 " << step + 1 << " 步 " << edits[step] << " 后与逐个复制数组的结果不同, 第 " << difference << " 个操作不一致" << Qt::endl;
+            return 1;
+        }
+    }
+
+    out() << "编辑 " << edits.size() << " 步, 操作数 " << data.actionList.size() << " -> " << editor.size()
+          << ", 时长 " << QString::number(data.duration() / 1e9, 'f', 3) << " s -> " << QString::number(editor.duration() / 1e9, 'f', 3) << " s"
+          << ", 用时 " << QString::number(editTime / 1000000.0, 'f', 3) << " ms" << Qt::endl;
+    if(check){
+        out() << "与逐个复制数组的结果一致, 数组用时 " << QString::number(naiveTime / 1000000.0, 'f', 3) << " ms" << Qt::endl;
+    }
+
+    if(positional.size() > 1 && !editor.save(positional[1], &errorMsg, format)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// 生成用于压力测试的录制文件
+static int generateCommand(const QStringList &arguments){
+    GeneratorOptions options;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("按参数生成录制文件, 同一构建下相同参数和种子总是生成相同的文件");
+    parser.addHelpOption();
+    parser.addPositionalArgument("output", "输出的录制文件");
+    parser.addOption({"seed", "随机种子", "n", QString::number(options.seed)});
+    parser.addOption({"duration-s", "录制时长", "s", QString::number(options.duration / 1e9)});
+    parser.addOption({"key-rate", "平均每秒按下键盘按键的次数", "n", QString::number(options.keyRate)});
+    parser.addOption({"hold-ms", "按键按住时长的中位数", "ms", QString::number(options.holdMean)});
+    parser.addOption({"hold-spread", "按住时长对数的标准差", "n", QString::number(options.holdSpread)});
+    parser.addOption({"rollover", "同时按住的最多键盘按键数", "n", QString::number(options.maxRollover)});
+    parser.addOption({"button-rate", "平均每秒按下鼠标按键的次数", "n", QString::number(options.mouseButtonRate)});
+    parser.addOption({"mouse-hz", "鼠标回报率", "Hz", QString::number(options.mouseRate)});
+    parser.addOption({"mouse-speed", "鼠标移动时的平均速度, 像素/秒", "n", QString::number(options.mouseSpeed)});
+    parser.addOption({"mouse-active", "鼠标处于移动状态的时间比例", "0-1", QString::number(options.mouseActiveRatio)});
+    parser.addOption({"burst-ms", "每段连续移动或静止的平均时长", "ms", QString::number(options.burstMean)});
+    parser.addOption({"format", "输出格式 text/binary", "format", "text"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    bool seedOk = false;
+    options.seed = parser.value("seed").toULongLong(&seedOk);
+    if(!seedOk){
+        err() << "--seed 不是非负整数: " << parser.value("seed") << Qt::endl;
+        return 1;
+    }
+
+    // 时长和各频率为 0 或非数字时生成循环不会前进, 生成前先检查
+    double durationSeconds;
+    if(!rangeOption(parser, "duration-s", 0, 9e9, true, &durationSeconds)
+        || !rangeOption(parser, "key-rate", 0, 1000000, false, &options.keyRate)
+        || !rangeOption(parser, "hold-ms", 0, 1e9, true, &options.holdMean)
+        || !rangeOption(parser, "hold-spread", 0, 10, false, &options.holdSpread)
+        || !rangeOption(parser, "button-rate", 0, 1000000, false, &options.mouseButtonRate)
+        || !rangeOption(parser, "mouse-hz", 0, 1000000, true, &options.mouseRate)
+        || !rangeOption(parser, "mouse-speed", 0, 1e9, false, &options.mouseSpeed)
+        || !rangeOption(parser, "mouse-active", 0, 1, false, &options.mouseActiveRatio)
+        || !rangeOption(parser, "burst-ms", 0, 1e9, true, &options.burstMean)){
+        return 1;
+    }
+    options.duration = qint64(durationSeconds * 1e9);
+
+    bool rolloverOk = false;
+    options.maxRollover = parser.value("rollover").toInt(&rolloverOk);
+    if(!rolloverOk || options.maxRollover < 0){
+        err() << "--rollover 不是非负整数: " << parser.value("rollover") << Qt::endl;
+        return 1;
+    }
+
+    RecordFormat format;
+    if(!parseRecordFormat(parser.value("format"), &format)){
+        err() << "未知格式:" << parser.value("format") << Qt::endl;
+        return 1;
+    }
+
+    RecordData data = generateRecord(options);
+
+    QString errorMsg;
+    if(!saveRecordFile(positional[0], data, &errorMsg, format)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    out() << "操作数: " << data.actionList.size() << Qt::endl;
+    out() << "时长: " << data.duration() / 1000000 << " ms" << Qt::endl;
+    return 0;
+}
+
+// 批量检查和转换目录下的录制文件
+static int batchCommand(const QStringList &arguments){
+    BatchOptions options;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("在多个线程中检查目录(含子目录)下的所有录制文件, 可同时转换格式");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件所在目录");
+    parser.addOption({"output", "转换后的文件保存到该目录, 省略时只检查", "dir"});
+    parser.addOption({"format", "转换后的格式 text/binary", "format", "text"});
+    parser.addOption({"threads", "线程数, 默认使用所有核心", "n", "0"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    if(!parseRecordFormat(parser.value("format"), &options.outputFormat)){
+        err() << "未知格式:" << parser.value("format") << Qt::endl;
+        return 1;
+    }
+    options.outputDir = parser.value("output");
+    options.threadCount = parser.value("threads").toInt();
+
+    BatchReport report = processRecordDir(positional[0], options);
+    out() << report.toText();
+
+    return report.problemFiles.isEmpty() ? 0 : 1;
+}
+
+// 将录制的时间线绘制为图片
+static int timelineCommand(const QStringList &arguments){
+    QCommandLineParser parser;
+    parser.setApplicationDescription("将录制的时间线绘制为图片, 并输出生成汇总数据和绘制的耗时");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件");
+    parser.addPositionalArgument("output", "输出的图片, 如 timeline.png");
+    parser.addOption({"start-ms", "显示的开始时间", "ms", "0"});
+    parser.addOption({"span-ms", "显示的时长, 默认整个录制", "ms"});
+    parser.addOption({"width", "图片宽度", "px", "1200"});
+    parser.addOption({"height", "图片高度", "px", "300"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.size() < 2){
+        parser.showHelp(1);
+    }
+
+    RecordData data;
+    QString errorMsg;
+    if(!loadRecordFile(positional[0], &data, &errorMsg)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    TimelinePyramid pyramid;
+    pyramid.build(data);
+    qint64 buildTime = timer.nsecsElapsed();
+
+    qint64 start = msOption(parser, "start-ms", 0);
+    qint64 span = msOption(parser, "span-ms", pyramid.duration());
+
+    QImage image(qMax(1, parser.value("width").toInt()), qMax(1, parser.value("height").toInt()), QImage::Format_RGB32);
+    timer.restart();
+    {
+        QPainter painter(&image);
+        TimelineWidget::paintTimeline(&painter, image.rect(), &pyramid, start, qMax<qint64>(1, span));
+    }
+    qint64 paintTime = timer.nsecsElapsed();
+
+    if(!image.save(positional[1])){
+        err() << "保存图片失败:" << positional[1] << Qt::endl;
+        return 1;
+    }
+
+    out() << "操作数: " << data.actionList.size() << Qt::endl;
+    out() << "汇总级数: " << pyramid.levelCount() << ", 按键行数: " << pyramid.laneCount() << Qt::endl;
+    out() << "生成汇总: " << QString::number(buildTime / 1000000.0, 'f', 2) << " ms" << Qt::endl;
+    out() << "绘制: " << QString::number(paintTime / 1000000.0, 'f', 2) << " ms" << Qt::endl;
+    return 0;
+}
+
+// 通过回环后端播放录制, 验证发送的操作与录制一致
+static int verifyCommand(const QStringList &arguments){
+    VerifyThresholds thresholds;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("按实际时间播放录制到回环后端(不发送到系统), 将发送的操作与录制比较, 未通过时退出码为1");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件或宏程序");
+    parser.addOption({"capture", "将发送的操作保存为录制文件", "file"});
+    parser.addOption({"transform", "播放时使用的变换文件, 发送的操作与变换后的录制比较", "file"});
+    parser.addOption({"pipeline-lead-ms", "边加载边播放, 读取到开头这段时长的操作后就开始播放", "ms"});
+    parser.addOption({"instant", "使用虚拟时钟, 不等待实际时间, 立即播放完; 发送时间没有误差"});
+    parser.addOption({"max-missing", "最多缺少的操作数", "n", QString::number(thresholds.maxMissing)});
+    parser.addOption({"max-extra", "最多多出的操作数", "n", QString::number(thresholds.maxExtra)});
+    parser.addOption({"max-reordered", "最多顺序错乱的操作数", "n", QString::number(thresholds.maxReordered)});
+    parser.addOption({"max-mouse-error", "鼠标路径上的最大位置误差", "px", QString::number(thresholds.maxMouseError)});
+    parser.addOption({"max-p99-ms", "99%操作的最大发送延迟", "ms", QString::number(thresholds.maxP99Error / 1000000.0)});
+    parser.addOption({"max-error-ms", "所有操作的最大发送延迟, 0表示不检查", "ms", QString::number(thresholds.maxError / 1000000.0)});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    thresholds.maxMissing = parser.value("max-missing").toLongLong();
+    thresholds.maxExtra = parser.value("max-extra").toLongLong();
+    thresholds.maxReordered = parser.value("max-reordered").toLongLong();
+    thresholds.maxMouseError = parser.value("max-mouse-error").toLongLong();
+    thresholds.maxP99Error = msOption(parser, "max-p99-ms", thresholds.maxP99Error);
+    thresholds.maxError = msOption(parser, "max-error-ms", thresholds.maxError);
+
+    QString errorMsg;
+    std::unique_ptr<ActionTransform> transform;
+    if(parser.isSet("transform")){
+        QList<TransformRule> rules;
+        if(!loadTransformFile(parser.value("transform"), &rules, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        transform = makeTransform(rules);
+    }
+
+    // 虚拟时钟下只检查发送的内容, 延迟总是0
+    std::unique_ptr<PlaybackClock> clock;
+    if(parser.isSet("instant")){
+        clock.reset(new VirtualClock);
+    }
+    QElapsedTimer playTimer;
+
+    // 开始读取到开始播放的耗时
+    RecordData data;
+    QList<ActionInfo> captured;
+    qint64 startDelay;
+    if(positional[0].endsWith(MACRO_SUFFIX)){
+        // 宏程序与展开后的录制比较
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        // 变换与播放时相同, 按片段分别变换, 展开时直接得到比较的基准
+        MacroProgram program;
+        if(!loadMacroFile(positional[0], &program, &errorMsg) || !expandMacro(program, &data, &errorMsg, transform.get())){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        startDelay = loadTimer.nsecsElapsed();
+        playTimer.start();
+        captured = playLoopbackMacro(program, transform.get(), clock.get());
+    }else if(parser.isSet("pipeline-lead-ms")){
+        qint64 leadTime = qMax<qint64>(0, msOption(parser, "pipeline-lead-ms", 0));
+        playTimer.start();
+        if(!playLoopbackPipelined(positional[0], leadTime, transform.get(), clock.get(), &data, &captured, &startDelay, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+    }else{
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        if(!loadRecordFile(positional[0], &data, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        startDelay = loadTimer.nsecsElapsed();
+        playTimer.start();
+        captured = playLoopback(data, nullptr, transform.get(), clock.get());
+    }
+
+    // 变换后的录制作为比较的基准
+    if(transform && !positional[0].endsWith(MACRO_SUFFIX)){
+        data = transformRecord(data, transform.get());
+    }
+
+    if(parser.isSet("capture")){
+        RecordData capture;
+        capture.firstX = data.firstX;
+        capture.firstY = data.firstY;
+        capture.actionList = captured;
+        if(!saveRecordFile(parser.value("capture"), capture, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+    }
+
+    VerifyReport report = compareCapture(data, captured, thresholds);
+    out() << report.toText();
+    out() << "开始读取到开始播放: " << QString::number(startDelay / 1000000.0, 'f', 2) << " ms" << Qt::endl;
+    out() << "播放用时: " << QString::number(playTimer.nsecsElapsed() / 1000000.0, 'f', 2) << " ms" << Qt::endl;
+    return report.passed() ? 0 : 1;
+}
+
+// 编译宏程序并输出指令, 或把录制导入为宏程序
+static int macroCommand(const QStringList &arguments){
+    QCommandLineParser parser;
+    parser.setApplicationDescription("编译宏程序并输出指令和展开后的规模; 加 --import 时生成只播放该录制的宏程序");
+    parser.addHelpOption();
+    parser.addPositionalArgument("macro", "宏程序文件");
+    parser.addOption({"import", "导入的录制文件, 作为宏程序的唯一片段", "file"});
+    parser.addOption({"check", "按2倍时间缩放、推迟5ms、1.5倍鼠标缩放使用虚拟时钟播放, 与同样变换后展开的结果比较, 不一致时退出码为1"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    QString errorMsg;
+    if(parser.isSet("import")){
+        // 宏程序中按相对路径引用录制
+        QString recordPath = parser.value("import");
+        QString recordName = QFileInfo(positional[0]).absoluteDir().relativeFilePath(QFileInfo(recordPath).absoluteFilePath());
+        if(!QFileInfo::exists(recordPath)){
+            err() << "无法打开文件:" << recordPath << Qt::endl;
+            return 1;
+        }
+        if(!saveMacroImport(positional[0], recordName, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    MacroProgram program;
+    if(!loadMacroFile(positional[0], &program, &errorMsg)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+    qint64 loadTime = timer.nsecsElapsed();
+
+    qint64 segmentActions = 0;
+    for(const QSharedPointer<const RecordData> &segment : std::as_const(program.segments)){
+        segmentActions += segment->actionList.size();
+    }
+
+    qint64 duration = program.duration();
+    qint64 actionCount = program.actionCount();
+    out() << program.disassemble();
+    out() << "片段 " << program.segments.size() << " 个, 共 " << segmentActions << " 个操作; 指令 " << program.code.size()
+          << " 条 (" << program.code.size() * qint64(sizeof(MacroInstruction)) << " 字节), 循环最多嵌套 " << program.maxDepth << " 层" << Qt::endl;
+    if(duration < 0){
+        out() << "展开后: 一直循环" << Qt::endl;
+    }else{
+        out() << "展开后: " << actionCount << " 个操作, " << QString::number(duration / 1e9, 'f', 3) << " s" << Qt::endl;
+    }
+    out() << "加载和编译: " << QString::number(loadTime / 1000000.0, 'f', 2) << " ms" << Qt::endl;
+
+    if(parser.isSet("check")){
+        // 播放和展开对每个片段使用相同的变换, 时间缩放和偏移后两者仍应完全一致
+        QList<TransformRule> rules;
+        TransformRule timeScale{TransformRule::TIME_SCALE};
+        timeScale.value = 2.0;
+        rules.append(timeScale);
+        TransformRule timeOffset{TransformRule::TIME_OFFSET};
+        timeOffset.value = 5000000;
+        rules.append(timeOffset);
+        TransformRule mouseScale{TransformRule::MOUSE_SCALE};
+        mouseScale.value = 1.5;
+        rules.append(mouseScale);
+        std::unique_ptr<ActionTransform> transform = makeTransform(rules);
+
+        RecordData expected;
+        if(!expandMacro(program, &expected, &errorMsg, transform.get())){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        VirtualClock clock;
+        QList<ActionInfo> captured = playLoopbackMacro(program, transform.get(), &clock);
+
+        VerifyReport report = compareCapture(expected, captured);
+        out() << "变换后播放与展开结果比较:" << Qt::endl << report.toText();
+        if(!report.passed()){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 发送后端的参数说明
+#if defined(Q_OS_WIN)
+#define BACKEND_HELP "发送后端: sendinput 或 loopback"
+#elif defined(Q_OS_LINUX)
+#define BACKEND_HELP "发送后端: x11 或 loopback"
+#else
+#define BACKEND_HELP "发送后端: loopback"
+#endif
+
+// 发送到系统的命令是否继续, Ctrl+C 或 kill 时变为 false, 命令停止后正常返回, 由后端析构恢复服务器设置
+static std::atomic<bool> s_commandRunning{true};
+
+#ifdef Q_OS_LINUX
+// 信号处理中不能调用 Xlib, 只清除标志; 恢复默认处理, 再次按 Ctrl+C 时直接结束
+static void stopCommandOnSignal(int signalNumber){
+    s_commandRunning.store(false);
+    std::signal(signalNumber, SIG_DFL);
+}
+#endif
+
+// 按 --backend 创建发送后端, x11 后端使用 --display 和 --sync; 不支持或连接失败时返回空
+static InputEmitter *createEmitter(const QCommandLineParser &parser, QString *errorMsg){
+    QString backend = parser.value("backend");
+    if(backend == "loopback"){
+        return new LoopbackEmitter;
+    }
+#ifdef Q_OS_WIN
+    if(backend == "sendinput"){
+        return new SendInputEmitter;
+    }
+#endif
+#ifdef Q_OS_LINUX
+    if(backend == "x11"){
+        QScopedPointer<X11Emitter> emitter(new X11Emitter);
+        if(!emitter->open(parser.value("display"), errorMsg)){
+            return nullptr;
+        }
+        emitter->setSync(parser.isSet("sync"));
+        // 发送期间关闭指针加速, 命令结束释放后端时恢复; 被 Ctrl+C 中断时也先停止命令再恢复
+        emitter->disablePointerAcceleration();
+        std::signal(SIGINT, stopCommandOnSignal);
+        std::signal(SIGTERM, stopCommandOnSignal);
+        return emitter.take();
+    }
+#endif
+
+    *errorMsg = "不支持的发送后端: " + backend;
+    return nullptr;
+}
+
+// 发送所有按键和鼠标操作后从后端读回状态检查, 只有 x11 后端支持
+static bool checkEmitter(InputEmitter *emitter, QString *report, QString *errorMsg){
+#ifdef Q_OS_LINUX
+    if(X11Emitter *x11 = dynamic_cast<X11Emitter *>(emitter)){
+        return x11->selfTest(report, errorMsg);
+    }
+#else
+    Q_UNUSED(emitter);
+    Q_UNUSED(report);
+#endif
+
+    *errorMsg = "--check 只支持 x11 后端";
+    return false;
+}
+
+// 测量本机的计时和发送延迟, 保存为播放时使用的计时校准
+static int calibrateCommand(const QStringList &arguments){
+    CalibrationOptions options;
+
+#ifdef Q_OS_WIN
+    const QString defaultBackend = "sendinput";
+#else
+    const QString defaultBackend = "loopback";
+#endif
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("测量睡眠误差、计时器和自旋耗时、通过发送后端的单次和连续发送延迟, 保存到录制文件夹, 播放时自动使用");
+    parser.addHelpOption();
+    parser.addOption({"output", "保存的文件", "file", defaultRecordDir() + TIMING_PROFILE_NAME});
+    parser.addOption({"backend", BACKEND_HELP, "name", defaultBackend});
+    parser.addOption({"display", "x11 后端连接的 X 服务器, 默认为 DISPLAY 环境变量", "name"});
+    parser.addOption({"sync", "x11 后端每次送出后等待服务器处理完"});
+    parser.addOption({"check", "x11 后端: 发送所有按键和鼠标操作, 从服务器读回状态检查是否一致, 只应在 Xvfb 等测试用的服务器上使用"});
+    parser.addOption({"sleep-samples", "睡眠1ms的次数", "n", QString::number(options.sleepSamples)});
+    parser.addOption({"emit-samples", "单次发送的次数", "n", QString::number(options.emitSamples)});
+    parser.addOption({"no-save", "只输出结果, 不保存"});
+    parser.process(arguments);
+
+    options.sleepSamples = qMax(1, parser.value("sleep-samples").toInt());
+    options.emitSamples = qMax(1, parser.value("emit-samples").toInt());
+
+    QString errorMsg;
+    QScopedPointer<InputEmitter> emitter(createEmitter(parser, &errorMsg));
+    if(!emitter){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    TimingProfile profile = calibrateTiming(emitter.data(), options, &s_commandRunning);
+    if(!s_commandRunning.load()){
+        err() << "测量被中断, 不保存" << Qt::endl;
+        return 1;
+    }
+    out() << profile.toText();
+
+    bool checked = true;
+    if(parser.isSet("check")){
+        QString report;
+        checked = checkEmitter(emitter.data(), &report, &errorMsg);
+        out() << report;
+        if(!checked){
+            err() << errorMsg << Qt::endl;
+        }
+    }
+
+    if(!parser.isSet("no-save")){
+        if(!saveTimingProfile(parser.value("output"), profile, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        out() << "已保存到 " << parser.value("output") << Qt::endl;
+    }
+    return checked ? 0 : 1;
+}
+
+// 读取录制程序实时发布的操作, 也是 EventBusClient 的使用示例
+static int eventsCommand(const QStringList &arguments){
+    QCommandLineParser parser;
+    parser.setApplicationDescription("读取以 --event-bus 启动的录制程序实时发布的操作, 每行输出一个操作, 发布方退出时结束");
+    parser.addHelpOption();
+    parser.addPositionalArgument("pid", "录制程序的进程id");
+    parser.addOption({"count", "读取的操作数, 0表示不限", "n", "0"});
+    parser.addOption({"poll-ms", "没有新操作时的等待时间", "ms", "1"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    qint64 limit = parser.value("count").toLongLong();
+    int pollMs = qMax(0, parser.value("poll-ms").toInt());
+
+    EventBusClient client;
+    QString errorMsg;
+    if(!client.attach(positional[0].toLongLong(), &errorMsg)){
+        err() << errorMsg << Qt::endl;
+        return 1;
+    }
+
+    BusEvent events[256];
+    qint64 total = 0;
+    quint64 reportedLost = 0;
+    while(limit <= 0 || total < limit){
+        int count = client.read(events, int(qMin<qint64>(256, limit > 0 ? limit - total : 256)));
+
+        if(client.lost() != reportedLost){
+            err() << "落后于发布方, 丢失 " << client.lost() - reportedLost << " 个操作" << Qt::endl;
+            reportedLost = client.lost();
+        }
+
+        if(count == 0){
+            if(!client.isPublisherOpen()){
+                break;
+            }
+            out().flush();
+            QThread::msleep(pollMs);
+            continue;
+        }
+
+        for(int i = 0; i < count; i++){
+            const BusEvent &event = events[i];
+            out() << event.session << " ";
+            if(event.type == BUS_RECORD_START){
+                out() << event.time << " recordStart:" << event.dx << "," << event.dy;
+            }else if(event.type == BUS_RECORD_STOP){
+                out() << event.time << " recordStop";
+            }else{
+                out() << formatAction(ActionInfo{event.time, event.keyCode, event.dx, event.dy, event.release != 0, ActionType(event.type)});
+            }
+            out() << "\n";
+        }
+        total += count;
+    }
+
+    out().flush();
+    err() << "共读取 " << total << " 个操作, 丢失 " << client.lost() << " 个" << Qt::endl;
+    return 0;
+}
+
+// 在一个调度线程上同时播放多个会话到回环后端, 检查每个会话的发送时间
+static int sessionsCommand(const QStringList &arguments){
+    QCommandLineParser parser;
+    parser.setApplicationDescription("在同一个调度线程上同时播放多个会话到回环后端(不发送到系统), 多个录制文件轮流分配给各会话, 逐个会话与录制比较, 任一会话未通过时退出码为1");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件, 可以有多个");
+    parser.addOption({"count", "会话数", "n", "16"});
+    parser.addOption({"loops", "每个会话的播放轮数", "n", "1"});
+    parser.addOption({"stagger-ms", "相邻会话开始时间的间隔", "ms", "0"});
+    parser.addOption({"instant", "使用虚拟时钟, 调度线程不睡眠, 直接前进到下一个到期时间"});
+    parser.addOption({"timing", "计时校准文件, 不存在时不使用", "file", defaultRecordDir() + TIMING_PROFILE_NAME});
+    parser.addOption({"max-p99-ms", "每个会话99%操作的最大发送延迟", "ms", QString::number(VerifyThresholds().maxP99Error / 1000000.0)});
+    parser.addOption({"metrics", "播放时在本地套接字 KeyRecorder-metrics-<进程id> 上提供状态接口"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    int count = qMax(1, parser.value("count").toInt());
+    int loops = qMax(1, parser.value("loops").toInt());
+    qint64 stagger = qMax<qint64>(0, msOption(parser, "stagger-ms", 0));
+    VerifyThresholds thresholds;
+    thresholds.maxP99Error = msOption(parser, "max-p99-ms", thresholds.maxP99Error);
+
+    // 比较的基准为连续播放 loops 轮的录制
+    QList<QSharedPointer<const RecordData>> sources;
+    QList<RecordData> expected;
+    QString errorMsg;
+    for(const QString &filePath : positional){
+        QSharedPointer<RecordData> data(new RecordData);
+        if(!loadRecordFile(filePath, data.data(), &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+
+        RecordData repeated = *data;
+        repeated.actionList.clear();
+        for(int loop = 0; loop < loops; loop++){
+            for(ActionInfo actionInfo : std::as_const(data->actionList)){
+                actionInfo.actionTime += loop * data->duration();
+                repeated.actionList.append(actionInfo);
+            }
+        }
+        sources.append(data);
+        expected.append(repeated);
+    }
+
+    std::unique_ptr<PlaybackClock> clock;
+    if(parser.isSet("instant")){
+        clock.reset(new VirtualClock);
+    }
+
+    PlaybackScheduler scheduler(clock.get());
+    if(QFileInfo::exists(parser.value("timing"))){
+        TimingProfile profile;
+        if(loadTimingProfile(parser.value("timing"), &profile, &errorMsg)){
+            scheduler.setTimingProfile(profile);
+        }else{
+            err() << errorMsg << Qt::endl;
+        }
+    }
+
+    std::vector<std::unique_ptr<LoopbackEmitter>> emitters;
+    std::vector<PlaybackStats> stats(count);
+    QList<qint64> startTimes;
+    QList<SessionOptions> sessions;
+    // 留出添加所有会话的时间, 使开始时间都在将来
+    qint64 firstStart = scheduler.now() + 10000000;
+    for(int i = 0; i < count; i++){
+        emitters.emplace_back(new LoopbackEmitter);
+        emitters.back()->setClock(&scheduler.timeline());
+
+        SessionOptions options;
+        options.data = sources[i % sources.size()];
+        options.emitter = emitters.back().get();
+        options.stats = &stats[i];
+        options.loopCount = loops;
+        options.startTime = firstStart + i * stagger;
+        startTimes.append(options.startTime);
+        sessions.append(options);
+    }
+
+    QElapsedTimer wallTimer;
+    QScopedPointer<MetricsServer> metricsServer;
+    if(parser.isSet("metrics")){
+        // 统计都是原子计数, 主线程读取时不需要停止调度线程
+        metricsServer.reset(new MetricsServer([&](MetricsSample *previous){
+            QJsonObject json;
+            QJsonArray sessionsJson;
+            qint64 events = 0, loopsCompleted = 0;
+            for(const PlaybackStats &sessionStats : stats){
+                PlaybackStats::Snapshot snapshot = sessionStats.snapshot();
+                events += snapshot.eventsEmitted;
+                loopsCompleted += snapshot.loopsCompleted;
+                sessionsJson.append(snapshot.toJson());
+            }
+            json["state"] = scheduler.activeSessions() > 0 ? "playing" : "idle";
+            json["active_sessions"] = scheduler.activeSessions();
+            json["events_emitted"] = events;
+            json["loops_completed"] = loopsCompleted;
+            json["scheduler_wakeups"] = scheduler.wakeups();
+            json["scheduler_batches"] = scheduler.batches();
+            appendEventRates(&json, wallTimer.isValid() ? wallTimer.nsecsElapsed() : 0, events, previous);
+            json["sessions"] = sessionsJson;
+            return json;
+        }));
+        if(!metricsServer->start()){
+            err() << "无法启动状态接口:" << metricsServer->serverName() << Qt::endl;
+            return 1;
+        }
+        err() << "状态接口: " << metricsServer->serverName() << Qt::endl;
+    }
+
+    wallTimer.start();
+    scheduler.addSessions(sessions);
+    if(metricsServer){
+        // 播放在调度线程上进行, 主线程处理状态接口的请求
+        while(!scheduler.waitForIdle(50)){
+            QCoreApplication::processEvents();
+        }
+    }else{
+        scheduler.waitForIdle();
+    }
+    qint64 wallTime = wallTimer.nsecsElapsed();
+
+    auto ms = [](qint64 ns){
+        return QString::number(ns / 1000000.0, 'f', 3);
+    };
+
+    int failed = 0;
+    qint64 totalEvents = 0;
+    for(int i = 0; i < count; i++){
+        // 发送时间改为相对会话开始
+        QList<ActionInfo> captured = emitters[i]->captured();
+        for(ActionInfo &actionInfo : captured){
+            actionInfo.actionTime -= startTimes[i];
+        }
+        totalEvents += captured.size();
+
+        VerifyReport report = compareCapture(expected[i % expected.size()], captured, thresholds);
+        if(!report.passed()){
+            failed++;
+        }
+        out() << "会话 " << i << ": 发送 " << report.capturedEvents << "/" << report.sourceEvents
+              << ", 延迟 p50 " << ms(report.p50Error) << " ms, p99 " << ms(report.p99Error) << " ms, 最大 " << ms(report.maxError) << " ms"
+              << ", 调度延迟 p99 " << ms(stats[i].snapshot().latenessPercentile(99)) << " ms"
+              << (report.passed() ? QString() : ", 未通过: " + report.failures.join("; ")) << Qt::endl;
+    }
+
+    qint64 batches = scheduler.batches();
+    out() << "会话 " << count << " 个, 未通过 " << failed << " 个, 共发送 " << totalEvents << " 个操作, 用时 " << ms(wallTime) << " ms" << Qt::endl;
+    out() << "调度线程醒来 " << scheduler.wakeups() << " 次, 发送 " << batches << " 批, 平均每批 "
+          << QString::number(batches > 0 ? double(totalEvents) / batches : 0, 'f', 2) << " 个操作" << Qt::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+// 发送结果的校验值(FNV-1a), 用于比较两次模拟的结果是否完全相同
+static quint64 captureChecksum(const QList<ActionInfo> &captured){
+    quint64 hash = 14695981039346656037ULL;
+    auto mix = [&](qint64 value){
+        for(int i = 0; i < 8; i++){
+            hash ^= quint64(value >> (i * 8)) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    };
+    for(const ActionInfo &actionInfo : captured){
+        mix(actionInfo.actionTime);
+        mix(actionInfo.keyCode);
+        mix(actionInfo.dx);
+        mix(actionInfo.dy);
+        mix((int(actionInfo.actionType) << 1) | (actionInfo.isRelease ? 1 : 0));
+    }
+    return hash;
+}
+
+// 使用虚拟时钟按界面中的方式循环播放, 不等待实际时间
+static int simulateCommand(const QStringList &arguments){
+    QCommandLineParser parser;
+    parser.setApplicationDescription("使用虚拟时钟把录制、播放列表或宏程序循环播放到回环后端(不发送到系统), 包括每轮开始前的复位移动; "
+                                     "不等待实际时间, 发送时间与预定时间完全一致, 相同输入总是得到相同的结果和校验值");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "录制文件、播放列表或宏程序");
+    parser.addOption({"loops", "录制和宏程序的播放轮数, 播放列表整个列表的播放遍数", "n", "1"});
+    parser.addOption({"move-to-initial", "每轮开始前把鼠标移动到录制时的初始位置"});
+    parser.addOption({"restore-view", "每轮开始前恢复第一轮的初始视角"});
+    parser.addOption({"cursor", "模拟的初始鼠标位置", "x,y", "0,0"});
+    parser.addOption({"capture", "将发送的操作保存为录制文件(仅回环后端)", "file"});
+    parser.addOption({"backend", BACKEND_HELP ", 不是回环后端时以最快速度发送到系统, 用于测量发送的耗时", "name", "loopback"});
+    parser.addOption({"display", "x11 后端连接的 X 服务器, 默认为 DISPLAY 环境变量", "name"});
+    parser.addOption({"sync", "x11 后端每次送出后等待服务器处理完"});
+    parser.process(arguments);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()){
+        parser.showHelp(1);
+    }
+
+    bool isLoopback = parser.value("backend") == "loopback";
+    if(!isLoopback && parser.isSet("capture")){
+        err() << "--capture 只能用于回环后端" << Qt::endl;
+        return 1;
+    }
+
+    int loops = qMax(1, parser.value("loops").toInt());
+    QStringList cursor = parser.value("cursor").split(',');
+    if(cursor.size() != 2){
+        err() << "鼠标位置格式错误:" << parser.value("cursor") << Qt::endl;
+        return 1;
+    }
+
+    const QString input = positional[0];
+    const QString recordDir = QFileInfo(input).absolutePath() + "/";
+
+    std::atomic<bool> &running = s_commandRunning;
+    VirtualClock clock;
+
+    LoopbackEmitter loopback;
+    loopback.setClock(&clock);
+    loopback.setCursorPos(cursor[0].trimmed().toInt(), cursor[1].trimmed().toInt());
+
+    // 发送到系统时时间仍按虚拟时钟前进, 实际用时即为发送的耗时
+    QString errorMsg;
+    QScopedPointer<InputEmitter> systemEmitter;
+    InputEmitter *emitter = &loopback;
+    if(!isLoopback){
+        systemEmitter.reset(createEmitter(parser, &errorMsg));
+        if(!systemEmitter){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        emitter = systemEmitter.data();
+    }
+
+    PlaybackStats stats;
+    RecordPlayer player(emitter, &running);
+    player.setClock(&clock);
+    player.setStats(&stats);
+    player.setMoveToInitialPos(parser.isSet("move-to-initial"));
+    player.setRestoreView(parser.isSet("restore-view"));
+
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    if(input.endsWith(MACRO_SUFFIX)){
+        MacroProgram program;
+        if(!loadMacroFile(input, &program, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+        if(program.duration() < 0){
+            err() << "宏程序一直循环, 无法模拟:" << input << Qt::endl;
+            return 1;
+        }
+
+        // 与界面中循环播放宏程序相同
+        clock.start();
+        qint64 nextStart = 0;
+        for(int loop = 0; loop < loops && player.waitUntil(nextStart); loop++){
+            player.prepareLoop(program.header);
+            qint64 startTime = qMax(nextStart, clock.nsecsElapsed());
+            qint64 endTime;
+            player.playMacro(program, startTime, &endTime);
+            nextStart = endTime + LOOP_GAP_MS * 1000000LL;
+        }
+    }else{
+        QList<PlaylistEntry> entries;
+        if(input.endsWith(PLAYLIST_SUFFIX)){
+            if(!loadPlaylistFile(input, &entries, &errorMsg)){
+                err() << errorMsg << Qt::endl;
+                return 1;
+            }
+            for(const PlaylistEntry &entry : std::as_const(entries)){
+                if(entry.loopCount <= 0){
+                    err() << "播放列表中的 " << entry.recordName << " 一直循环, 无法模拟" << Qt::endl;
+                    return 1;
+                }
+            }
+            QList<PlaylistEntry> once = entries;
+            for(int loop = 1; loop < loops; loop++){
+                entries.append(once);
+            }
+        }else{
+            entries.append(PlaylistEntry{QFileInfo(input).fileName(), loops, 0});
+        }
+
+        RecordSequencer sequencer(&player, &running);
+        sequencer.setRepeatList(false);
+        if(!sequencer.run(recordDir, entries, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+    }
+    qint64 wallTime = wallTimer.nsecsElapsed();
+
+    const QList<ActionInfo> &captured = loopback.captured();
+    qint64 counts[3] = {};
+    for(const ActionInfo &actionInfo : captured){
+        counts[actionInfo.actionType]++;
+    }
+
+    if(parser.isSet("capture")){
+        RecordData capture;
+        capture.actionList = captured;
+        if(!saveRecordFile(parser.value("capture"), capture, &errorMsg)){
+            err() << errorMsg << Qt::endl;
+            return 1;
+        }
+    }
+
+    int cursorX = 0, cursorY = 0;
+    emitter->getCursorPos(&cursorX, &cursorY);
+    PlaybackStats::Snapshot snapshot = stats.snapshot();
+    qint64 simulated = clock.nsecsElapsed();
+
+    if(isLoopback){
+        out() << "完成 " << snapshot.loopsCompleted << " 轮, 发送 " << captured.size() << " 个操作 (键盘 " << counts[ACTION_KEYBOARD]
+              << ", 鼠标按键 " << counts[ACTION_MOUSE_BUTTON] << ", 鼠标移动 " << counts[ACTION_MOUSE_MOVE] << ")" << Qt::endl;
+    }else{
+        // 不经过回环后端时没有每个操作的记录, 只有统计
+        out() << "完成 " << snapshot.loopsCompleted << " 轮, 通过 " << emitter->backendName() << " 发送 " << snapshot.eventsEmitted << " 个操作, 每秒 "
+              << QString::number(wallTime > 0 ? snapshot.eventsEmitted * 1e9 / wallTime : 0, 'f', 0) << " 个" << Qt::endl;
+#ifdef Q_OS_LINUX
+        if(X11Emitter *x11 = dynamic_cast<X11Emitter *>(emitter)){
+            out() << "送出 " << x11->flushCount() << " 次, 平均每次 "
+                  << QString::number(x11->flushCount() > 0 ? double(snapshot.eventsEmitted) / x11->flushCount() : 0, 'f', 2) << " 个操作" << Qt::endl;
+        }
+#endif
+    }
+    out() << "最终鼠标位置: " << cursorX << "," << cursorY << Qt::endl;
+    out() << "最大发送延迟: " << QString::number(snapshot.maxLateness / 1000000.0, 'f', 3) << " ms" << Qt::endl;
+    out() << "模拟时长: " << QString::number(simulated / 1e9, 'f', 3) << " s, 实际用时: " << QString::number(wallTime / 1000000.0, 'f', 2)
+          << " ms (" << QString::number(wallTime > 0 ? double(simulated) / wallTime : 0, 'f', 0) << " 倍)" << Qt::endl;
+    if(isLoopback){
+        out() << "校验值: " << QString::number(captureChecksum(captured), 16).rightJustified(16, '0') << Qt::endl;
+    }
+    if(!running.load()){
+        err() << "播放被中断" << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static const CommandInfo COMMANDS[] = {
+    {"batch", "批量检查和转换录制文件", batchCommand},
+    {"calibrate", "测量本机的计时和发送延迟", calibrateCommand},
+    {"compact", "精简录制文件", compactCommand},
+    {"edit", "剪切、插入、平移录制中的操作", editCommand},
+    {"events", "读取录制程序实时发布的操作", eventsCommand},
+    {"generate", "生成用于压力测试的录制文件", generateCommand},
+    {"macro", "编译宏程序, 或把录制导入为宏程序", macroCommand},
+    {"sessions", "在一个调度线程上同时播放多个会话", sessionsCommand},
+    {"simulate", "使用虚拟时钟立即完成多轮播放", simulateCommand},
+    {"timeline", "将录制的时间线绘制为图片", timelineCommand, true},
+    {"verify", "通过回环后端验证播放结果", verifyCommand},
+};
+
+int runCommandLine(int argc, char *argv[]){
+    if(argc < 2){
+        return -1;
+    }
+
+    const CommandInfo *command = nullptr;
+    for(const CommandInfo &item : COMMANDS){
+        if(qstrcmp(argv[1], item.name) == 0){
+            command = &item;
+            break;
+        }
+    }
+
+    if(!command){
+        return -1;
+    }
+
+#ifdef Q_OS_WIN
+    // 界面程序默认没有控制台, 从命令行启动时输出到启动它的控制台
+    if(AttachConsole(ATTACH_PARENT_PROCESS)){
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+#endif
+
+    QScopedPointer<QCoreApplication> app(command->gui ? new QGuiApplication(argc, argv) : new QCoreApplication(argc, argv));
+    QCoreApplication::setApplicationName(QString("KeyRecorder ") + command->name);
+
+    QStringList arguments = QCoreApplication::arguments();
+    arguments.removeAt(1);
+
+    int ret = command->func(arguments);
+    out().flush();
+    err().flush();
+    return ret;
+}
+
+void printCommandList(){
+    out() << "用法: KeyRecorder <命令> [参数], 命令后加 --help 查看参数" << Qt::endl;
+    for(const CommandInfo &command : COMMANDS){
+        out() << "  " << QString(command.name).leftJustified(12) << command.description << Qt::endl;
+    }
+    out().flush();
+}
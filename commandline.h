@@ -0,0 +1,12 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+// 命令行模式: 第一个参数是子命令时不显示界面, 执行完命令后退出
+// 返回命令的退出码, 不是命令行模式时返回 -1
+// 用法示例: KeyRecorder compact 录制.record 精简后.record --chatter-ms 3
+int runCommandLine(int argc, char *argv[]);
+
+// 输出所有子命令及说明
+void printCommandList();
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,189 @@
+#include "eventbus.h"
+
+#include <QCoreApplication>
+#include <QSharedMemory>
+
+#include <cstring>
+#include <new>
+
+using namespace EventBusLayout;
+
+QString EventBusLayout::sharedMemoryKey(qint64 pid){
+    return QString("KeyRecorder-events-%1").arg(pid);
+}
+
+EventBusPublisher::EventBusPublisher() = default;
+
+EventBusPublisher::~EventBusPublisher(){
+    if(m_header){
+        m_header->open.store(0, std::memory_order_release);
+    }
+    delete m_memory;
+}
+
+QString EventBusPublisher::key() const{
+    return sharedMemoryKey(QCoreApplication::applicationPid());
+}
+
+bool EventBusPublisher::start(QString *errorMsg){
+    if(m_header){
+        return true;
+    }
+
+    m_memory = new QSharedMemory(key());
+    if(!m_memory->create(SIZE)){
+        if(errorMsg){
+            *errorMsg = QString("创建共享内存 %1 失败: %2").arg(key(), m_memory->errorString());
+        }
+        delete m_memory;
+        m_memory = nullptr;
+        return false;
+    }
+
+    char *data = static_cast<char *>(m_memory->data());
+    std::memset(data, 0, SIZE);
+
+    // 先初始化所有位置, 最后写入 magic, 读取方看到 magic 后其它字段都已可用
+    m_slots = reinterpret_cast<Slot *>(data + sizeof(Header));
+    for(quint32 i = 0; i < CAPACITY; i++){
+        new (&m_slots[i].seq) std::atomic<quint64>(0);
+    }
+    Header *header = reinterpret_cast<Header *>(data);
+    header->version = VERSION;
+    header->capacity = CAPACITY;
+    header->slotSize = sizeof(Slot);
+    header->publisherPid = QCoreApplication::applicationPid();
+    new (&header->writeSeq) std::atomic<quint64>(0);
+    new (&header->open) std::atomic<quint32>(1);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+
+    m_header = header;
+    m_nextSeq = 0;
+    return true;
+}
+
+void EventBusPublisher::beginSession(int firstX, int firstY){
+    m_session++;
+    publish(0, BUS_RECORD_START, 0, false, firstX, firstY);
+}
+
+void EventBusPublisher::endSession(qint64 time){
+    publish(time, BUS_RECORD_STOP, 0, false);
+}
+
+void EventBusPublisher::publish(qint64 time, BusEventType type, int keyCode, bool isRelease, int dx, int dy){
+    if(!m_header){
+        return;
+    }
+
+    quint64 seq = m_nextSeq++;
+    Slot &slot = m_slots[seq & (CAPACITY - 1)];
+
+    // 写入期间标记该位置, 读取方读到的序号前后不一致时丢弃
+    slot.seq.store(WRITING, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    BusEvent &event = slot.event;
+    event.time = time;
+    event.session = m_session;
+    event.dx = dx;
+    event.dy = dy;
+    event.keyCode = qint16(keyCode);
+    event.type = type;
+    event.release = isRelease ? 1 : 0;
+
+    slot.seq.store(seq + 1, std::memory_order_release);
+    m_header->writeSeq.store(seq + 1, std::memory_order_release);
+}
+
+EventBusClient::EventBusClient() = default;
+
+EventBusClient::~EventBusClient(){
+    detach();
+}
+
+bool EventBusClient::attach(qint64 pid, QString *errorMsg){
+    detach();
+
+    m_memory = new QSharedMemory(sharedMemoryKey(pid));
+    if(!m_memory->attach(QSharedMemory::ReadOnly)){
+        if(errorMsg){
+            *errorMsg = QString("连接共享内存 %1 失败: %2").arg(sharedMemoryKey(pid), m_memory->errorString());
+        }
+        detach();
+        return false;
+    }
+
+    const char *data = static_cast<const char *>(m_memory->constData());
+    const Header *header = reinterpret_cast<const Header *>(data);
+    if(m_memory->size() < SIZE || header->magic != MAGIC || header->version != VERSION
+        || header->capacity != CAPACITY || header->slotSize != sizeof(Slot)){
+        if(errorMsg){
+            *errorMsg = QString("共享内存 %1 的格式不支持").arg(sharedMemoryKey(pid));
+        }
+        detach();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    m_header = header;
+    m_slots = reinterpret_cast<const Slot *>(data + sizeof(Header));
+    m_nextSeq = header->writeSeq.load(std::memory_order_acquire);
+    m_lost = 0;
+    return true;
+}
+
+void EventBusClient::detach(){
+    m_header = nullptr;
+    m_slots = nullptr;
+    delete m_memory;
+    m_memory = nullptr;
+}
+
+bool EventBusClient::isPublisherOpen() const{
+    return m_header && m_header->open.load(std::memory_order_acquire) != 0;
+}
+
+void EventBusClient::skipOverrun(){
+    // 多跳过一个位置, 发布方可能正在写入最早的位置
+    quint64 writeSeq = m_header->writeSeq.load(std::memory_order_acquire);
+    quint64 oldest = writeSeq > CAPACITY ? writeSeq - CAPACITY + 1 : 0;
+    if(m_nextSeq < oldest){
+        m_lost += oldest - m_nextSeq;
+        m_nextSeq = oldest;
+    }
+}
+
+int EventBusClient::read(BusEvent *events, int maxCount){
+    if(!m_header){
+        return 0;
+    }
+
+    int count = 0;
+    quint64 writeSeq = m_header->writeSeq.load(std::memory_order_acquire);
+    if(writeSeq - m_nextSeq > CAPACITY){
+        skipOverrun();
+    }
+
+    while(count < maxCount && m_nextSeq < writeSeq){
+        const Slot &slot = m_slots[m_nextSeq & (CAPACITY - 1)];
+
+        quint64 before = slot.seq.load(std::memory_order_acquire);
+        BusEvent event;
+        std::memcpy(&event, &slot.event, sizeof(event));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        quint64 after = slot.seq.load(std::memory_order_relaxed);
+
+        // 读取期间被覆盖, 或已经是下一圈的操作
+        if(before != m_nextSeq + 1 || after != before){
+            skipOverrun();
+            writeSeq = m_header->writeSeq.load(std::memory_order_acquire);
+            continue;
+        }
+
+        events[count++] = event;
+        m_nextSeq++;
+    }
+    return count;
+}
@@ -0,0 +1,134 @@
+#ifndef EVENTBUS_H
+#define EVENTBUS_H
+
+#include <QString>
+
+#include <atomic>
+#include <type_traits>
+
+class QSharedMemory;
+
+// 录制时把采集到的操作实时写入共享内存, 其它进程(悬浮窗、统计工具等)不需要自己安装钩子即可读取
+// 共享内存名称为 KeyRecorder-events-<进程id>, 内容为一个头部加一个单生产者多消费者的环形缓冲区
+// 每个位置带序号, 写入方从不等待读取方, 读取方落后超过一圈时通过序号发现并跳过被覆盖的操作
+
+// 共享内存中的操作类型, 前三项与 ActionType 相同
+enum BusEventType : quint8
+{
+    BUS_KEYBOARD,       // 键盘按键
+    BUS_MOUSE_BUTTON,   // 鼠标按键
+    BUS_MOUSE_MOVE,     // 鼠标移动
+    BUS_RECORD_START,   // 开始录制, dx,dy 为鼠标初始位置
+    BUS_RECORD_STOP     // 结束录制
+};
+
+// 一个操作, 固定24字节, 可直接按内存复制
+struct BusEvent
+{
+    qint64 time;// 距开始录制的时间 ns
+    quint32 session;// 第几次录制, 从1开始
+    qint32 dx;// 鼠标移动量
+    qint32 dy;
+    qint16 keyCode;// 键盘按键的扫描码, 或鼠标按键的虚拟键码
+    quint8 type;// BusEventType
+    quint8 release;// 是否为松开按键
+};
+
+static_assert(std::is_trivially_copyable<BusEvent>::value && sizeof(BusEvent) == 24, "BusEvent 必须是24字节的 POD");
+
+// 共享内存的布局, 发布方和读取方共用
+namespace EventBusLayout
+{
+    constexpr quint32 MAGIC = 0x3145524B;// "KRE1"
+    constexpr quint32 VERSION = 1;
+    // 环形缓冲区的操作数, 必须是2的幂
+    constexpr quint32 CAPACITY = 1 << 16;
+    // 位置正在被写入
+    constexpr quint64 WRITING = ~quint64(0);
+
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 capacity;
+        quint32 slotSize;
+        qint64 publisherPid;
+        // 下一个要写入的序号, 已写入的操作为 [writeSeq - capacity, writeSeq)
+        std::atomic<quint64> writeSeq;
+        // 发布方退出时置为0
+        std::atomic<quint32> open;
+    };
+
+    // 序号为 n 的操作写完后 seq 为 n + 1, 写入期间为 WRITING
+    struct Slot
+    {
+        std::atomic<quint64> seq;
+        BusEvent event;
+    };
+
+    static_assert(std::atomic<quint64>::is_always_lock_free, "共享内存中的序号必须是无锁原子变量");
+
+    constexpr int SIZE = int(sizeof(Header) + sizeof(Slot) * CAPACITY);
+
+    QString sharedMemoryKey(qint64 pid);
+}
+
+// 发布方, 由录制线程和原始输入回调写入
+// publish 不加锁, 调用方需保证同一时间只有一个线程写入(录制时在 recordLogMutex 内调用)
+class EventBusPublisher
+{
+public:
+    EventBusPublisher();
+    ~EventBusPublisher();
+
+    // 创建共享内存, 未调用或失败时 publish 不做任何事
+    bool start(QString *errorMsg = nullptr);
+    bool isStarted() const { return m_header != nullptr; }
+    QString key() const;
+
+    // 开始一次新的录制, 之后的操作使用新的录制序号
+    void beginSession(int firstX, int firstY);
+    void endSession(qint64 time);
+
+    void publish(qint64 time, BusEventType type, int keyCode, bool isRelease, int dx = 0, int dy = 0);
+
+private:
+    QSharedMemory *m_memory = nullptr;
+    EventBusLayout::Header *m_header = nullptr;
+    EventBusLayout::Slot *m_slots = nullptr;
+    // 只有发布方写入, 不需要读取共享内存中的值
+    quint64 m_nextSeq = 0;
+    quint32 m_session = 0;
+};
+
+// 读取方, 在其它进程中使用, 从连接时的位置开始读取新的操作
+class EventBusClient
+{
+public:
+    EventBusClient();
+    ~EventBusClient();
+
+    // 连接到进程 pid 的发布方
+    bool attach(qint64 pid, QString *errorMsg = nullptr);
+    void detach();
+
+    // 读取最多 maxCount 个新操作, 返回读取的个数, 没有新操作时立即返回0
+    int read(BusEvent *events, int maxCount);
+
+    // 因为落后超过一圈而丢失的操作数
+    quint64 lost() const { return m_lost; }
+    // 发布方是否仍在运行
+    bool isPublisherOpen() const;
+
+private:
+    QSharedMemory *m_memory = nullptr;
+    const EventBusLayout::Header *m_header = nullptr;
+    const EventBusLayout::Slot *m_slots = nullptr;
+    quint64 m_nextSeq = 0;
+    quint64 m_lost = 0;
+
+    // 跳到发布方当前仍保留的最早位置
+    void skipOverrun();
+};
+
+#endif // EVENTBUS_H
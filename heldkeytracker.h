@@ -0,0 +1,79 @@
+#ifndef HELDKEYTRACKER_H
+#define HELDKEYTRACKER_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+#include <atomic>
+
+// 按下状态表中鼠标按键的起始位置, 0~255 为键盘扫描码, 之后为鼠标按键虚拟键码
+#define HELD_MOUSE_BASE 256
+// 按下状态表的总位数
+#define HELD_KEY_BITS (HELD_MOUSE_BASE + 8)
+
+// 记录播放过程中由程序按下且尚未松开的按键
+// 每个按键占一位, 按下/松开时增量更新, 可在播放线程和主线程之间无锁共享
+class HeldKeyTracker
+{
+public:
+    static constexpr int WORD_COUNT = (HELD_KEY_BITS + 63) / 64;
+
+    // 标记键盘按键按下/松开
+    void setKey(int scanCode, bool pressed){
+        setBit(scanCode & 0xFF, pressed);
+    }
+
+    // 标记鼠标按键按下/松开
+    void setMouseButton(int mouseVK, bool pressed){
+        setBit(HELD_MOUSE_BASE + (mouseVK & 0x07), pressed);
+    }
+
+    bool isKeyHeld(int scanCode) const{
+        return testBit(scanCode & 0xFF);
+    }
+
+    bool isMouseButtonHeld(int mouseVK) const{
+        return testBit(HELD_MOUSE_BASE + (mouseVK & 0x07));
+    }
+
+    bool isEmpty() const{
+        for(int i = 0; i < WORD_COUNT; i++){
+            if(m_words[i].load(std::memory_order_acquire) != 0){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 取出并清空所有按下的按键, 对每个按键调用 func(bitIndex)
+    // 每个按下的按键只会被取出一次, 多个线程同时调用也不会重复松开
+    template<typename Func>
+    void takeAll(Func func){
+        for(int i = 0; i < WORD_COUNT; i++){
+            quint64 word = m_words[i].exchange(0, std::memory_order_acq_rel);
+            while(word != 0){
+                int bit = qCountTrailingZeroBits(word);
+                word &= word - 1;
+                func(i * 64 + bit);
+            }
+        }
+    }
+
+private:
+    std::atomic<quint64> m_words[WORD_COUNT] = {};
+
+    void setBit(int index, bool val){
+        quint64 mask = quint64(1) << (index & 63);
+        if(val){
+            m_words[index >> 6].fetch_or(mask, std::memory_order_acq_rel);
+        }else{
+            m_words[index >> 6].fetch_and(~mask, std::memory_order_acq_rel);
+        }
+    }
+
+    bool testBit(int index) const{
+        return (m_words[index >> 6].load(std::memory_order_acquire) >> (index & 63)) & 1;
+    }
+};
+
+#endif // HELDKEYTRACKER_H
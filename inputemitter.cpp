@@ -0,0 +1,65 @@
+#include "inputemitter.h"
+#include "key_map.h"
+#include "tracer.h"
+
+void InputEmitter::simulateKeyPress(short scanCode, bool isKeyRelease){
+    if(scanCode <= 0){
+        return;
+    }
+
+    // 先标记按下再发送, 先发送再清除松开, 保证并发松开时不会漏掉按键
+    if(!isKeyRelease){
+        m_heldKeys.setKey(scanCode, true);
+    }
+
+    sendKey(scanCode, isKeyRelease);
+
+    if(isKeyRelease){
+        m_heldKeys.setKey(scanCode, false);
+    }
+}
+
+void InputEmitter::simulateMouseAction(short mouseVK, bool isKeyRelease){
+    // 其它无效操作不模拟
+    if(!findMouseButtonByCode(mouseVK)){
+        return;
+    }
+
+    if(!isKeyRelease){
+        m_heldKeys.setMouseButton(mouseVK, true);
+    }
+
+    sendMouseButton(mouseVK, isKeyRelease);
+
+    if(isKeyRelease){
+        m_heldKeys.setMouseButton(mouseVK, false);
+    }
+}
+
+void InputEmitter::releaseHeldKeys(){
+    // 最多同时按下的按键数即状态表位数
+    int indices[HELD_KEY_BITS];
+    int count = 0;
+
+    m_heldKeys.takeAll([&](int index){
+        indices[count++] = index;
+    });
+
+    if(count > 0){
+        TraceScope scope("releaseHeldKeys", "count", count);
+        sendReleases(indices, count);
+    }
+
+    // 每轮和整个播放结束时都会调用, 不会有操作留在队列中
+    flush();
+}
+
+void InputEmitter::sendReleases(const int *indices, int count){
+    for(int i = 0; i < count; i++){
+        if(indices[i] < HELD_MOUSE_BASE){
+            sendKey(indices[i], true);
+        }else{
+            sendMouseButton(indices[i] - HELD_MOUSE_BASE, true);
+        }
+    }
+}
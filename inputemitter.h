@@ -0,0 +1,51 @@
+#ifndef INPUTEMITTER_H
+#define INPUTEMITTER_H
+
+#include "heldkeytracker.h"
+
+// 模拟键盘鼠标输入, 并记录由程序按下且尚未松开的按键
+// 子类实现具体的发送方式(系统输入、回环捕获等), 按下状态由本类统一维护
+class InputEmitter
+{
+public:
+    virtual ~InputEmitter() = default;
+
+    // 模拟键盘按键
+    void simulateKeyPress(short scanCode, bool isKeyRelease);
+    // 模拟鼠标按键, mouseVK 为鼠标按键虚拟键码
+    void simulateMouseAction(short mouseVK, bool isKeyRelease);
+    // 模拟鼠标相对移动
+    void simulateMouseRelativeMove(int dx, int dy) { sendMouseMove(dx, dy); }
+    // 模拟鼠标绝对移动
+    void simulateMouseAbsolutelyMove(int x, int y) { sendMouseMoveTo(x, y); }
+
+    // 后端名称, 用于区分不同后端测量的计时校准
+    virtual const char *backendName() const = 0;
+
+    // 获取鼠标的屏幕坐标
+    virtual bool getCursorPos(int *x, int *y) = 0;
+
+    // 松开所有由程序按下的按键, 后端支持时一次发送, 之后送出所有排队中的操作
+    void releaseHeldKeys();
+
+    // 送出排队中的操作, 直接发送的后端什么也不做
+    // 播放器在等待下一个操作前调用, 同一时刻到期的操作一起送出
+    virtual void flush() {}
+
+    const HeldKeyTracker &heldKeys() const { return m_heldKeys; }
+
+protected:
+    // 发送一个键盘按键, scanCode 有效
+    virtual void sendKey(short scanCode, bool isKeyRelease) = 0;
+    // 发送一个鼠标按键, mouseVK 有效
+    virtual void sendMouseButton(short mouseVK, bool isKeyRelease) = 0;
+    virtual void sendMouseMove(int dx, int dy) = 0;
+    virtual void sendMouseMoveTo(int x, int y) = 0;
+    // 松开多个按键, indices 为按下状态表中的位置, 默认逐个发送
+    virtual void sendReleases(const int *indices, int count);
+
+private:
+    HeldKeyTracker m_heldKeys;
+};
+
+#endif // INPUTEMITTER_H
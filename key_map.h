@@ -1,143 +1,284 @@
 #ifndef KEY_MAP_H
 #define KEY_MAP_H
 
-#include<QMap>
+#include <QStringView>
 
-// 键盘按键对应硬件扫描码map
-const static QMap<QString, short> VSC_MAP = {
+#include <array>
+
+// 模拟按键时需要加扩展码标志
+#define KEY_FLAG_EXTENDED 0x01
+
+struct KeyInfo
+{
+    const char16_t *name;// 按键名称, 与录制文件中的名称一致
+    short code;// 键盘按键为硬件扫描码, 鼠标按键为虚拟键码
+    quint8 flags;// 按键标志
+};
+
+// 键盘按键对应硬件扫描码表
+// 名称和扫描码都不能重复, 编译时检查
+inline constexpr KeyInfo KEYBOARD_KEYS[] = {
     // 下面是键盘的硬件扫描码
-    {"Esc",0x01},
-    {"1",0x02},
-    {"2",0x03},
-    {"3",0x04},
-    {"4",0x05},
-    {"5",0x06},
-    {"6",0x07},
-    {"7",0x08},
-    {"8",0x09},
-    {"9",0x0A},
-    {"0",0x0B},
-    {"-",0x0C},
-    {"=",0x0D},
-    {"BackSpace",0x0E},
-    {"Tab",0x0F},
-    {"Q",0x10},
-    {"W",0x11},
-    {"E",0x12},
-    {"R",0x13},
-    {"T",0x14},
-    {"Y",0x15},
-    {"U",0x16},
-    {"I",0x17},
-    {"O",0x18},
-    {"P",0x19},
-    {"[",0x1A},
-    {"]",0x1B},
-    {"Enter",0x1C},
-    {"Ctrl(Left)",0x1D},
-    {"A",0x1E},
-    {"S",0x1F},
-    {"D",0x20},
-    {"F",0x21},
-    {"G",0x22},
-    {"H",0x23},
-    {"J",0x24},
-    {"K",0x25},
-    {"L",0x26},
-    {";",0x27},
-    {"'",0x28},
-    {"`",0x29},
-    {"Shift(Left)",0x2A},
-    {"\\",0x2B},
-    {"Z",0x2C},
-    {"X",0x2D},
-    {"C",0x2E},
-    {"V",0x2F},
-    {"B",0x30},
-    {"N",0x31},
-    {"M",0x32},
-    {",",0x33},
-    {".",0x34},
-    {"/",0x35},
-    {"Shift(Right)",0x36},
-    {"*(Numpad)",0x37},
-    {"Alt(Left)",0x38},
-    {"Space",0x39},
-    {"Caps Lock",0x3A},
-    {"F1",0x3B},
-    {"F2",0x3C},
-    {"F3",0x3D},
-    {"F4",0x3E},
-    {"F5",0x3F},
-    {"F6",0x40},
-    {"F7",0x41},
-    {"F8",0x42},
-    {"F9",0x43},
-    {"F10",0x44},
-    {"Num Lock",0x45},
-    {"Scroll Lock",0x46},
-    {"7(Numpad)",0x47},
-    {"8(Numpad)",0x48},
-    {"9(Numpad)",0x49},
-    {"-(Numpad)",0x4A},
-    {"4(Numpad)",0x4B},
-    {"5(Numpad)",0x4C},
-    {"6(Numpad)",0x4D},
-    {"+(Numpad)",0x4E},
-    {"1(Numpad)",0x4F},
-    {"2(Numpad)",0x50},
-    {"3(Numpad)",0x51},
-    {"0(Numpad)",0x52},
-    {".(Numpad)",0x53},
-    {"F11",0x57},
-    {"F12",0x58},
-    {"F13",0x64},
-    {"F14",0x65},
-    {"F15",0x66},
-    {"$",0x7D},
-    {"=",0x8D},
-    {"^",0x90},
-    {"@",0x91},
-    {":",0x92},
-    {"_",0x93},
-    {"Enter(Numpad)",0x9C},
-    {"Ctrl(Right)",0x9D},
-    {",(Numpad)",0xB3},
-    {"/(Numpad)",0xB5},
-    {"Sys Rq",0xB7},
-    {"Alt(Right)",0xB8},
-    {"Pause",0xC5},
-    {"Home",0xC7},
-    {"↑",0xC8},
-    {"Page Up",0xC9},
-    {"←",0xCB},
-    {"→",0xCD},
-    {"End",0xCF},
-    {"↓",0xD0},
-    {"Page Down",0xD1},
-    {"Insert",0xD2},
-    {"Delete",0xD3},
-    {"Windows",0xDB},
-    {"Windows",0xDC},
-    {"Menu",0xDD},
-    {"Power",0xDE},
-    {"Windows",0xDF}
+    {u"Esc", 0x01, 0},
+    {u"1", 0x02, 0},
+    {u"2", 0x03, 0},
+    {u"3", 0x04, 0},
+    {u"4", 0x05, 0},
+    {u"5", 0x06, 0},
+    {u"6", 0x07, 0},
+    {u"7", 0x08, 0},
+    {u"8", 0x09, 0},
+    {u"9", 0x0A, 0},
+    {u"0", 0x0B, 0},
+    {u"-", 0x0C, 0},
+    {u"=", 0x0D, 0},
+    {u"BackSpace", 0x0E, 0},
+    {u"Tab", 0x0F, 0},
+    {u"Q", 0x10, 0},
+    {u"W", 0x11, 0},
+    {u"E", 0x12, 0},
+    {u"R", 0x13, 0},
+    {u"T", 0x14, 0},
+    {u"Y", 0x15, 0},
+    {u"U", 0x16, 0},
+    {u"I", 0x17, 0},
+    {u"O", 0x18, 0},
+    {u"P", 0x19, 0},
+    {u"[", 0x1A, 0},
+    {u"]", 0x1B, 0},
+    {u"Enter", 0x1C, 0},
+    {u"Ctrl(Left)", 0x1D, 0},
+    {u"A", 0x1E, 0},
+    {u"S", 0x1F, 0},
+    {u"D", 0x20, 0},
+    {u"F", 0x21, 0},
+    {u"G", 0x22, 0},
+    {u"H", 0x23, 0},
+    {u"J", 0x24, 0},
+    {u"K", 0x25, 0},
+    {u"L", 0x26, 0},
+    {u";", 0x27, 0},
+    {u"'", 0x28, 0},
+    {u"`", 0x29, 0},
+    {u"Shift(Left)", 0x2A, 0},
+    {u"\\", 0x2B, 0},
+    {u"Z", 0x2C, 0},
+    {u"X", 0x2D, 0},
+    {u"C", 0x2E, 0},
+    {u"V", 0x2F, 0},
+    {u"B", 0x30, 0},
+    {u"N", 0x31, 0},
+    {u"M", 0x32, 0},
+    {u",", 0x33, 0},
+    {u".", 0x34, 0},
+    {u"/", 0x35, 0},
+    {u"Shift(Right)", 0x36, 0},
+    {u"*(Numpad)", 0x37, 0},
+    {u"Alt(Left)", 0x38, 0},
+    {u"Space", 0x39, 0},
+    {u"Caps Lock", 0x3A, 0},
+    {u"F1", 0x3B, 0},
+    {u"F2", 0x3C, 0},
+    {u"F3", 0x3D, 0},
+    {u"F4", 0x3E, 0},
+    {u"F5", 0x3F, 0},
+    {u"F6", 0x40, 0},
+    {u"F7", 0x41, 0},
+    {u"F8", 0x42, 0},
+    {u"F9", 0x43, 0},
+    {u"F10", 0x44, 0},
+    {u"Num Lock", 0x45, 0},
+    {u"Scroll Lock", 0x46, 0},
+    {u"7(Numpad)", 0x47, 0},
+    {u"8(Numpad)", 0x48, 0},
+    {u"9(Numpad)", 0x49, 0},
+    {u"-(Numpad)", 0x4A, 0},
+    {u"4(Numpad)", 0x4B, 0},
+    {u"5(Numpad)", 0x4C, 0},
+    {u"6(Numpad)", 0x4D, 0},
+    {u"+(Numpad)", 0x4E, 0},
+    {u"1(Numpad)", 0x4F, 0},
+    {u"2(Numpad)", 0x50, 0},
+    {u"3(Numpad)", 0x51, 0},
+    {u"0(Numpad)", 0x52, 0},
+    {u".(Numpad)", 0x53, 0},
+    {u"F11", 0x57, 0},
+    {u"F12", 0x58, 0},
+    {u"F13", 0x64, 0},
+    {u"F14", 0x65, 0},
+    {u"F15", 0x66, 0},
+    {u"$", 0x7D, 0},
+    {u"=(Numpad)", 0x8D, 0},
+    {u"^", 0x90, 0},
+    {u"@", 0x91, 0},
+    {u":", 0x92, 0},
+    {u"_", 0x93, 0},
+    {u"Enter(Numpad)", 0x9C, 0},
+    {u"Ctrl(Right)", 0x9D, 0},
+    {u",(Numpad)", 0xB3, 0},
+    {u"/(Numpad)", 0xB5, 0},
+    {u"Sys Rq", 0xB7, 0},
+    {u"Alt(Right)", 0xB8, 0},
+    {u"Pause", 0xC5, KEY_FLAG_EXTENDED},
+    {u"Home", 0xC7, KEY_FLAG_EXTENDED},
+    {u"↑", 0xC8, KEY_FLAG_EXTENDED},
+    {u"Page Up", 0xC9, KEY_FLAG_EXTENDED},
+    {u"←", 0xCB, KEY_FLAG_EXTENDED},
+    {u"→", 0xCD, KEY_FLAG_EXTENDED},
+    {u"End", 0xCF, KEY_FLAG_EXTENDED},
+    {u"↓", 0xD0, KEY_FLAG_EXTENDED},
+    {u"Page Down", 0xD1, KEY_FLAG_EXTENDED},
+    {u"Insert", 0xD2, KEY_FLAG_EXTENDED},
+    {u"Delete", 0xD3, KEY_FLAG_EXTENDED},
+    {u"Windows", 0xDB, KEY_FLAG_EXTENDED},
+    {u"Windows(Right)", 0xDC, KEY_FLAG_EXTENDED},
+    {u"Menu", 0xDD, KEY_FLAG_EXTENDED},
+    {u"Power", 0xDE, KEY_FLAG_EXTENDED},
+    {u"Sleep", 0xDF, KEY_FLAG_EXTENDED},
 };
+inline constexpr int KEYBOARD_KEY_COUNT = sizeof(KEYBOARD_KEYS) / sizeof(KEYBOARD_KEYS[0]);
 
 
-// 鼠标按键虚拟键码map
+// 鼠标按键虚拟键码表
 // 常用的鼠标按键虚拟键码
 // #define VK_LBUTTON    0x01  // 左键
 // #define VK_RBUTTON    0x02  // 右键
 // #define VK_MBUTTON    0x04  // 中键（滚轮按下）
 // #define VK_XBUTTON1   0x05  // 侧键1（后退）
 // #define VK_XBUTTON2   0x06  // 侧键2（前进）
-const static QMap<QString, short> MOUSE_VK_MAP = {
-    {"mouseLeft", 0x01},// 左键
-    {"mouseRight", 0x02},// 右键
-    {"mouseMiddle", 0x04},// 中键（滚轮按下）
-    {"mouseSide1", 0x05}, // 侧键1（后退）
-    {"mouseSide2", 0x06}, // 侧键2（前进）
+inline constexpr KeyInfo MOUSE_BUTTONS[] = {
+    {u"mouseLeft", 0x01, 0},// 左键
+    {u"mouseRight", 0x02, 0},// 右键
+    {u"mouseMiddle", 0x04, 0},// 中键（滚轮按下）
+    {u"mouseSide1", 0x05, 0}, // 侧键1（后退）
+    {u"mouseSide2", 0x06, 0}, // 侧键2（前进）
 };
+inline constexpr int MOUSE_BUTTON_COUNT = sizeof(MOUSE_BUTTONS) / sizeof(MOUSE_BUTTONS[0]);
+
+
+// 编译时生成的查找表, 没有运行时初始化
+namespace KeyMapDetail {
+
+// 名称哈希表大小, 必须是2的幂
+constexpr int HASH_SIZE = 1024;
+// 使 KEYBOARD_KEYS 所有名称落在不同槽位的哈希种子, 修改按键表后若编译报错需重新选取
+constexpr quint32 HASH_SEED = 0x811C9DE9;
+
+static_assert(KEYBOARD_KEY_COUNT < 255, "按键序号需要用 quint8 保存");
+
+constexpr int nameLength(const char16_t *name){
+    int len = 0;
+    while(name[len]){
+        len++;
+    }
+    return len;
+}
+
+// FNV-1a 哈希, 按 UTF-16 编码计算, 与 QString 的存储一致
+constexpr quint32 nameHash(const char16_t *name, int len){
+    quint32 hash = HASH_SEED;
+    for(int i = 0; i < len; i++){
+        hash ^= name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 名称哈希槽 -> 按键序号+1, 0表示空槽
+struct HashTable
+{
+    std::array<quint8, HASH_SIZE> slots{};
+    bool perfect = true;// 没有冲突
+};
+
+constexpr HashTable buildHashTable(){
+    HashTable table;
+    for(int i = 0; i < KEYBOARD_KEY_COUNT; i++){
+        const char16_t *name = KEYBOARD_KEYS[i].name;
+        quint32 slot = nameHash(name, nameLength(name)) & (HASH_SIZE - 1);
+        if(table.slots[slot] != 0){
+            table.perfect = false;
+        }
+        table.slots[slot] = quint8(i + 1);
+    }
+    return table;
+}
+
+// 扫描码 -> 按键序号, -1表示没有该扫描码
+struct CodeTable
+{
+    std::array<short, 256> index{};
+    bool unique = true;// 扫描码没有重复
+};
+
+constexpr CodeTable buildCodeTable(){
+    CodeTable table;
+    for(int i = 0; i < 256; i++){
+        table.index[i] = -1;
+    }
+    for(int i = 0; i < KEYBOARD_KEY_COUNT; i++){
+        int code = KEYBOARD_KEYS[i].code & 0xFF;
+        if(table.index[code] != -1){
+            table.unique = false;
+        }
+        table.index[code] = short(i);
+    }
+    return table;
+}
+
+inline constexpr HashTable HASH_TABLE = buildHashTable();
+inline constexpr CodeTable CODE_TABLE = buildCodeTable();
+
+// 名称重复的两个按键必然落在同一槽位, 所以这里同时检查了名称重复
+static_assert(HASH_TABLE.perfect, "按键名称重复, 或需要重新选取 HASH_SEED");
+static_assert(CODE_TABLE.unique, "扫描码重复");
+
+} // namespace KeyMapDetail
+
+
+// 按名称查找键盘按键的扫描码, 找不到返回-1
+inline short findScanCode(QStringView name){
+    quint32 slot = KeyMapDetail::nameHash(name.utf16(), int(name.size())) & (KeyMapDetail::HASH_SIZE - 1);
+    int index = KeyMapDetail::HASH_TABLE.slots[slot] - 1;
+    if(index < 0 || QStringView(KEYBOARD_KEYS[index].name) != name){
+        return -1;
+    }
+    return KEYBOARD_KEYS[index].code;
+}
+
+// 扫描码对应的键盘按键, 没有时返回空
+inline const KeyInfo *findKeyByScanCode(int scanCode){
+    if(scanCode < 0 || scanCode > 0xFF){
+        return nullptr;
+    }
+    int index = KeyMapDetail::CODE_TABLE.index[scanCode];
+    return index < 0 ? nullptr : &KEYBOARD_KEYS[index];
+}
+
+// 扫描码的按键标志
+inline quint8 scanCodeFlags(int scanCode){
+    const KeyInfo *key = findKeyByScanCode(scanCode);
+    return key ? key->flags : 0;
+}
+
+// 按名称查找鼠标按键的虚拟键码, 找不到返回-1
+inline short findMouseButton(QStringView name){
+    for(const KeyInfo &button : MOUSE_BUTTONS){
+        if(QStringView(button.name) == name){
+            return button.code;
+        }
+    }
+    return -1;
+}
+
+// 虚拟键码对应的鼠标按键, 没有时返回空
+inline const KeyInfo *findMouseButtonByCode(int mouseVK){
+    for(const KeyInfo &button : MOUSE_BUTTONS){
+        if(button.code == mouseVK){
+            return &button;
+        }
+    }
+    return nullptr;
+}
 
 #endif // KEY_MAP_H
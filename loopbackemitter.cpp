@@ -0,0 +1,27 @@
+#include "loopbackemitter.h"
+
+bool LoopbackEmitter::getCursorPos(int *x, int *y){
+    *x = m_cursorX;
+    *y = m_cursorY;
+    return true;
+}
+
+void LoopbackEmitter::sendKey(short scanCode, bool isKeyRelease){
+    m_captured.append(ActionInfo{now(), scanCode, 0, 0, isKeyRelease, ACTION_KEYBOARD});
+}
+
+void LoopbackEmitter::sendMouseButton(short mouseVK, bool isKeyRelease){
+    m_captured.append(ActionInfo{now(), mouseVK, 0, 0, isKeyRelease, ACTION_MOUSE_BUTTON});
+}
+
+void LoopbackEmitter::sendMouseMove(int dx, int dy){
+    m_cursorX += dx;
+    m_cursorY += dy;
+    m_captured.append(ActionInfo{now(), 0, dx, dy, false, ACTION_MOUSE_MOVE});
+}
+
+void LoopbackEmitter::sendMouseMoveTo(int x, int y){
+    // 录制中没有绝对移动, 只更新位置
+    m_cursorX = x;
+    m_cursorY = y;
+}
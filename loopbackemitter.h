@@ -0,0 +1,43 @@
+#ifndef LOOPBACKEMITTER_H
+#define LOOPBACKEMITTER_H
+
+#include "inputemitter.h"
+#include "playbackclock.h"
+#include "recordfile.h"
+
+#include <QList>
+
+// 不发送到系统, 将发送的操作连同发送时间记录下来, 用于验证播放结果
+// 可在没有图形界面的系统上运行
+class LoopbackEmitter : public InputEmitter
+{
+public:
+    // 记录时间所用的时间轴, 与播放共用时记录的时间可直接与录制比较
+    void setClock(const PlaybackClock *clock) { m_clock = clock; }
+
+    const char *backendName() const override { return "loopback"; }
+
+    // 设置模拟的鼠标位置
+    void setCursorPos(int x, int y) { m_cursorX = x, m_cursorY = y; }
+    bool getCursorPos(int *x, int *y) override;
+
+    // 记录到的操作, actionTime 为发送时时间轴的时间 ns
+    const QList<ActionInfo> &captured() const { return m_captured; }
+    void clear() { m_captured.clear(); }
+
+protected:
+    void sendKey(short scanCode, bool isKeyRelease) override;
+    void sendMouseButton(short mouseVK, bool isKeyRelease) override;
+    void sendMouseMove(int dx, int dy) override;
+    void sendMouseMoveTo(int x, int y) override;
+
+private:
+    qint64 now() const { return m_clock ? m_clock->nsecsElapsed() : 0; }
+
+    const PlaybackClock *m_clock = nullptr;
+    QList<ActionInfo> m_captured;
+    int m_cursorX = 0;
+    int m_cursorY = 0;
+};
+
+#endif // LOOPBACKEMITTER_H
@@ -0,0 +1,319 @@
+#include "macroprogram.h"
+#include "actiontransform.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTextStream>
+
+#include <limits>
+
+// 两个非负数相加或相乘, 超出 qint64 时取最大值
+static qint64 saturatedAdd(qint64 a, qint64 b){
+    return a > std::numeric_limits<qint64>::max() - b ? std::numeric_limits<qint64>::max() : a + b;
+}
+
+static qint64 saturatedMultiply(qint64 a, qint64 b){
+    return b > 0 && a > std::numeric_limits<qint64>::max() / b ? std::numeric_limits<qint64>::max() : a * b;
+}
+
+// 遍历指令计算展开后的总量, segmentValue 为一个片段的量, waitValue 为一次等待的量
+// emptyForever 不为空时设为第一个循环体总量为0的一直循环的 repeat 指令位置, 没有时为-1
+template<class SegmentValue, class WaitValue>
+static qint64 expandedTotal(const MacroProgram &program, SegmentValue segmentValue, WaitValue waitValue, int *emptyForever = nullptr){
+    // 每层循环开始前的累计值和 repeat 指令的位置
+    QList<QPair<qint64, int>> stack;
+    qint64 total = 0;
+    bool forever = false;
+
+    if(emptyForever){
+        *emptyForever = -1;
+    }
+
+    for(int ip = 0; ip < program.code.size(); ip++){
+        const MacroInstruction &instruction = program.code[ip];
+        switch(instruction.opcode){
+        case MACRO_PLAY:
+            total = saturatedAdd(total, segmentValue(*program.segments[instruction.operand]));
+            break;
+        case MACRO_WAIT:
+            total = saturatedAdd(total, waitValue(instruction.value));
+            break;
+        case MACRO_REPEAT:
+            stack.append({total, ip});
+            total = 0;
+            break;
+        case MACRO_NEXT:{
+            QPair<qint64, int> outer = stack.takeLast();
+            int count = program.code[outer.second].operand;
+            if(count <= 0){
+                forever = true;
+                if(emptyForever && *emptyForever < 0 && total <= 0){
+                    *emptyForever = outer.second;
+                }
+            }
+            total = saturatedAdd(outer.first, saturatedMultiply(total, qMax(1, count)));
+            break;
+        }
+        case MACRO_END:
+            break;
+        }
+    }
+
+    return forever ? -1 : total;
+}
+
+qint64 MacroProgram::duration() const{
+    return expandedTotal(*this, [](const RecordData &data){ return data.duration(); }, [](qint64 wait){ return wait; });
+}
+
+qint64 MacroProgram::actionCount() const{
+    return expandedTotal(*this, [](const RecordData &data){ return qint64(data.actionList.size()); }, [](qint64){ return qint64(0); });
+}
+
+QString MacroProgram::disassemble() const{
+    QString text;
+    for(int i = 0; i < code.size(); i++){
+        const MacroInstruction &instruction = code[i];
+        text.append(QString("%1 ").arg(i, 4, 10, QChar('0')));
+        switch(instruction.opcode){
+        case MACRO_PLAY:{
+            const RecordData &segment = *segments[instruction.operand];
+            text.append(QString("play %1 (%2, %3 个操作, %4 ms)").arg(instruction.operand).arg(segment.name)
+                            .arg(segment.actionList.size()).arg(segment.duration() / 1000000.0));
+            break;
+        }
+        case MACRO_WAIT:
+            text.append(QString("wait %1 ms").arg(instruction.value / 1000000.0));
+            break;
+        case MACRO_REPEAT:
+            text.append(instruction.operand > 0 ? QString("repeat %1").arg(instruction.operand) : QString("repeat forever"));
+            break;
+        case MACRO_NEXT:
+            text.append(QString("next -> %1").arg(instruction.operand, 4, 10, QChar('0')));
+            break;
+        case MACRO_END:
+            text.append("end");
+            break;
+        }
+        text.append("\n");
+    }
+    return text;
+}
+
+bool loadMacroFile(const QString &filePath, MacroProgram *program, QString *errorMsg, const std::atomic<bool> *running){
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法打开文件:" + filePath;
+        }
+        return false;
+    }
+
+    *program = MacroProgram();
+
+    // 片段文件名和序号, 同一录制只加载一次
+    QStringList segmentNames;
+    QHash<QString, int> segmentIndex;
+    // 未结束的循环: 循环体第一条指令的位置和开始行号
+    QList<QPair<int, int>> loops;
+    // repeat 指令的位置和所在行号, 用于报告循环体的错误
+    QHash<int, int> repeatLines;
+
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while(!in.atEnd()){
+        QString line = in.readLine().trimmed();
+        lineNumber++;
+
+        // 空行和注释
+        if(line.isEmpty() || line.startsWith('#')){
+            continue;
+        }
+
+        auto fail = [&](const QString &reason){
+            if(errorMsg){
+                *errorMsg = QString("%1 第%2行%3: %4").arg(filePath).arg(lineNumber).arg(reason, line);
+            }
+            return false;
+        };
+
+        if(line == "}"){
+            if(loops.isEmpty()){
+                return fail("没有对应的 repeat");
+            }
+            int bodyStart = loops.takeLast().first;
+            if(bodyStart == program->code.size()){
+                return fail("循环体为空");
+            }
+            program->code.append(MacroInstruction{MACRO_NEXT, bodyStart, 0});
+            continue;
+        }
+
+        // 文件名可能包含空格, 只按第一个空格分开语句名称和参数
+        int spaceIndex = line.indexOf(' ');
+        QString name = spaceIndex < 0 ? line : line.left(spaceIndex);
+        QString argument = spaceIndex < 0 ? QString() : line.mid(spaceIndex + 1).trimmed();
+
+        if(name == "play"){
+            if(argument.isEmpty()){
+                return fail("缺少录制文件名");
+            }
+            if(!argument.endsWith(RECORD_SUFFIX)){
+                argument.append(RECORD_SUFFIX);
+            }
+            int index = segmentIndex.value(argument, -1);
+            if(index < 0){
+                index = segmentNames.size();
+                segmentNames.append(argument);
+                segmentIndex.insert(argument, index);
+            }
+            program->code.append(MacroInstruction{MACRO_PLAY, index, 0});
+        }else if(name == "wait"){
+            bool ok;
+            double ms = argument.toDouble(&ok);
+            if(!ok || ms < 0){
+                return fail("等待时间错误");
+            }
+            program->code.append(MacroInstruction{MACRO_WAIT, 0, qint64(ms * 1000000)});
+        }else if(name == "repeat"){
+            if(!argument.endsWith('{')){
+                return fail("repeat 行需要以 { 结尾");
+            }
+            bool ok;
+            int count = argument.chopped(1).trimmed().toInt(&ok);
+            if(!ok || count < 0){
+                return fail("循环次数错误");
+            }
+            repeatLines.insert(int(program->code.size()), lineNumber);
+            program->code.append(MacroInstruction{MACRO_REPEAT, count, 0});
+            loops.append({int(program->code.size()), lineNumber});
+            program->maxDepth = qMax(program->maxDepth, int(loops.size()));
+        }else{
+            return fail("未知语句");
+        }
+    }
+
+    if(!loops.isEmpty()){
+        if(errorMsg){
+            *errorMsg = QString("%1 第%2行: repeat 没有对应的 }").arg(filePath).arg(loops.last().second);
+        }
+        return false;
+    }
+    if(segmentNames.isEmpty()){
+        if(errorMsg){
+            *errorMsg = "宏程序中没有播放的录制:" + filePath;
+        }
+        return false;
+    }
+    program->code.append(MacroInstruction{MACRO_END, 0, 0});
+
+    // 加载片段
+    QString dir = QFileInfo(filePath).absolutePath() + "/";
+    for(const QString &segmentName : std::as_const(segmentNames)){
+        QSharedPointer<RecordData> data(new RecordData);
+        if(!loadRecordFile(dir + segmentName, data.data(), errorMsg, running)){
+            return false;
+        }
+        program->segments.append(data);
+    }
+
+    // 一直循环的循环体展开后时长为0时, 播放会不停执行循环而一直占用CPU
+    int emptyForever;
+    expandedTotal(*program, [](const RecordData &data){ return data.duration(); }, [](qint64 wait){ return wait; }, &emptyForever);
+    if(emptyForever >= 0){
+        if(errorMsg){
+            *errorMsg = QString("%1 第%2行: 一直循环的循环体时长为0").arg(filePath).arg(repeatLines.value(emptyForever));
+        }
+        return false;
+    }
+
+    // 第一个播放的片段决定初始鼠标位置
+    for(const MacroInstruction &instruction : std::as_const(program->code)){
+        if(instruction.opcode == MACRO_PLAY){
+            const RecordData &first = *program->segments[instruction.operand];
+            program->header.name = QFileInfo(filePath).fileName();
+            program->header.firstX = first.firstX;
+            program->header.firstY = first.firstY;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool expandMacro(const MacroProgram &program, RecordData *data, QString *errorMsg, ActionTransform *transform){
+    if(program.duration() < 0){
+        if(errorMsg){
+            *errorMsg = "宏程序一直循环, 无法展开:" + program.header.name;
+        }
+        return false;
+    }
+
+    qint64 actionCount = program.actionCount();
+    if(actionCount > MACRO_MAX_EXPANDED_ACTIONS){
+        if(errorMsg){
+            *errorMsg = QString("宏程序展开后有 %1 个操作, 超过 %2 个, 无法展开:").arg(actionCount).arg(MACRO_MAX_EXPANDED_ACTIONS)
+                        + program.header.name;
+        }
+        return false;
+    }
+
+    *data = program.header;
+    data->actionList.reserve(actionCount);
+
+    // 与播放时相同的解释执行, 只是把操作按时间追加到列表
+    if(transform){
+        transform->reset();
+    }
+    QList<int> counters;
+    qint64 time = 0;
+    for(int ip = 0; program.code[ip].opcode != MACRO_END; ){
+        const MacroInstruction &instruction = program.code[ip++];
+        switch(instruction.opcode){
+        case MACRO_PLAY:{
+            const RecordData &segment = *program.segments[instruction.operand];
+            for(ActionInfo actionInfo : segment.actionList){
+                if(transform && !transform->apply(actionInfo)){
+                    continue;
+                }
+                actionInfo.actionTime += time;
+                data->actionList.append(actionInfo);
+            }
+            time += transform ? transform->duration(segment.duration()) : segment.duration();
+            break;
+        }
+        case MACRO_WAIT:
+            time += instruction.value;
+            break;
+        case MACRO_REPEAT:
+            counters.append(instruction.operand);
+            break;
+        case MACRO_NEXT:
+            if(counters.last() <= 0 || --counters.last() > 0){
+                ip = instruction.operand;
+            }else{
+                counters.removeLast();
+            }
+            break;
+        case MACRO_END:
+            break;
+        }
+    }
+    return true;
+}
+
+bool saveMacroImport(const QString &filePath, const QString &recordName, QString *errorMsg){
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法创建文件:" + filePath;
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "# 由 " << recordName << " 导入, 可将重复的部分剪成单独的录制后用 repeat 组合\n";
+    out << "play " << recordName << "\n";
+    return true;
+}
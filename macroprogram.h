@@ -0,0 +1,72 @@
+#ifndef MACROPROGRAM_H
+#define MACROPROGRAM_H
+
+#include "recordfile.h"
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+#define MACRO_SUFFIX ".macro"
+
+// 展开后最多的操作数, 超过时不展开, 避免一次分配过多内存
+#define MACRO_MAX_EXPANDED_ACTIONS 16000000
+
+// 一直循环时每次循环至少前进的时长 ns, 变换使循环体时长变为0时也不会一直占用CPU
+#define MACRO_MIN_FOREVER_PERIOD 1000000
+
+class ActionTransform;
+
+// 宏程序的指令
+enum MacroOpcode : quint8
+{
+    MACRO_PLAY,  // 播放片段 operand, 时间前进片段时长
+    MACRO_WAIT,  // 时间前进 value ns
+    MACRO_REPEAT,// 循环开始, 循环次数 operand 压入计数栈, <=0 表示一直循环
+    MACRO_NEXT,  // 循环结束, 计数未完成时跳到 operand(循环体第一条指令), 完成时出栈
+    MACRO_END    // 程序结束
+};
+
+struct MacroInstruction
+{
+    MacroOpcode opcode;
+    int operand;
+    qint64 value;
+};
+
+// 编译后的宏程序: 引用录制片段, 重复的部分只保存一次
+// 播放时按指令指针和循环计数解释执行, 内存和加载时间只与程序大小有关, 与展开后的时长无关
+struct MacroProgram
+{
+    QList<QSharedPointer<const RecordData>> segments;// 片段, 同一录制只加载一次
+    QList<MacroInstruction> code;// 以 MACRO_END 结尾
+    int maxDepth = 0;// 循环的最大嵌套层数
+    RecordData header;// 第一个片段的初始鼠标位置, 没有操作
+
+    // 展开后的时长和操作数, 有一直循环的部分时返回-1, 超出 qint64 时为 qint64 的最大值
+    qint64 duration() const;
+    qint64 actionCount() const;
+
+    // 每行一条指令的文本
+    QString disassemble() const;
+};
+
+// 读取并编译宏程序文件, 片段文件相对宏程序所在的文件夹
+// 每行一条语句, 以#开头的行为注释:
+//   play 录制文件名      播放录制, 扩展名可省略
+//   wait 毫秒           等待
+//   repeat 次数 {       重复到对应的 "}", 次数为0表示一直循环, 可以嵌套; 一直循环的循环体时长不能为0
+//   }
+bool loadMacroFile(const QString &filePath, MacroProgram *program, QString *errorMsg = nullptr, const std::atomic<bool> *running = nullptr);
+
+// 展开为按顺序播放的录制, 用于验证; 有一直循环的部分或操作数超过 MACRO_MAX_EXPANDED_ACTIONS 时返回false
+// transform 不为空时与播放时相同: 每个片段单独变换(时间相对片段开始), 按变换后的片段时长前进, 等待不变换
+bool expandMacro(const MacroProgram &program, RecordData *data, QString *errorMsg = nullptr, ActionTransform *transform = nullptr);
+
+// 把录制导入为宏程序: 生成只播放该录制一个片段的宏程序文件
+bool saveMacroImport(const QString &filePath, const QString &recordName, QString *errorMsg = nullptr);
+
+#endif // MACROPROGRAM_H
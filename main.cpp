@@ -1,14 +1,70 @@
+#include "commandline.h"
+#include "tracer.h"
+
+#include <QByteArray>
+
+#ifdef Q_OS_WIN
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QDebug>
+#endif
+
+// --trace <文件>: 记录录制和播放的时间线, 界面中每次结束录制或播放时写入文件, 命令行在命令结束时写入
+// 在分派命令前处理并从参数中去掉, 界面和所有命令都可以使用
+static void startTrace(int *argc, char *argv[]){
+    for(int i = 1; i + 1 < *argc; i++){
+        if(qstrcmp(argv[i], "--trace") != 0){
+            continue;
+        }
+
+        Tracer::start(QString::fromLocal8Bit(argv[i + 1]));
+        Tracer::setThreadName("main");
+        for(int j = i + 2; j <= *argc; j++){
+            argv[j - 2] = argv[j];
+        }
+        *argc -= 2;
+        return;
+    }
+}
 
 int main(int argc, char *argv[])
 {
+    startTrace(&argc, argv);
+
+    // 命令行模式, 不显示界面
+    int ret = runCommandLine(argc, argv);
+    if(ret >= 0){
+        Tracer::flush();
+        return ret;
+    }
+
+#ifdef Q_OS_WIN
     QApplication a(argc, argv);
+    QStringList arguments = a.arguments();
+
     MainWindow w;
 
+    // --event-bus: 录制时把操作发布到共享内存 KeyRecorder-events-<进程id>
+    if(arguments.contains("--event-bus")){
+        QString errorMsg;
+        if(!w.startEventBus(&errorMsg)){
+            qWarning() << errorMsg;
+        }
+    }
+
+    // --fixed-poll: 录制时一直按固定间隔采样, 不在空闲时降低采样频率
+    if(arguments.contains("--fixed-poll")){
+        w.setAdaptivePolling(false);
+    }
+
     w.setWindowTitle("KeyRecorder v0.0.1");
 
     w.show();
     return a.exec();
+#else
+    // 录制和播放界面只支持 Windows, 其他系统只提供命令行
+    printCommandList();
+    return 1;
+#endif
 }
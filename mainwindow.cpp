@@ -1,29 +1,58 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "actionlog.h"
 #include "key_map.h"
+#include "macroprogram.h"
+#include "metricsserver.h"
+#include "multitrackplayer.h"
+#include "recorddirwatcher.h"
+#include "timelinepyramid.h"
+#include "timingprofile.h"
+#include "tracer.h"
+#include "recordsequencer.h"
 #include <windows.h>
 
 #include <QtConcurrent>
 #include <QSet>
 #include <QCursor>
+#include <QFileInfo>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QScreen>
 
 MainWindow *mainWindow = nullptr;
 
-// 按键记录
-QString recordStr = "";
-QMutex recordStrMutex;
+// 按键记录: 固定大小的块组成的日志, 块在多次录制之间复用
+static ActionChunkPool recordChunkPool;
+ActionLog recordLog(&recordChunkPool);
+QMutex recordLogMutex;
 
 // 全局钩子句柄
 static HHOOK g_keyboardHook = nullptr;
 
+// 当前线程的CPU时间 ns
+static qint64 currentThreadCpuTime(){
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if(!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)){
+        return 0;
+    }
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    // 单位为 100ns
+    return qint64(kernel.QuadPart + user.QuadPart) * 100;
+}
+
 // 低级键盘钩子过程函数
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode >= 0) {
         KBDLLHOOKSTRUCT* kbStruct = (KBDLLHOOKSTRUCT*)lParam;
 
+        // 任何按键按下或松开都唤醒空闲中的录制线程
+        mainWindow->wakeRecorder();
+
         // 检查按键按下事件（WM_KEYDOWN 或 WM_SYSKEYDOWN）
         if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
             // 检查是否为 F7 或 F8 键
@@ -37,10 +66,16 @@ LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
             }else if(kbStruct->vkCode == VK_F8){
                 //qDebug() << "F8 press";
 
-                // 使用Qt的信号机制确保在主线程中执行
-                QMetaObject::invokeMethod(mainWindow, [=]() {
-                    mainWindow->startPlayOrStop();
-                }, Qt::QueuedConnection);
+                // 按下热键的时间, 用于统计到发送第一个操作的耗时
+                qint64 triggerTime = Tracer::now();
+
+                // 已准备好时直接开始播放, 不等待主线程处理消息
+                if(!mainWindow->triggerArmedPlayback(triggerTime)){
+                    // 使用Qt的信号机制确保在主线程中执行
+                    QMetaObject::invokeMethod(mainWindow, [=]() {
+                        mainWindow->startPlayOrStop(triggerTime);
+                    }, Qt::QueuedConnection);
+                }
             }
         }
     }
@@ -53,27 +88,84 @@ MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
+    m_startupTimer.start();
     ui->setupUi(this);
     mainWindow = this;
-
-    // 获取软件本地数据目录
-    appDataDir = QDir::homePath() + "/AppData/Local/KeyRecorderData/";
-    QDir dir = QDir(QDir::homePath() + "/AppData/Local/");
-    // 使用 QDir 创建不存在的目录
-    if (!dir.exists("KeyRecorderData")) {
-        if (!dir.mkdir("KeyRecorderData")) {
-            QMessageBox::critical(this, "错误","存放录制文件的文件夹创建失败");
-            //return;
+    markStartup("setupUi");
+
+    // 获取软件本地数据目录, 文件夹在后台扫描时创建
+    appDataDir = defaultRecordDir();
+
+    // 预先分配录制日志的块, 开始录制后的前几秒不需要分配内存
+    recordChunkPool.reserve(16);
+
+    // 录制线程空闲时等待该事件
+    m_recordWakeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    // 播放线程在没有播放时等待该事件
+    m_playEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    m_playerThread = QThread::create([=](){ playerLoop(); });
+    m_playerThread->start();
+
+    // 提示框隐藏后保留, 下一次直接显示
+    m_overlayTimer.setSingleShot(true);
+
+    // 选择录制文件时显示其时间线, 并预先准备播放
+    connect(ui->comboBox, &QComboBox::currentTextChanged, this, &MainWindow::updateTimeline);
+    connect(&m_timelineBuild, &QFutureWatcher<QSharedPointer<TimelinePyramid>>::finished, this, &MainWindow::applyTimeline);
+    connect(ui->comboBox, &QComboBox::currentTextChanged, this, &MainWindow::armPlayback);
+
+    // 在后台扫描录制文件, 之后文件夹变化时只更新变化的文件
+    m_recordDirWatcher = new RecordDirWatcher({"*" RECORD_SUFFIX, "*" PLAYLIST_SUFFIX, "*" TRACKS_SUFFIX, "*" MACRO_SUFFIX}, this);
+    connect(m_recordDirWatcher, &RecordDirWatcher::filesAdded, this, &MainWindow::addRecordFiles);
+    connect(m_recordDirWatcher, &RecordDirWatcher::filesRemoved, this, &MainWindow::removeRecordFiles);
+    // 文件夹中的文件被修改或删除后都会重新扫描, 此时检查预先准备的内容是否过期, 按下热键时不再检查
+    connect(m_recordDirWatcher, &RecordDirWatcher::scanFinished, this, &MainWindow::checkArmedSources);
+    connect(m_recordDirWatcher, &RecordDirWatcher::scanFinished, this, [=](int fileCount, qint64 elapsed){
+        if(!m_startupTimes.contains("scan")){
+            m_startupTimes["scan_files"] = fileCount;
+            m_startupTimes["scan_worker_ms"] = elapsed / 1000000.0;
+            markStartup("scan");
+
+            // 文件夹已创建, 读取计时校准
+            loadTimingProfileAsync();
         }
+    });
+    connect(m_recordDirWatcher, &RecordDirWatcher::scanFailed, this, [=](const QString &errorMsg){
+        QMessageBox::critical(this, "错误", errorMsg);
+    });
+    m_recordDirWatcher->start(appDataDir.isEmpty() ? QDir::currentPath() : appDataDir);
+
+    // 状态接口, 供外部监控程序读取
+    m_metricsServer = new MetricsServer([=](MetricsSample *previous){ return metricsSnapshot(previous); }, this);
+    if (!m_metricsServer->start()) {
+        qWarning() << "状态接口启动失败:" << m_metricsServer->serverName();
     }
 
-    // 文件夹创建失败
-    if(!dir.exists("KeyMappingToolData")){
-        appDataDir = "";
+    // 录制时刷新录制状态
+    connect(&m_recorderStatsTimer, &QTimer::timeout, this, [=](){
+        ui->label_4->setText(m_recorderStats.snapshot(m_recorderStats.elapsed()).toStatusText());
+    });
+
+    markStartup("constructor");
+
+    // 窗口显示后再安装钩子和注册原始输入设备
+    QTimer::singleShot(0, this, &MainWindow::installInputHooks);
+}
+
+void MainWindow::wakeRecorder(){
+    if(m_recordWakeEvent && getIsRecording()){
+        SetEvent(m_recordWakeEvent);
     }
+}
 
-    // 扫描录制文件
-    scanRecordFiles();
+bool MainWindow::startEventBus(QString *errorMsg){
+    // 录制线程和原始输入回调都在 recordLogMutex 内发布, 保证同一时间只有一个写入方
+    return m_eventBus.start(errorMsg);
+}
+
+void MainWindow::installInputHooks(){
+    markStartup("shown");
 
     // 安装低级键盘钩子
     g_keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, GetModuleHandle(nullptr), 0);
@@ -81,6 +173,7 @@ MainWindow::MainWindow(QWidget *parent)
         QMessageBox::critical(this,"错误", "安装键盘钩子失败！");
         return;
     }
+    markStartup("keyboardHook");
 
     // 注册原始输入设备
     if (!registerRawInput()) {
@@ -88,11 +181,44 @@ MainWindow::MainWindow(QWidget *parent)
     } else {
         qDebug() << "注册原始输入设备成功!";
     }
+    markStartup("rawInput");
+}
+
+void MainWindow::loadTimingProfileAsync(){
+    QString filePath = appDataDir + TIMING_PROFILE_NAME;
+    QtConcurrent::run([=](){
+        // 没有校准文件时在后台测量一次, 之后可用 calibrate 命令重新测量
+        TimingProfile profile;
+        if(!loadTimingProfile(filePath, &profile)){
+            SendInputEmitter emitter;
+            profile = calibrateTiming(&emitter);
+
+            QString errorMsg;
+            if(!saveTimingProfile(filePath, profile, &errorMsg)){
+                qWarning() << errorMsg;
+            }
+        }
+        qDebug().noquote() << "计时校准:" << profile.toText();
+
+        QMetaObject::invokeMethod(this, [=]{
+            m_timingProfile = profile;
+            m_hasTimingProfile = true;
+            updateArmedJob();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::markStartup(const char *name){
+    qint64 elapsed = m_startupTimer.nsecsElapsed();
+    m_startupTimes[name] = elapsed / 1000000.0;
+    Tracer::instant(name, "startup_ns", elapsed);
+    qDebug() << "启动" << name << QString::number(elapsed / 1000000.0, 'f', 3) << "ms";
 }
 
 MainWindow::~MainWindow()
 {
     delete ui;
+    delete m_overlay;
 
     // 卸载钩子
     if (g_keyboardHook) {
@@ -103,8 +229,27 @@ MainWindow::~MainWindow()
     setIsRecording(false);
     setIsPlaying(false);
 
-    // 恢复所有按键
-    releaseAllKeys();
+    // 等待播放线程结束
+    m_quitPlayer = true;
+    SetEvent(m_playEvent);
+    m_playerThread->wait();
+    delete m_playerThread;
+    CloseHandle(m_playEvent);
+
+    // 唤醒空闲中的录制线程, 等待它结束后再关闭事件, 否则它可能等待已关闭的句柄
+    if (m_recordWakeEvent) {
+        SetEvent(m_recordWakeEvent);
+    }
+    m_recordFuture.waitForFinished();
+    if (m_recordWakeEvent) {
+        CloseHandle(m_recordWakeEvent);
+        m_recordWakeEvent = nullptr;
+    }
+
+    // 松开播放时按下的按键
+    m_emitter.releaseHeldKeys();
+
+    Tracer::flush();
 }
 
 // 键盘按键是否处于被按下的状态
@@ -140,28 +285,19 @@ void MainWindow::on_pushButton_clicked()
     startRecordOrStop();
 }
 
-void MainWindow::handleAndRecordKey(bool keyPressed, QString keyName, QSet<QString> *pressedKeySet, QString *recordStr, qint64 actionTime){
-    if(keyPressed){
-        // 按键按下
-        if(!pressedKeySet->contains(keyName)){
-            pressedKeySet->insert(keyName);
-
-            QMutexLocker locker(&recordStrMutex);
-            recordStr->append(QString::number(actionTime) + " " + keyName + ":press\n");
-
-            //qDebug() << keyName << ":press;";
-        }
-    }else{
-        // 按键松开
-        if(pressedKeySet->contains(keyName)){
-            pressedKeySet->remove(keyName);
+bool MainWindow::handleAndRecordKey(bool keyPressed, const KeyInfo &key, ActionType actionType, bool *isKeyDown, ActionLog *recordLog, qint64 actionTime){
+    // 状态没有变化
+    if(keyPressed == *isKeyDown){
+        return false;
+    }
+    *isKeyDown = keyPressed;
 
-            QMutexLocker locker(&recordStrMutex);
-            recordStr->append(QString::number(actionTime) + " " + keyName + ":release\n");
+    QMutexLocker locker(&recordLogMutex);
+    recordLog->append(ActionInfo{actionTime, key.code, 0, 0, !keyPressed, actionType});
+    m_recorderStats.setBufferBytes(recordLog->usedBytes(), recordLog->allocatedBytes());
 
-            //qDebug() << keyName << ":release;";
-        }
-    }
+    m_eventBus.publish(actionTime, BusEventType(actionType), key.code, !keyPressed);
+    return true;
 }
 
 bool MainWindow::getIsRecording(){
@@ -195,165 +331,81 @@ void MainWindow::on_pushButton_2_clicked()
     startPlayOrStop();
 }
 
-bool MainWindow::saveRecorrdToFile(QString fileName, QString data){
-    // 创建一个 QFile 对象，并打开文件进行写入
-    QFile file(appDataDir + fileName + ".record");
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);  // 创建一个文本流对象
-        out << data;             // 写入文本
-
-        // 关闭文件
-        file.close();
-
-        return true;
-    } else {
-        return false;
-    }
+bool MainWindow::saveRecorrdToFile(QString fileName){
+    // 按顺序遍历录制日志写入文件
+    QMutexLocker locker(&recordLogMutex);
+    return recordLog.save(appDataDir + fileName + RECORD_SUFFIX);
 }
 
-void MainWindow::simulateKeyPress(short scanCode, bool isKeyRelease){
-    // 模拟键盘操作
-    if(scanCode > 0){
-        INPUT input = {0};
+void MainWindow::scanRecordFiles(){
+    m_recordDirWatcher->rescan();
+}
 
-        short tmpDwFlags;
+void MainWindow::addRecordFiles(const QStringList &names){
+    // 第一次扫描, 一次添加所有文件
+    if(ui->comboBox->count() == 0){
+        ui->comboBox->addItems(names);
+        return;
+    }
 
-        // 设置为使用硬件扫描码, 并为某些功能按键添加扩展码
-        if(scanCode >= 0xC5 && scanCode <= 0xDF ){
-            tmpDwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_EXTENDEDKEY;
-        }else{
-            tmpDwFlags = KEYEVENTF_SCANCODE;
+    // 下拉框中的文件按文件名排序, 二分查找插入位置
+    for(const QString &name : names){
+        int low = 0, high = ui->comboBox->count();
+        while(low < high){
+            int mid = (low + high) / 2;
+            if(ui->comboBox->itemText(mid) < name){
+                low = mid + 1;
+            }else{
+                high = mid;
+            }
         }
-
-        // 模拟按下键
-        input.type = INPUT_KEYBOARD;
-        input.ki.dwFlags = tmpDwFlags;
-        // 设置扫描码
-        input.ki.wScan = scanCode;
-
-        // 模拟释放键
-        if(isKeyRelease){
-            input.ki.dwFlags = tmpDwFlags | KEYEVENTF_KEYUP;
+        if(low < ui->comboBox->count() && ui->comboBox->itemText(low) == name){
+            continue;
         }
-
-        SendInput(1, &input, sizeof(INPUT));
+        ui->comboBox->insertItem(low, name);
     }
 }
 
-// 模拟鼠标相对移动
-void MainWindow::simulateMouseRelativeMove(int dx, int dy){
-    // 构造鼠标事件
-    INPUT input = {0};
-    input.type = INPUT_MOUSE;
-
-    input.mi.dwFlags = MOUSEEVENTF_MOVE;  // 相对移动
-    input.mi.dx = dx;
-    input.mi.dy = dy;
-
-    // 发送鼠标事件
-    SendInput(1, &input, sizeof(INPUT));
-}
-
-// 模拟鼠标绝对移动
-void MainWindow::simulateMouseAbsolutelyMove(int x, int y){
-    // 构造鼠标事件
-    INPUT input = {0};
-    input.type = INPUT_MOUSE;
-
-    // 获取屏幕分辨率
-    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-
-    // 转换为绝对坐标（0-65535）
-    int absoluteX = (x * 65535) / (screenWidth - 1);
-    int absoluteY = (y * 65535) / (screenHeight - 1);
-
-    // 使用绝对移动
-    input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-    input.mi.dx = absoluteX;
-    input.mi.dy = absoluteY;
-
-    // 发送鼠标事件
-    SendInput(1, &input, sizeof(INPUT));
+void MainWindow::removeRecordFiles(const QStringList &names){
+    for(const QString &name : names){
+        int index = ui->comboBox->findText(name, Qt::MatchExactly | Qt::MatchCaseSensitive);
+        if(index >= 0){
+            ui->comboBox->removeItem(index);
+        }
+    }
 }
 
-void MainWindow::simulateMouseAction(QString btnName, bool isKeyRelease){
-    // 构造鼠标事件
-    INPUT input = {0};
-    input.type = INPUT_MOUSE;
-
-    // {"mouseLeft", 0x01},// 左键
-    // {"mouseRight", 0x02},// 右键
-    // {"mouseMiddle", 0x04},// 中键（滚轮按下）
-    // {"mouseSide1", 0x05}, // 侧键1（后退）
-    // {"mouseSide2", 0x06}, // 侧键2（前进）
+void MainWindow::updateTimeline(){
+    int request = ++m_timelineRequest;
 
-    // 鼠标左键点击
-    if(btnName == "mouseLeft"){
-        input.mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP;
-    }
-    // 鼠标右键点击
-    else if(btnName == "mouseRight"){
-        input.mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
-    }
-    // 鼠标中键
-    else if(btnName == "mouseMiddle"){
-        input.mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP;
-    }
-    // 鼠标侧键（前进/后退）
-    else if(btnName == "mouseSide1" || btnName == "mouseSide2") {
-        // 判断是按下还是释放
-        if (!isKeyRelease) {
-            input.mi.dwFlags = MOUSEEVENTF_XDOWN;  // 侧键按下
-
-            // 指定具体的侧键
-            if (btnName == "mouseSide2") {
-                input.mi.mouseData = XBUTTON2;  // 前进按钮 (0x0002)
-            } else if (btnName == "mouseSide1") {
-                input.mi.mouseData = XBUTTON1;  // 后退按钮 (0x0001)
-            }
-        } else {
-            input.mi.dwFlags = MOUSEEVENTF_XUP;  // 侧键释放
-
-            // 指定具体的侧键
-            if (btnName == "mouseSide2") {
-                input.mi.mouseData = XBUTTON2;
-            } else if (btnName == "mouseSide1") {
-                input.mi.mouseData = XBUTTON1;
-            }
-        }
-    }
-    else{
-        // 其它无效操作不模拟
+    QString selectedFile = ui->comboBox->currentText();
+    if(!selectedFile.endsWith(RECORD_SUFFIX)){
+        ui->timeline->setPyramid(nullptr);
         return;
     }
 
-
-    // 发送鼠标事件
-    SendInput(1, &input, sizeof(INPUT));
+    // 工作线程只用到文件路径, 不访问窗口, 生成完成后由窗口持有的 m_timelineBuild 通知
+    QString filePath = appDataDir + selectedFile;
+    m_timelineBuildRequest = request;
+    m_timelineBuild.setFuture(QtConcurrent::run([filePath](){
+        QSharedPointer<TimelinePyramid> pyramid;
+        RecordData data;
+        if(loadRecordFile(filePath, &data)){
+            pyramid.reset(new TimelinePyramid);
+            pyramid->build(data);
+        }
+        return pyramid;
+    }));
 }
 
-
-void MainWindow::scanRecordFiles(){
-    ui->comboBox->clear();
-
-    QDir directory(appDataDir);
-
-    // 设置过滤器，查找所有.record文件
-    QStringList filters;
-    filters << "*.record";
-
-    // 获取目录下所有符合过滤条件的文件
-    // QDir::Files 只列出文件，QDir::NoDotAndDotDot 不列出"."和".."
-    QFileInfoList fileList = directory.entryInfoList(filters, QDir::Files | QDir::NoDotAndDotDot);
-
-    // 遍历并处理找到的文件
-    foreach (const QFileInfo &fileInfo, fileList) {
-        ui->comboBox->addItem(fileInfo.fileName());
+void MainWindow::applyTimeline(){
+    // 生成期间又选择了其他录制, 丢弃旧的结果
+    if(m_timelineBuildRequest != m_timelineRequest || m_timelineBuild.isCanceled()){
+        return;
     }
+    ui->timeline->setPyramid(m_timelineBuild.result());
 }
 
-
 void MainWindow::on_pushButton_3_clicked()
 {
     std::string dirPath = QDir::toNativeSeparators(appDataDir).toStdString();
@@ -378,6 +430,8 @@ void MainWindow::startRecordOrStop(){
     if(getIsRecording()){
         setIsRecording(false);
 
+        m_recorderStatsTimer.stop();
+
         ui->label_2->setText("已结束录制");
         ui->label_2->setStyleSheet("QLabel{color:rgb(240, 106, 74);}");
         ui->pushButton->setText("开始录制(F7)");
@@ -402,66 +456,146 @@ void MainWindow::startRecordOrStop(){
 
         showFramelessTransparentMessageBox("正在录制");
 
-        QtConcurrent::run([=](){
+        // 采样间隔超过预算时, 期间按下又松开的按键会丢失
+        m_recorderStats.reset(m_recordInterval * 2 * 1000000);
+
+        // 定时刷新录制状态
+        ui->label_4->clear();
+        m_recorderStatsTimer.start(500);
+
+        m_recordFuture = QtConcurrent::run([=](){
+            Tracer::setThreadName("recorder");
 
             // 设置系统定时器精度为1ms
             timeBeginPeriod(1);
 
-            recordStrMutex.lock();
-            // 重置录制的信息
-            recordStr = "";
-            recordStrMutex.unlock();
+            recordLogMutex.lock();
+            // 重置录制的信息, 上一次录制的块归还到池中
+            recordLog.clear();
+            recordLogMutex.unlock();
 
-            // 当前按下的按键集合
-            QSet<QString> pressedKeySet;
+            // 当前按下的按键, 与按键表一一对应
+            bool mouseButtonDown[MOUSE_BUTTON_COUNT] = {};
+            bool keyDown[KEYBOARD_KEY_COUNT] = {};
 
             // 初始鼠标位置
             POINT cursorPosInitial;
             if (GetCursorPos(&cursorPosInitial)) {
-                recordStrMutex.lock();
+                recordLogMutex.lock();
 
                 // 记录初始的鼠标位置
-                recordStr.append(INITIAL_POS).append(":").append(QString::number(cursorPosInitial.x)).append(",").append(QString::number(cursorPosInitial.y)).append("\n");
+                recordLog.setInitialPos(cursorPosInitial.x, cursorPosInitial.y);
 
-                recordStrMutex.unlock();
+                recordLogMutex.unlock();
+            }else{
+                cursorPosInitial = POINT{0, 0};
             }
 
+            // 通知读取共享内存的程序开始了新的录制
+            recordLogMutex.lock();
+            m_eventBus.beginSession(cursorPosInitial.x, cursorPosInitial.y);
+            recordLogMutex.unlock();
+
             // 记录开始录制的时间
             //startRecordTimeMs = QDateTime::currentMSecsSinceEpoch();
 
-            // 开始计时
-            timer.start();
+            // 开始计时, 录制时长由统计对象的开始时间算出, 界面线程和原始输入读取时不共享计时器
+            m_recorderStats.start();
+
+            // 上次采样开始的时间
+            qint64 lastTickTime = -1;
+            // 上次按键变化的时间, 超过 RECORD_IDLE_AFTER_MS 没有变化时降低采样频率
+            qint64 lastActivityTime = 0;
+            // 上次采样后是空闲等待, 该次间隔不计入采样间隔统计
+            bool idleWait = false;
+            qint64 tickCount = 0;
+
+            // 录制线程的CPU时间从这里开始计算
+            qint64 cpuTimeStart = currentThreadCpuTime();
+
+            // 清除上一次录制结束后留下的唤醒
+            ResetEvent(m_recordWakeEvent);
 
             while(getIsRecording()){
                 //qint64 actionTime = QDateTime::currentMSecsSinceEpoch() - startRecordTimeMs;
-                // 计时器当前纳秒
-                qint64 actionTime = timer.nsecsElapsed();
+                // 录制开始后的纳秒
+                qint64 actionTime = m_recorderStats.elapsed();
+                qint64 traceTickStart = Tracer::isEnabled() ? Tracer::now() : 0;
 
                 // 获取鼠标按键状态
-                for (auto item = MOUSE_VK_MAP.begin(); item != MOUSE_VK_MAP.end(); ++item){
-                    bool keyPressed = isMouseButtonPressed(item.value());
-                    handleAndRecordKey(keyPressed, item.key(), &pressedKeySet, &recordStr, actionTime);
+                for (int i = 0; i < MOUSE_BUTTON_COUNT; i++){
+                    bool keyPressed = isMouseButtonPressed(MOUSE_BUTTONS[i].code);
+                    if(handleAndRecordKey(keyPressed, MOUSE_BUTTONS[i], ACTION_MOUSE_BUTTON, &mouseButtonDown[i], &recordLog, actionTime)){
+                        lastActivityTime = actionTime;
+                    }
                 }
 
                 // 获取键盘按键状态
-                for (auto item = VSC_MAP.begin(); item != VSC_MAP.end(); ++item){
-                    // 跳过热键
-                    if(item.key() == "F7" || item.key() == "F8"){
+                for (int i = 0; i < KEYBOARD_KEY_COUNT; i++){
+                    const KeyInfo &key = KEYBOARD_KEYS[i];
+                    // 跳过热键 F7, F8
+                    if(key.code == 0x41 || key.code == 0x42){
                         continue;
                     }
 
-                    bool keyPressed = isKeyPressed(item.value());
-                    handleAndRecordKey(keyPressed, item.key(), &pressedKeySet, &recordStr, actionTime);
+                    bool keyPressed = isKeyPressed(key.code);
+                    if(handleAndRecordKey(keyPressed, key, ACTION_KEYBOARD, &keyDown[i], &recordLog, actionTime)){
+                        lastActivityTime = actionTime;
+                    }
                 }
 
+                // 记录采样间隔和扫描按键的耗时, 空闲等待后的间隔单独统计
+                if(lastTickTime >= 0){
+                    if(idleWait){
+                        m_recorderStats.addIdleTick(actionTime - lastTickTime);
+                    }else{
+                        m_recorderStats.addTick(actionTime - lastTickTime, m_recorderStats.elapsed() - actionTime);
+                    }
+                }
+                lastTickTime = actionTime;
 
-                QThread::msleep(m_recordInterval);
+                if(traceTickStart){
+                    Tracer::complete("recordTick", traceTickStart, Tracer::now());
+                }
+
+                // 每64次采样更新一次CPU时间
+                if((++tickCount & 63) == 0){
+                    m_recorderStats.setCpuTime(currentThreadCpuTime() - cpuTimeStart);
+                }
+
+                // 一段时间没有按键变化, 降低采样频率, 直到键盘钩子或原始输入收到按键
+                // 鼠标移动由原始输入直接记录, 不需要采样
+                idleWait = m_adaptivePolling.load(std::memory_order_relaxed)
+                        && actionTime - lastActivityTime >= RECORD_IDLE_AFTER_MS * 1000000LL;
+                if(idleWait){
+                    if(WaitForSingleObject(m_recordWakeEvent, RECORD_IDLE_INTERVAL_MS) == WAIT_OBJECT_0){
+                        // 被按键唤醒, 恢复原来的采样频率
+                        lastActivityTime = m_recorderStats.elapsed();
+                    }
+                }else{
+                    QThread::msleep(m_recordInterval);
+                }
             }
 
+            m_recorderStats.setCpuTime(currentThreadCpuTime() - cpuTimeStart);
+
             // 恢复系统计时器精度
             timeEndPeriod(1);
 
+            // 启用跟踪时写入跟踪文件
+            Tracer::flush();
+
+            // 录制结束时的统计
+            qint64 recordElapsed = m_recorderStats.elapsed();
+
+            recordLogMutex.lock();
+            m_eventBus.endSession(recordElapsed);
+            recordLogMutex.unlock();
+
             QMetaObject::invokeMethod(mainWindow, [=]() {
+                // 显示整个录制过程的统计
+                ui->label_4->setText(m_recorderStats.snapshot(recordElapsed).toStatusText());
+
                 // 创建一个输入对话框
                 bool ok;
                 QString inputText = QInputDialog::getText(mainWindow, "保存录制", "请输入保存的名称:", QLineEdit::Normal, "", &ok);
@@ -472,7 +606,10 @@ void MainWindow::startRecordOrStop(){
                         inputText = "录制_" + QTime::currentTime().toString("yyyyMMdd_HHmmss");
                     }
 
-                    if(saveRecorrdToFile(inputText, recordStr)){
+                    if(saveRecorrdToFile(inputText)){
+                        // 录制的健康统计保存在录制文件旁边
+                        m_recorderStats.saveToFile(appDataDir + inputText + RECORDER_STATS_SUFFIX, recordElapsed);
+
                         QMessageBox::information(mainWindow, "提醒", "录制保存成功!");
                     }else{
                         QMessageBox::information(mainWindow, "错误", "录制保存失败, 创建文件时失败!");
@@ -487,7 +624,7 @@ void MainWindow::startRecordOrStop(){
 }
 
 
-void MainWindow::startPlayOrStop(){
+void MainWindow::startPlayOrStop(qint64 triggerTime){
 
     // 正在录制, 不能开始播放
     if(getIsRecording()){
@@ -498,8 +635,8 @@ void MainWindow::startPlayOrStop(){
     if(getIsPlaying()){
         setIsPlaying(false);
 
-        // 恢复所有按键
-        releaseAllKeys();
+        // 松开播放时按下的按键
+        m_emitter.releaseHeldKeys();
 
         ui->label_2->setText("已结束播放");
         ui->label_2->setStyleSheet("QLabel{color:rgb(240, 106, 74);}");
@@ -513,254 +650,454 @@ void MainWindow::startPlayOrStop(){
         ui->comboBox->setDisabled(false);
         ui->comboBox->setStyleSheet("QComboBox{background-color:rgba(251, 251, 251, 1); padding-left:12px;}");
 
+        // 显示按下热键到播放线程开始的耗时, 以及第一个操作的发送延迟
+        PlaybackStats::Snapshot playback = m_playbackStats.snapshot();
+        if(playback.triggerToWake() >= 0 && playback.firstLateness >= 0){
+            ui->label_4->setText(QString("开始播放: %1 ms, 第一个操作延迟: %2 ms")
+                                     .arg(playback.triggerToWake() / 1000000.0, 0, 'f', 3).arg(playback.firstLateness / 1000000.0, 0, 'f', 3));
+        }
+
         showFramelessTransparentMessageBox("已结束播放");
     }else{
+        // 上一次播放还在恢复设置
+        if(m_playerBusy.load(std::memory_order_acquire)){
+            return;
+        }
+
+        if(triggerTime == 0){
+            triggerTime = Tracer::now();
+        }
+
+        // 预先准备好时不再读取文件
+        if(triggerArmedPlayback(triggerTime)){
+            return;
+        }
+
         if(ui->comboBox->currentText().isEmpty()){
             QMessageBox::warning(this, "警告", "未选择录制文件, 无法播放!");
             return;
         }
 
-        setIsPlaying(true);
+        // 选择的是播放列表, 按列表顺序播放; 选择的是多轨文件, 同时播放所有轨道; 选择的是录制文件或宏程序, 一直循环播放
+        QString selectedFile = ui->comboBox->currentText();
+        PlaybackJob job = makePlaybackJob(selectedFile);
+        if(selectedFile.endsWith(PLAYLIST_SUFFIX)){
+            QString errorMsg;
+            if(!loadPlaylistFile(appDataDir + selectedFile, &job.entries, &errorMsg)){
+                QMessageBox::critical(this, "错误", errorMsg);
+                return;
+            }
+        }else if(selectedFile.endsWith(TRACKS_SUFFIX)){
+            QString errorMsg;
+            if(!loadTracksFile(appDataDir + selectedFile, &job.tracks, &errorMsg)){
+                QMessageBox::critical(this, "错误", errorMsg);
+                return;
+            }
+            // 状态接口按轨道序号显示当前录制
+            for(const TrackEntry &track : job.tracks){
+                job.entries.append(PlaylistEntry{track.recordName, track.loopCount, 0});
+            }
+        }else{
+            job.entries.append(PlaylistEntry{selectedFile, 0, LOOP_GAP_MS});
+        }
 
-        ui->label_2->setText("正在播放");
-        ui->label_2->setStyleSheet("QLabel{color:rgb(6, 200, 99);}");
-        ui->pushButton_2->setText("结束播放(F8)");
-        ui->pushButton_2->setStyleSheet("QPushButton{background-color:rgb(240, 106, 74);}");
+        beginPlayback(job, triggerTime);
+        showPlaying();
 
-        // 播放时, 不允许点击录制按钮
-        ui->pushButton->setDisabled(true);
-        ui->pushButton->setStyleSheet("QPushButton{background-color:rgb(220, 220, 220);}");
-        // 不允许选择录制文件
-        ui->comboBox->setDisabled(true);
-        ui->comboBox->setStyleSheet("QComboBox{background-color:rgb(220, 220, 220);  padding-left:12px;}");
+        // 准备的内容已过期, 重新准备下一次播放
+        if(m_armed && m_armed->selectedFile == selectedFile){
+            armPlayback();
+        }
+    }
+}
 
-        showFramelessTransparentMessageBox("正在播放");
+bool MainWindow::triggerArmedPlayback(qint64 triggerTime){
+    if(getIsRecording() || getIsPlaying() || m_playerBusy.load(std::memory_order_acquire)
+        || !m_armedReady.exchange(false, std::memory_order_acq_rel)){
+        return false;
+    }
 
-        // 播放
-        QtConcurrent::run([=](){
-            // 校准鼠标移动的缩放因子
-            //calibratePlayback();
+    // 播放内容已在 m_armedJob 中, 播放线程开始后通知主线程更新界面
+    m_triggerTime.store(triggerTime, std::memory_order_relaxed);
+    m_playGeneration.fetch_add(1, std::memory_order_relaxed);
+    m_armedTriggered.store(true, std::memory_order_release);
+    setIsPlaying(true);
+    m_playerBusy.store(true, std::memory_order_release);
+    SetEvent(m_playEvent);
+    return true;
+}
 
-            // 设置鼠标速度1:1
-            set1To1MouseMovement();
+void MainWindow::updateArmedJob(){
+    m_armedReady.store(false, std::memory_order_release);
 
-            // 设置系统定时器精度为1ms
-            timeBeginPeriod(1);
+    // 播放线程还没取走已触发的内容, 取走后会再通知主线程
+    if(m_armedTriggered.load(std::memory_order_acquire)){
+        return;
+    }
 
-            // 选择的录制文件
-            QString filePath = appDataDir + "/" + ui->comboBox->currentText();
-            // 打开选择的录制文件
-            QFile file(filePath);
-            // 尝试以只读和文本模式打开文件
-            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QMetaObject::invokeMethod(mainWindow, [=]{
-                    QMessageBox::critical(mainWindow, "错误", "无法打开文件:" + filePath);
-                    mainWindow->startPlayOrStop();
-                    mainWindow->scanRecordFiles();
-                });
-                return;
-            }
+    // 多轨文件和准备中的选择没有预先准备的内容
+    bool ready = m_armed && m_armed->selectedFile == ui->comboBox->currentText() && m_armed->calibrationFactor == m_calibrationFactor;
+    PlaybackJob job;
+    if(ready){
+        job = makePlaybackJob(m_armed->selectedFile);
+        job.entries = m_armed->entries;
+        job.armed = m_armed;
+    }
 
-            QTextStream in(&file);
-            QString line;
+    {
+        QMutexLocker locker(&m_playJobMutex);
+        m_armedJob = job;
+    }
+    m_armedReady.store(ready, std::memory_order_release);
+}
 
+void MainWindow::checkArmedSources(){
+    if(!m_armed){
+        return;
+    }
 
-            // 当前是否是第一行
-            bool isFirstLine = true;
+    // 准备后修改或删除过的文件重新准备
+    for(const QPair<QString, QDateTime> &source : m_armed->sources){
+        if(QFileInfo(source.first).lastModified() != source.second){
+            armPlayback();
+            return;
+        }
+    }
+}
 
-            // 鼠标初始位置
-            int firstX = 0, firstY = 0;
+PlaybackJob MainWindow::makePlaybackJob(const QString &selectedFile){
+    // 播放选项在主线程读取, 播放线程不再访问界面
+    PlaybackJob job;
+    job.selectedFile = selectedFile;
+    job.isMacro = selectedFile.endsWith(MACRO_SUFFIX);
+    job.moveToInitialPos = ui->checkBox->isChecked();
+    job.restoreView = ui->checkBox_2->isChecked();
+    job.hasTimingProfile = m_hasTimingProfile;
+    job.timingProfile = m_timingProfile;
+    job.transformRules = playbackTransformRules();
+    return job;
+}
 
-            // 操作列表
-            QList<ActionInfo> actionList;
+QList<TransformRule> MainWindow::playbackTransformRules() const{
+    // 鼠标移动量按校准因子缩放
+    QList<TransformRule> transformRules;
+    if(m_calibrationFactor != 1.0f){
+        TransformRule rule{TransformRule::MOUSE_SCALE};
+        rule.value = m_calibrationFactor;
+        transformRules.append(rule);
+    }
+    return transformRules;
+}
 
-            // 读取录制文件到内存
-            while(getIsPlaying() && !in.atEnd()){
-                // 读取一行
-                line = in.readLine();
+void MainWindow::beginPlayback(const PlaybackJob &job, qint64 triggerTime){
+    setIsPlaying(true);
 
-                // 读取第一行, 获取初始鼠标位置
-                if(isFirstLine){
-                    // 第一行信息错误
-                    if(!line.contains(INITIAL_POS) || line.split(":").size() != 2){
-                        QMetaObject::invokeMethod(mainWindow, [=]{
-                            QMessageBox::critical(mainWindow, "错误", "录制文件的首行信息格式错误!");
-                        });
-                        return;
-                    }else{
-                        auto itemSplit = line.split(":");
-                        QString key = itemSplit[0];
-                        QString pos = itemSplit[1];
+    // 状态接口通过播放列表项序号得到当前录制
+    m_playingEntries = job.entries;
+    m_playTimer.start();
 
-                        auto posList = pos.split(",");
-                        firstX = posList[0].toInt();
-                        firstY = posList[1].toInt();
-                    }
+    {
+        QMutexLocker locker(&m_playJobMutex);
+        m_playJob = job;
+    }
+    m_triggerTime.store(triggerTime, std::memory_order_relaxed);
+    m_playGeneration.fetch_add(1, std::memory_order_relaxed);
+    m_playerBusy.store(true, std::memory_order_release);
+    SetEvent(m_playEvent);
+}
 
-                    isFirstLine = false;
+void MainWindow::showPlaying(){
+    ui->label_2->setText("正在播放");
+    ui->label_2->setStyleSheet("QLabel{color:rgb(6, 200, 99);}");
+    ui->pushButton_2->setText("结束播放(F8)");
+    ui->pushButton_2->setStyleSheet("QPushButton{background-color:rgb(240, 106, 74);}");
 
-                    // 第一行读取完毕, 不进行后续操作
-                    continue;
-                }
+    // 播放时, 不允许点击录制按钮
+    ui->pushButton->setDisabled(true);
+    ui->pushButton->setStyleSheet("QPushButton{background-color:rgb(220, 220, 220);}");
+    // 不允许选择录制文件
+    ui->comboBox->setDisabled(true);
+    ui->comboBox->setStyleSheet("QComboBox{background-color:rgb(220, 220, 220);  padding-left:12px;}");
 
-                // 数据格式示例: "10 mouseMove:0,0"  示例2: "18 A:press"
-                // 取出开头的时间
-                auto lineSplit = line.split(" ");
-                qint64 actionTime = lineSplit[0].toLongLong();
+    showFramelessTransparentMessageBox("正在播放");
+}
 
-                // 按键操作的信息
-                auto item = lineSplit[1];
+void MainWindow::armPlayback(){
+    int request = ++m_armRequest;
+    m_armed.reset();
+    updateArmedJob();
 
-                if(item.isEmpty()){
-                    continue;
-                }
+    // 多轨文件各轨道同时加载, 不预先准备
+    QString selectedFile = ui->comboBox->currentText();
+    bool isMacro = selectedFile.endsWith(MACRO_SUFFIX);
+    bool isPlaylist = selectedFile.endsWith(PLAYLIST_SUFFIX);
+    if(!isMacro && !isPlaylist && !selectedFile.endsWith(RECORD_SUFFIX)){
+        return;
+    }
 
-                auto itemSplit = item.split(":");
-                if(itemSplit.size() < 2){
-                    continue;
-                }
+    // 提示框也在开始播放前创建好
+    prepareOverlay();
+
+    QString recordDir = appDataDir;
+    float calibrationFactor = m_calibrationFactor;
+    QList<TransformRule> transformRules = playbackTransformRules();
+    QtConcurrent::run([=](){
+        QSharedPointer<ArmedPlayback> armed(new ArmedPlayback);
+        armed->selectedFile = selectedFile;
+        armed->calibrationFactor = calibrationFactor;
+
+        // 先取修改时间再读取, 读取期间被修改时开始播放会重新加载
+        QString filePath = recordDir + selectedFile;
+        armed->sources.append(qMakePair(filePath, QFileInfo(filePath).lastModified()));
+
+        QString errorMsg;
+        bool ok;
+        if(isMacro){
+            QSharedPointer<MacroProgram> program(new MacroProgram);
+            ok = loadMacroFile(filePath, program.data(), &errorMsg);
+            armed->macro = program;
+        }else{
+            if(isPlaylist){
+                ok = loadPlaylistFile(filePath, &armed->entries, &errorMsg);
+            }else{
+                armed->entries.append(PlaylistEntry{selectedFile, 0, LOOP_GAP_MS});
+                ok = true;
+            }
 
-                // 操作的按键名称
-                QString key = itemSplit[0];
-                // 其它信息
-                // 如果key是键盘按键或鼠标按键, action则记录按键按下或者松开, 格式: 键盘按键 key:action 示例 "F:release", 鼠标按键 key:action 示例 "mouseLeft:press"
-                // 如果key是鼠标移动, action则记录移动的量, key:action 示例 "mouseMove:dx,dy"
-                QString action = itemSplit[1];
-
-                // 鼠标移动
-                if(key == "mouseMove"){
-                    auto moveDis = action.split(",");
-                    int dx = moveDis[0].toInt();
-                    int dy = moveDis[1].toInt();
-
-                    //mouseActionList.append(ActionInfo{actionTime, key, 0, dx, dy, false});
-                    actionList.append(ActionInfo{actionTime, key, 0, dx, dy, false});
-                }
-                // 鼠标按键
-                else if(key.contains("mouse")){
-                    //mouseActionList.append(ActionInfo{actionTime, key, 0, 0, 0, action == "release" ? true : false});
-                    actionList.append(ActionInfo{actionTime, key, 0, 0, 0, action == "release" ? true : false});
-                }else{
-                    if(!VSC_MAP.contains(key)){
-                        continue;
-                    }
+            if(ok && isPlaylist){
+                QString recordPath = recordDir + armed->entries[0].recordName;
+                armed->sources.append(qMakePair(recordPath, QFileInfo(recordPath).lastModified()));
+            }
+            ok = ok && prepareRecord(recordDir, armed->entries[0].recordName, transformRules, &armed->firstRecord, &errorMsg);
+        }
 
-                    // 键盘按键
-                    //keyboardActionList.append(ActionInfo{actionTime, key, VSC_MAP[key], 0, 0, action == "release" ? true : false});
-                    actionList.append(ActionInfo{actionTime, key, VSC_MAP[key], 0, 0, action == "release" ? true : false});
-                }
+        // 准备失败时不提示, 开始播放时按原来的方式加载并提示错误
+        if(!ok){
+            qDebug() << "预先准备播放失败:" << errorMsg;
+            return;
+        }
 
+        QMetaObject::invokeMethod(this, [=]{
+            if(request == m_armRequest){
+                m_armed = armed;
+                updateArmedJob();
             }
+        }, Qt::QueuedConnection);
+    });
+}
 
-            if(actionList.isEmpty()){
-                return;
-            }
+void MainWindow::playerLoop(){
+    Tracer::setThreadName("player");
 
-            // 记录播放过程中鼠标 x,y的移动量, 用于恢复游戏视角
-            int moveX = 0, moveY = 0;
+    while(true){
+        WaitForSingleObject(m_playEvent, INFINITE);
+        if(m_quitPlayer){
+            return;
+        }
 
-            // 循环播放
-            while(getIsPlaying()){
-                // 移动鼠标到初始位置(绝对坐标)
-                if(ui->checkBox->isChecked()){
-                    // 线性移动鼠标到指定坐标
-                    moveMouseToPos(firstX, firstY);
+        // 热键触发时使用预先生成的内容, 否则使用主线程刚交给的内容
+        bool armedTriggered = m_armedTriggered.load(std::memory_order_acquire);
+        PlaybackJob job;
+        {
+            QMutexLocker locker(&m_playJobMutex);
+            PlaybackJob &slot = armedTriggered ? m_armedJob : m_playJob;
+            job = slot;
+            slot = PlaybackJob();
+        }
+        if(armedTriggered){
+            m_armedTriggered.store(false, std::memory_order_release);
+        }
+        job.generation = m_playGeneration.load(std::memory_order_acquire);
+
+        // 重置播放统计, 记录按下热键到这里的耗时
+        m_playbackStats.reset();
+        m_playbackStats.setTriggerTime(m_triggerTime.load(std::memory_order_relaxed), Tracer::now());
+        Tracer::instant("playTrigger", "armed", armedTriggered ? 1 : 0);
+
+        if(armedTriggered){
+            // 热键只通知了播放线程, 界面在这里交给主线程更新, 并重新生成下一次的预先准备内容
+            QList<PlaylistEntry> entries = job.entries;
+            int generation = job.generation;
+            QMetaObject::invokeMethod(this, [=]{
+                if(getIsPlaying() && m_playGeneration.load(std::memory_order_relaxed) == generation){
+                    m_playingEntries = entries;
+                    m_playTimer.start();
+                    showPlaying();
                 }
+                updateArmedJob();
+            }, Qt::QueuedConnection);
+        }
 
-                // 恢复游戏视角为初始视角
-                if(ui->checkBox_2->isChecked()){
-                    // 线性移动鼠标, 相对移动
-                    moveMouseDxDy(-moveX, -moveY);
-                }
+        if(job.selectedFile.isEmpty()){
+            m_playerBusy.store(false, std::memory_order_release);
+            continue;
+        }
 
-                // 重置播放过程中鼠标 x,y的移动量
-                moveX = 0, moveY = 0;
+        runPlayback(job);
+    }
+}
 
-                // 高精度计时器开始计时
-                QElapsedTimer runTimer;
-                runTimer.start();
+void MainWindow::runPlayback(const PlaybackJob &job){
+    Tracer::instant("playWake");
 
-                for(auto actionInfo : actionList){
-                    if(!getIsPlaying()){
-                        break;
-                    }
+    // 校准鼠标移动的缩放因子
+    //calibratePlayback();
 
-                    // 还没到操作时间
-                    if(actionInfo.actionTime > runTimer.nsecsElapsed()){
-                        // 忙等待, 等待操作时间到
-                        while(true){
-                            if(actionInfo.actionTime <= runTimer.nsecsElapsed()){
-                                break;
-                            }
+    // 设置鼠标速度1:1
+    set1To1MouseMovement();
 
-                            QThread::msleep(1);
-                        }
-                    }
+    // 设置系统定时器精度为1ms
+    timeBeginPeriod(1);
 
-                    // 鼠标移动
-                    if(actionInfo.actionName == "mouseMove"){
-                        // 记录播放过程中鼠标 x,y的移动量, 用于恢复游戏视角
-                        moveX += actionInfo.dx;
-                        moveY += actionInfo.dy;
-
-                        // 模拟鼠标移动
-                        simulateMouseRelativeMove(actionInfo.dx, actionInfo.dy);
-                    }else if(actionInfo.actionName.contains("mouse")){
-                        // 模拟鼠标按键
-                        simulateMouseAction(actionInfo.actionName, actionInfo.isRelease);
-                    }else{
-                        // 模拟键盘按键
-                        simulateKeyPress(actionInfo.keyboardScanCode, actionInfo.isRelease);
-                    }
-                }
+    RecordPlayer player(&m_emitter, &isPlaying);
+    player.setMoveToInitialPos(job.moveToInitialPos);
+    player.setRestoreView(job.restoreView);
+    player.setStats(&m_playbackStats);
+    if(job.hasTimingProfile){
+        player.setTimingProfile(job.timingProfile);
+    }
 
-                //runTimer.
+    QString errorMsg;
+    bool ok;
+    if(!job.tracks.isEmpty()){
+        MultiTrackPlayer multiTrackPlayer(&player, &isPlaying);
+        ok = multiTrackPlayer.load(appDataDir, job.tracks, &errorMsg) || !getIsPlaying();
+        if(ok){
+            multiTrackPlayer.run();
+        }
 
-                // 等待一下再进入下一轮循环
-                QThread::msleep(500);
+        // 所有轨道都播放完, 结束播放
+        if(ok && getIsPlaying()){
+            int generation = job.generation;
+            QMetaObject::invokeMethod(mainWindow, [=]{
+                if(mainWindow->getIsPlaying() && mainWindow->m_playGeneration == generation){
+                    mainWindow->startPlayOrStop();
+                }
+            }, Qt::QueuedConnection);
+        }
+    }else if(job.isMacro){
+        // 宏程序中的重复按指令执行, 不展开
+        QSharedPointer<const MacroProgram> program = job.armed ? job.armed->macro : QSharedPointer<const MacroProgram>();
+        if(program){
+            ok = true;
+        }else{
+            QSharedPointer<MacroProgram> loaded(new MacroProgram);
+            ok = loadMacroFile(appDataDir + job.selectedFile, loaded.data(), &errorMsg, &isPlaying) || !getIsPlaying();
+            program = loaded;
+        }
+        std::unique_ptr<ActionTransform> transform = makeTransform(job.transformRules);
+        player.setTransform(transform.get());
+        m_playbackStats.setCurrentEntry(0);
+
+        PlaybackClock *clock = player.clock();
+        clock->start();
+        qint64 nextStart = 0;
+        while(ok && player.waitUntil(nextStart)){
+            player.prepareLoop(program->header);
+
+            // 复位动作可能超出预定时间, 从当前时间开始
+            qint64 startTime = qMax(nextStart, clock->nsecsElapsed());
+            qint64 endTime;
+            if(!player.playMacro(*program, startTime, &endTime)){
+                break;
             }
+            nextStart = endTime + LOOP_GAP_MS * 1000000LL;
+        }
+        player.setTransform(nullptr);
+    }else{
+        RecordSequencer sequencer(&player, &isPlaying);
+        sequencer.setTransformRules(job.transformRules);
+        // 大的录制不必等整个文件读完, 读取开头一段后就开始播放
+        sequencer.setPipelineLeadTime(PIPELINE_LEAD_MS * 1000000LL);
+        if(job.armed){
+            // 第一项已预先加载, 直接开始播放
+            sequencer.setPrepared(job.armed->firstRecord);
+        }
+        ok = sequencer.run(appDataDir, job.entries, &errorMsg);
+    }
 
-            // 恢复鼠标速度
-            restoreMouseSettings();
+    m_playbackStats.setCurrentEntry(-1);
 
-            // 在线程结束前恢复默认精度
-            timeEndPeriod(1);
+    // 松开停止时可能刚被按下的按键
+    m_emitter.releaseHeldKeys();
+
+    // 恢复鼠标速度
+    restoreMouseSettings();
+
+    // 在线程结束前恢复默认精度
+    timeEndPeriod(1);
+
+    PlaybackStats::Snapshot playback = m_playbackStats.snapshot();
+    if(playback.triggerToWake() >= 0 && playback.firstLateness >= 0){
+        Tracer::instant("triggerToWake", "ns", playback.triggerToWake());
+        Tracer::instant("firstEventLateness", "ns", playback.firstLateness);
+        qDebug() << "按下热键到开始播放" << QString::number(playback.triggerToWake() / 1000000.0, 'f', 3) << "ms"
+                 << "第一个操作延迟" << QString::number(playback.firstLateness / 1000000.0, 'f', 3) << "ms"
+                 << (job.armed ? "(已预先准备)" : "");
+    }
+
+    // 启用跟踪时写入跟踪文件
+    Tracer::flush();
+
+    m_playerBusy.store(false, std::memory_order_release);
+
+    if(!ok){
+        int generation = job.generation;
+        QMetaObject::invokeMethod(mainWindow, [=]{
+            QMessageBox::critical(mainWindow, "错误", errorMsg);
+            if(mainWindow->getIsPlaying() && mainWindow->m_playGeneration == generation){
+                mainWindow->startPlayOrStop();
+            }
+            mainWindow->scanRecordFiles();
         });
     }
 }
 
 
-void MainWindow::releaseAllKeys(){
-    // 还在按下的键盘按键
-    QSet<int> keyboardPressSet;
-    // 还在按下的鼠标按键
-    QSet<QString> mouseBtnPressSet;
+QJsonObject MainWindow::metricsSnapshot(MetricsSample *previous){
+    QJsonObject json;
 
-    // 获取鼠标按键状态
-    for (auto item = MOUSE_VK_MAP.begin(); item != MOUSE_VK_MAP.end(); ++item){
-        bool keyPressed = isMouseButtonPressed(item.value());
-        if(keyPressed){
-            mouseBtnPressSet.insert(item.key());
-        }
+    if(getIsRecording()){
+        json["state"] = "recording";
+    }else if(getIsPlaying()){
+        json["state"] = "playing";
+    }else{
+        json["state"] = "idle";
     }
 
-    // 获取键盘按键状态
-    for (auto item = VSC_MAP.begin(); item != VSC_MAP.end(); ++item){
-        bool keyPressed = isKeyPressed(item.value());
-        if(keyPressed){
-            keyboardPressSet.insert(item.value());
-        }
+    // 当前播放的录制, 没有播放时为选择的录制
+    PlaybackStats::Snapshot playback = m_playbackStats.snapshot();
+    if(playback.currentEntry >= 0 && playback.currentEntry < m_playingEntries.size()){
+        json["current_recording"] = m_playingEntries[playback.currentEntry].recordName;
+    }else{
+        json["current_recording"] = ui->comboBox->currentText();
     }
 
-    // 松开按键
-    for(auto it : keyboardPressSet){
-        simulateKeyPress(it, true);
+    // 发送速率: 从开始播放算起, 以及距离该连接上次读取
+    qint64 playElapsed = m_playTimer.isValid() ? m_playTimer.nsecsElapsed() : 0;
+    QJsonObject playbackJson = playback.toJson();
+    appendEventRates(&playbackJson, playElapsed, playback.eventsEmitted, previous);
+    json["playback"] = playbackJson;
+    // 选择的录制已预先准备好, 按下热键直接开始播放
+    json["playback_armed"] = m_armedReady.load(std::memory_order_acquire);
+
+    json["recorder"] = m_recorderStats.snapshot(m_recorderStats.elapsed()).toJson();
+
+    if(m_hasTimingProfile){
+        json["timing"] = m_timingProfile.toJson();
     }
-    for(auto it : mouseBtnPressSet){
-        simulateMouseAction(it, true);
+
+    if(m_eventBus.isStarted()){
+        json["event_bus"] = m_eventBus.key();
     }
+
+    // 启动各阶段距离创建窗口的时间 ms
+    json["startup"] = m_startupTimes;
+
+    return json;
 }
 
+
 bool MainWindow::registerRawInput()
 {
     // 配置原始输入设备：鼠标
@@ -803,6 +1140,8 @@ bool MainWindow::nativeEvent(const QByteArray &eventType, void *message, qintptr
 
 void MainWindow::processRawInput(HRAWINPUT rawInput)
 {
+    TraceScope scope("rawInput");
+
     UINT dwSize = 0;
 
     // 首先获取所需缓冲区大小
@@ -823,6 +1162,11 @@ void MainWindow::processRawInput(HRAWINPUT rawInput)
     if (raw->header.dwType == RIM_TYPEMOUSE) {
         const RAWMOUSE& mouse = raw->data.mouse;
 
+        // 鼠标按键按下或松开(包括滚轮), 唤醒空闲中的录制线程
+        if (mouse.usButtonFlags != 0) {
+            wakeRecorder();
+        }
+
         int deltaX = 0, deltaY = 0;
 
         // 处理相对移动
@@ -832,10 +1176,14 @@ void MainWindow::processRawInput(HRAWINPUT rawInput)
 
             //正在录制, 记录
             if(getIsRecording() && (deltaX != 0 || deltaY != 0)){
-                recordStrMutex.lock();
-                recordStr.append(QString::number(timer.nsecsElapsed())).append(" ").append("mouseMove:")
-                    .append(QString::number(deltaX)).append(",").append(QString::number(deltaY)).append("\n");
-                recordStrMutex.unlock();
+                m_recorderStats.addRawInputEvent();
+
+                recordLogMutex.lock();
+                qint64 actionTime = m_recorderStats.elapsed();
+                recordLog.append(ActionInfo{actionTime, 0, deltaX, deltaY, false, ACTION_MOUSE_MOVE});
+                m_recorderStats.setBufferBytes(recordLog.usedBytes(), recordLog.allocatedBytes());
+                m_eventBus.publish(actionTime, BUS_MOUSE_MOVE, 0, false, deltaX, deltaY);
+                recordLogMutex.unlock();
             }
 
             //qDebug() << "deltaX,deltaY : " << deltaX << "," << deltaY;
@@ -855,7 +1203,7 @@ void  MainWindow::calibratePlayback(){
     GetCursorPos(&startPos);
 
     // 使用当前因子模拟移动
-    simulateMouseRelativeMove(testDistance, 0);
+    m_emitter.simulateMouseRelativeMove(testDistance, 0);
     Sleep(100); // 等待移动完成
 
     // 测量实际移动距离
@@ -871,6 +1219,11 @@ void  MainWindow::calibratePlayback(){
 
     qDebug() << "校准结果: 理论" << testDistance << "实际" << actualMove
              << "新因子:" << m_calibrationFactor;
+
+    // 预先准备的录制按校准因子缩放, 在主线程重新准备
+    QMetaObject::invokeMethod(this, [=]{
+        armPlayback();
+    }, Qt::QueuedConnection);
 }
 
 
@@ -881,97 +1234,11 @@ void MainWindow::on_pushButton_4_clicked()
 }
 
 
-void MainWindow::moveMouseToPos(int targetX, int targetY){
-    // 将当前鼠标 线性移动到 targetX,targetY
-    while(getIsPlaying()){
-        int dx = 0, dy = 0;
-        // 获取鼠标的屏幕坐标（物理位置）
-        POINT cursorPos;
-        if (GetCursorPos(&cursorPos)) {
-            if(targetX > cursorPos.x){
-                dx = (cursorPos.x + 10) > targetX ? targetX : (cursorPos.x + 10);
-            }else{
-                dx = (cursorPos.x - 10) < targetX ? targetX : (cursorPos.x - 10);
-            }
-
-            if(targetY > cursorPos.y){
-                dy = (cursorPos.y + 10) > targetY ? targetY : (cursorPos.y + 10);
-            }else{
-                dy = (cursorPos.y - 10) < targetY ? targetY : (cursorPos.y - 10);
-            }
-
-            //qDebug() << "targetX,targetY: " << targetX << "," << targetY << "; dx,dy: " << dx << "," << dy;
-
-            // 模拟鼠标移动
-            simulateMouseAbsolutelyMove(dx, dy);
-
-            // 已到达目标位置
-            if(dx == targetX && dy == targetY){
-                break;
-            }
-        }
-
-        QThread::msleep(15);
-    }
-}
-
-
-void MainWindow::moveMouseDxDy(int dx, int dy){
-    // 每次移动的步长
-    int stepLen = 8;
-
-    // 将当前鼠标线性相对移动 dx, dy
-    while(getIsPlaying()){
-        if(dx == 0 && dy == 0){
-            break;
-        }
-
-        int mX = 0, mY = 0;
-
-        if(dx < 0){
-            if(dx + stepLen < 0){
-                mX = -stepLen;
-                dx += stepLen;
-            }else{
-                mX = dx;
-                dx = 0;
-            }
-        }else{
-            if(dx - stepLen > 0){
-                mX = stepLen;
-                dx -= stepLen;
-            }else{
-                mX = dx;
-                dx = 0;
-            }
-        }
-
-        if(dy < 0){
-            if(dy + stepLen < 0){
-                mY = -stepLen;
-                dy += stepLen;
-            }else{
-                mY = dy;
-                dy = 0;
-            }
-        }else{
-            if(dy - stepLen > 0){
-                mY = stepLen;
-                dy -= stepLen;
-            }else{
-                mY = dy;
-                dy = 0;
-            }
-        }
-
-        simulateMouseRelativeMove(mX, mY);
-
-        QThread::msleep(5);
+void MainWindow::prepareOverlay(){
+    if(m_overlay){
+        return;
     }
-}
 
-
-void MainWindow::showFramelessTransparentMessageBox(QString text){
     // 创建一个QMessageBox
     QMessageBox *msgBox = new QMessageBox();
 
@@ -981,9 +1248,6 @@ void MainWindow::showFramelessTransparentMessageBox(QString text){
     // 设置背景透明 [citation:6][citation:7]
     msgBox->setAttribute(Qt::WA_TranslucentBackground);
 
-    // 设置提示文本
-    msgBox->setText(text);
-
     // 可选：移除标准按钮，仅显示文本
     msgBox->setStandardButtons(QMessageBox::NoButton);
 
@@ -1001,6 +1265,18 @@ void MainWindow::showFramelessTransparentMessageBox(QString text){
         "}"
         );
 
+    // 1秒后自动隐藏, 下一次直接显示
+    connect(&m_overlayTimer, &QTimer::timeout, msgBox, &QMessageBox::hide);
+    m_overlay = msgBox;
+}
+
+void MainWindow::showFramelessTransparentMessageBox(QString text){
+    prepareOverlay();
+    QMessageBox *msgBox = m_overlay;
+
+    // 设置提示文本
+    msgBox->setText(text);
+
     // 调整消息框大小
     msgBox->adjustSize();
 
@@ -1019,8 +1295,8 @@ void MainWindow::showFramelessTransparentMessageBox(QString text){
     // 显示消息框
     msgBox->show();
 
-    // 设置1秒后自动关闭 [该功能点未在搜索结果中直接提及，但根据用户需求添加]
-    QTimer::singleShot(1000, msgBox, &QMessageBox::deleteLater);
+    // 设置1秒后自动关闭, 连续显示时重新计时
+    m_overlayTimer.start(1000);
 }
 
 
@@ -1029,6 +1305,8 @@ void MainWindow::on_checkBox_clicked()
     if(ui->checkBox->isChecked()){
         ui->checkBox_2->setChecked(false);
     }
+    // 播放选项变化, 重新生成预先准备的内容
+    updateArmedJob();
 }
 
 
@@ -1037,5 +1315,6 @@ void MainWindow::on_checkBox_2_clicked()
     if(ui->checkBox_2->isChecked()){
         ui->checkBox->setChecked(false);
     }
+    updateArmedJob();
 }
 
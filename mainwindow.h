@@ -4,19 +4,70 @@
 #include <windows.h>
 #include <hidusage.h>
 
+#include "eventbus.h"
+#include "multitrackplayer.h"
+#include "sendinputemitter.h"
+#include "playbackstats.h"
+#include "recorderstats.h"
+#include "recordsequencer.h"
+#include "timingprofile.h"
+
+#include <QDateTime>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QJsonObject>
 #include <QMainWindow>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QThread>
+#include <QTimer>
+
+// 录制时没有按键变化超过 RECORD_IDLE_AFTER_MS 后降低采样频率, 每 RECORD_IDLE_INTERVAL_MS 采样一次
+// 键盘钩子和原始输入收到按键时立即恢复
+#define RECORD_IDLE_AFTER_MS 500
+#define RECORD_IDLE_INTERVAL_MS 50
+
+class ActionLog;
+class MetricsServer;
+struct MetricsSample;
+class QMessageBox;
+class RecordDirWatcher;
+struct KeyInfo;
+struct MacroProgram;
+class TimelinePyramid;
+
+// 选择录制后在后台预先准备好的播放内容, 按下热键时不再读取文件
+struct ArmedPlayback
+{
+    QString selectedFile;
+    // 准备时用到的文件及其修改时间, 开始播放时文件已修改则不使用
+    QList<QPair<QString, QDateTime>> sources;
+    // 准备时的鼠标缩放校准因子
+    float calibrationFactor = 1.0f;
+    // 录制文件为一直循环的一项, 播放列表为其全部项
+    QList<PlaylistEntry> entries;
+    // 第一项已加载的录制, 宏程序时为空
+    PreparedRecord firstRecord;
+    // 已加载的宏程序
+    QSharedPointer<const MacroProgram> macro;
+};
 
-#define INITIAL_POS "initialPos"
-
-struct ActionInfo
+// 一次播放需要的全部内容, 在主线程准备好后交给播放线程
+struct PlaybackJob
 {
-    qint64 actionTime; // 操作时间
-    QString actionName;// 操作的按键名称
-    int keyboardScanCode;// 键盘按键的扫描码
-    int dx;// 鼠标移动的x轴量
-    int dy;// y轴量
-    bool isRelease;// 是否为松开按键
+    QString selectedFile;
+    QList<PlaylistEntry> entries;
+    QList<TrackEntry> tracks;
+    bool isMacro = false;
+    bool moveToInitialPos = false;
+    bool restoreView = false;
+    bool hasTimingProfile = false;
+    TimingProfile timingProfile;
+    QList<TransformRule> transformRules;
+    // 预先准备好的内容, 为空时播放线程自己加载
+    QSharedPointer<const ArmedPlayback> armed;
+    // 第几次播放, 播放线程结束后通知主线程时用于判断是否仍是这一次播放
+    int generation = 0;
 };
 
 QT_BEGIN_NAMESPACE
@@ -34,7 +85,19 @@ public:
     ~MainWindow();
 
     void startRecordOrStop();
-    void startPlayOrStop();
+    // triggerTime 为按下热键的时间, Tracer::now() 的时钟, 为0时取当前时间
+    void startPlayOrStop(qint64 triggerTime = 0);
+    // 已预先准备好选择的录制时, 直接通知播放线程开始, 界面由播放线程通知主线程更新; 否则返回false
+    // 在键盘钩子中调用, 只读写原子变量, 不读取文件、不访问界面、不复制播放内容
+    bool triggerArmedPlayback(qint64 triggerTime);
+
+    // 录制时把采集到的操作发布到共享内存, 供其它进程读取
+    bool startEventBus(QString *errorMsg = nullptr);
+
+    // 录制时空闲降低采样频率, 关闭时一直按 m_recordInterval 采样
+    void setAdaptivePolling(bool enabled) { m_adaptivePolling = enabled; }
+    // 有按键输入, 唤醒空闲中的录制线程, 在键盘钩子和原始输入中调用
+    void wakeRecorder();
 
 protected:
     // 重写nativeEvent以处理Windows原生消息
@@ -57,18 +120,90 @@ private slots:
 private:
     Ui::MainWindow *ui;
 
-    // 纳秒级高精度计时器
-    QElapsedTimer timer;
-
     std::atomic<bool> isRecording{false}; // 是否正在录制
     std::atomic<bool> isPlaying{false};// 是否正在播放
 
     // 记录的时间间隔 ms
     const qint64 m_recordInterval = 1;
+    // 空闲时降低采样频率
+    std::atomic<bool> m_adaptivePolling{true};
+    // 唤醒空闲中的录制线程, 自动复位
+    HANDLE m_recordWakeEvent = nullptr;
+    // 录制线程, 退出时等待它结束后再关闭唤醒事件
+    QFuture<void> m_recordFuture;
+
+    // 录制的健康统计
+    RecorderStats m_recorderStats;
+    // 录制时定时刷新统计到界面
+    QTimer m_recorderStatsTimer;
+
+    // 播放统计
+    PlaybackStats m_playbackStats;
+    // 正在播放的播放列表, 只在主线程访问
+    QList<PlaylistEntry> m_playingEntries;
+    // 开始播放后的计时
+    QElapsedTimer m_playTimer;
+
+    // 播放线程: 启动时创建, 没有播放时等待开始信号, 开始播放时不再创建线程
+    QThread *m_playerThread = nullptr;
+    // 开始播放或退出时通知播放线程, 自动复位
+    HANDLE m_playEvent = nullptr;
+    // 交给播放线程的播放内容
+    QMutex m_playJobMutex;
+    PlaybackJob m_playJob;
+    // 预先生成的播放内容, 按下热键时播放线程直接取用, 选择、文件或播放选项变化时在主线程重新生成
+    PlaybackJob m_armedJob;
+    // m_armedJob 与当前的选择和选项一致, 可以直接开始播放
+    std::atomic<bool> m_armedReady{false};
+    // 热键已触发 m_armedJob, 播放线程取走后清除, 在此之前主线程不修改 m_armedJob
+    std::atomic<bool> m_armedTriggered{false};
+    // 请求开始播放的时间, 播放线程开始时写入统计
+    std::atomic<qint64> m_triggerTime{0};
+    // 播放线程正在播放, 包括停止后恢复设置的时间
+    std::atomic<bool> m_playerBusy{false};
+    std::atomic<bool> m_quitPlayer{false};
+    // 每次开始播放加1, 在主线程(包括键盘钩子)中修改
+    // 播放线程发出的结束通知在主线程执行前, 可能已停止并开始了新的播放, 序号不同时不结束新的播放
+    std::atomic<int> m_playGeneration{0};
+    void playerLoop();
+    void runPlayback(const PlaybackJob &job);
+
+    // 读取界面上的播放选项
+    PlaybackJob makePlaybackJob(const QString &selectedFile);
+    // 鼠标移动量按校准因子缩放
+    QList<TransformRule> playbackTransformRules() const;
+    // 把播放内容交给播放线程并开始播放
+    void beginPlayback(const PlaybackJob &job, qint64 triggerTime);
+    // 开始播放后更新界面
+    void showPlaying();
+
+    // 选择录制后在后台准备播放, 只保留最后一次选择的结果, 只在主线程访问
+    void armPlayback();
+    QSharedPointer<const ArmedPlayback> m_armed;
+    int m_armRequest = 0;
+    // 按准备好的内容和当前的播放选项重新生成 m_armedJob, 选项变化时调用
+    void updateArmedJob();
+    // 录制文件夹变化后检查准备时用到的文件, 被修改或删除时重新准备
+    void checkArmedSources();
+
+    // 共享内存中的实时操作, 未启用时发布不做任何事
+    EventBusPublisher m_eventBus;
+
+    // 状态接口
+    MetricsServer *m_metricsServer = nullptr;
+
+    // 当前状态和统计, 供状态接口读取, previous 为该连接上一次读取的计数
+    QJsonObject metricsSnapshot(MetricsSample *previous);
 
     // 保存的录制文件所在文件夹
     QString appDataDir;
 
+    // 本机的计时校准, 播放时决定自旋余量和提前发送的时间
+    TimingProfile m_timingProfile;
+    bool m_hasTimingProfile = false;
+    // 后台读取计时校准, 没有时测量并保存
+    void loadTimingProfileAsync();
+
     // 鼠标缩放校准因子
     float m_calibrationFactor = 1.0f;
 
@@ -85,21 +220,35 @@ private:
 
     bool isKeyPressed(int keyScanCode);
     bool isMouseButtonPressed(int mouseButton);
-    void handleAndRecordKey(bool keyPressed, QString keyName, QSet<QString> *pressedKeySet, QString *recordStr, qint64 actionTime);
-    bool saveRecorrdToFile(QString fileName, QString data);
+    // 按键状态变化时记录, isKeyDown 为该按键上次的状态, 返回是否有变化
+    bool handleAndRecordKey(bool keyPressed, const KeyInfo &key, ActionType actionType, bool *isKeyDown, ActionLog *recordLog, qint64 actionTime);
+    bool saveRecorrdToFile(QString fileName);
 
-    void simulateKeyPress(short scanCode, bool isKeyRelease);
-    void simulateMouseAction(QString btnName, bool isKeyRelease);
-    // 模拟鼠标相对移动
-    void simulateMouseRelativeMove(int dx, int dy);
-    // 模拟鼠标绝对移动
-    void simulateMouseAbsolutelyMove(int x, int y);
+    // 模拟键盘鼠标输入, 记录播放时按下的按键
+    SendInputEmitter m_emitter;
 
 
+    // 监视录制文件夹, 只把变化的文件更新到下拉框
+    RecordDirWatcher *m_recordDirWatcher = nullptr;
+    // 立即在后台重新扫描一次, 不等待文件夹变化通知
     void scanRecordFiles();
-
-    // 释放所有按键
-    void releaseAllKeys();
+    void addRecordFiles(const QStringList &names);
+    void removeRecordFiles(const QStringList &names);
+
+    // 启动计时, 各阶段的时间通过状态接口和跟踪文件查看
+    QElapsedTimer m_startupTimer;
+    QJsonObject m_startupTimes;
+    void markStartup(const char *name);
+    // 窗口显示后安装键盘钩子和注册原始输入设备
+    void installInputHooks();
+
+    // 在时间线中显示选择的录制, 后台加载, 只显示最后一次选择的结果
+    void updateTimeline();
+    void applyTimeline();
+    int m_timelineRequest = 0;
+    // 后台生成时间线, 由窗口持有, 窗口销毁后不再回调; m_timelineBuildRequest 为正在生成的选择序号
+    QFutureWatcher<QSharedPointer<TimelinePyramid>> m_timelineBuild;
+    int m_timelineBuildRequest = 0;
 
     // 注册原始输入设备
     bool registerRawInput();
@@ -108,29 +257,28 @@ private:
     void processRawInput(HRAWINPUT rawInput);
 
     // 鼠标设置
+    // 只修改当前会话的设置, 不写入用户配置, 开始播放时不需要等待写注册表
     void set1To1MouseMovement() {
         // 保存原始设置
         SystemParametersInfo(SPI_GETMOUSESPEED, 0, &m_originalSpeed, 0);
 
         // 设置鼠标速度为1:1（值为10，范围1-20）
-        SystemParametersInfo(SPI_SETMOUSESPEED, 0, (void*)10, SPIF_UPDATEINIFILE);
+        SystemParametersInfo(SPI_SETMOUSESPEED, 0, (void*)10, 0);
 
         // 禁用鼠标加速度
         int mouseParams[3] = {0, 0, 0}; // 禁用加速度
-        SystemParametersInfo(SPI_SETMOUSE, 0, mouseParams, SPIF_UPDATEINIFILE);
+        SystemParametersInfo(SPI_SETMOUSE, 0, mouseParams, 0);
     }
 
     // 恢复鼠标设置
     void restoreMouseSettings() {
-        SystemParametersInfo(SPI_SETMOUSESPEED, 0, (void*)m_originalSpeed, SPIF_UPDATEINIFILE);
+        SystemParametersInfo(SPI_SETMOUSESPEED, 0, (void*)m_originalSpeed, 0);
     }
 
-    // 线性移动鼠标到指定位置(绝对移动)
-    void moveMouseToPos(int targetX, int targetY);
-
-    // 线性移动鼠标(相对移动)
-    void moveMouseDxDy(int dx, int dy);
-
+    // 提示框只创建一次, 之后每次只更新文字
+    QMessageBox *m_overlay = nullptr;
+    QTimer m_overlayTimer;
+    void prepareOverlay();
     void showFramelessTransparentMessageBox(QString text);
 
 };
@@ -0,0 +1,91 @@
+#include "metricsserver.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+void appendEventRates(QJsonObject *json, qint64 elapsed, qint64 events, MetricsSample *previous){
+    (*json)["elapsed_ms"] = elapsed / 1000000.0;
+    (*json)["events_per_sec"] = elapsed > 0 ? events * 1e9 / elapsed : 0.0;
+
+    // 重新开始播放后计数变小, 此时只算本次播放
+    qint64 sinceLast = elapsed - previous->elapsed;
+    qint64 eventsSinceLast = events - previous->events;
+    if(sinceLast < 0 || eventsSinceLast < 0){
+        sinceLast = elapsed;
+        eventsSinceLast = events;
+    }
+    (*json)["events_per_sec_recent"] = sinceLast > 0 ? eventsSinceLast * 1e9 / sinceLast : 0.0;
+
+    previous->elapsed = elapsed;
+    previous->events = events;
+}
+
+MetricsServer::MetricsServer(std::function<QJsonObject(MetricsSample *previous)> provider, QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_provider(provider)
+{
+    connect(m_server, &QLocalServer::newConnection, this, [=](){
+        while(QLocalSocket *socket = m_server->nextPendingConnection()){
+            connect(socket, &QLocalSocket::readyRead, this, [=](){
+                handleRequest(socket);
+            });
+            connect(socket, &QLocalSocket::disconnected, this, [=](){
+                m_samples.remove(socket);
+                socket->deleteLater();
+            });
+        }
+    });
+}
+
+QString MetricsServer::serverName() const{
+    return QString("KeyRecorder-metrics-%1").arg(QCoreApplication::applicationPid());
+}
+
+bool MetricsServer::start(){
+    // 清理异常退出时遗留的同名套接字
+    QLocalServer::removeServer(serverName());
+    return m_server->listen(serverName());
+}
+
+// 将json展开为 "名称 值" 的文本行, 嵌套的名称用 "_" 连接
+static void appendText(QByteArray *text, const QString &prefix, const QJsonValue &value){
+    if(value.isObject()){
+        QJsonObject object = value.toObject();
+        for(auto it = object.begin(); it != object.end(); ++it){
+            appendText(text, prefix.isEmpty() ? it.key() : prefix + "_" + it.key(), it.value());
+        }
+    }else if(value.isArray()){
+        QJsonArray array = value.toArray();
+        for(int i = 0; i < array.size(); i++){
+            appendText(text, prefix + "_" + QString::number(i), array[i]);
+        }
+    }else if(value.isString()){
+        text->append(prefix.toUtf8()).append(" \"").append(value.toString().toUtf8()).append("\"\n");
+    }else if(value.isBool()){
+        text->append(prefix.toUtf8()).append(value.toBool() ? " 1\n" : " 0\n");
+    }else{
+        text->append(prefix.toUtf8()).append(" ").append(QByteArray::number(value.toDouble(), 'g', 15)).append("\n");
+    }
+}
+
+void MetricsServer::handleRequest(QLocalSocket *socket){
+    while(socket->canReadLine()){
+        QByteArray request = socket->readLine().trimmed();
+
+        QJsonObject metrics = m_provider(&m_samples[socket]);
+
+        QByteArray response;
+        if(request == "text"){
+            appendText(&response, QString(), metrics);
+        }else{
+            response = QJsonDocument(metrics).toJson(QJsonDocument::Compact);
+            response.append("\n");
+        }
+
+        socket->write(response);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+
+#include <functional>
+
+class QLocalServer;
+class QLocalSocket;
+
+// 一个连接上一次读取时的播放计时和发送数
+// 每个连接分别保存, 多个监控程序同时读取时, 各自的最近发送速率互不影响
+struct MetricsSample
+{
+    qint64 elapsed = 0;// 开始播放后的时间 ns
+    qint64 events = 0;// 发送的操作数
+};
+
+// 在 json 中写入发送速率: 从开始播放算起(events_per_sec), 以及距离该连接上次读取(events_per_sec_recent)
+void appendEventRates(QJsonObject *json, qint64 elapsed, qint64 events, MetricsSample *previous);
+
+// 本地套接字上的状态接口, 供外部监控程序读取当前状态和统计
+// 名称为 KeyRecorder-metrics-<进程id>, Linux 上是 /tmp 下的 Unix 套接字, Windows 上是命名管道
+// 客户端每发送一行请求返回一次结果: "text" 返回每行 "名称 值" 的文本, 其它返回一行 json
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // provider 在主线程中调用, 返回当前的状态和统计, previous 为发出请求的连接上一次读取的计数
+    MetricsServer(std::function<QJsonObject(MetricsSample *previous)> provider, QObject *parent = nullptr);
+
+    bool start();
+    QString serverName() const;
+
+private:
+    QLocalServer *m_server;
+    std::function<QJsonObject(MetricsSample *previous)> m_provider;
+    // 每个连接上一次读取的计数, 连接断开时删除
+    QHash<QLocalSocket *, MetricsSample> m_samples;
+
+    void handleRequest(QLocalSocket *socket);
+};
+
+#endif // METRICSSERVER_H
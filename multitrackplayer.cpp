@@ -0,0 +1,223 @@
+#include "multitrackplayer.h"
+#include "recordsequencer.h"
+#include "tracer.h"
+
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+bool loadTracksFile(const QString &filePath, QList<TrackEntry> *tracks, QString *errorMsg){
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法打开文件:" + filePath;
+        }
+        return false;
+    }
+
+    tracks->clear();
+
+    QTextStream in(&file);
+    while(!in.atEnd()){
+        QString line = in.readLine().trimmed();
+
+        // 空行和注释
+        if(line.isEmpty() || line.startsWith('#')){
+            continue;
+        }
+
+        // 录制文件名可能包含空格, 从行尾取出偏移、周期和循环次数
+        TrackEntry track{line, 0, 0, 0};
+        QList<qint64> numbers;
+        while(numbers.size() < 3){
+            int spaceIndex = track.recordName.lastIndexOf(' ');
+            if(spaceIndex <= 0){
+                break;
+            }
+
+            bool ok;
+            qint64 val = track.recordName.mid(spaceIndex + 1).toLongLong(&ok);
+            if(!ok){
+                break;
+            }
+
+            numbers.prepend(val);
+            track.recordName = track.recordName.left(spaceIndex).trimmed();
+        }
+
+        if(numbers.size() > 0){
+            track.offsetMs = qMax<qint64>(0, numbers[0]);
+        }
+        if(numbers.size() > 1){
+            track.periodMs = numbers[1];
+        }
+        if(numbers.size() > 2){
+            track.loopCount = numbers[2];
+        }
+
+        if(!track.recordName.endsWith(RECORD_SUFFIX)){
+            track.recordName.append(RECORD_SUFFIX);
+        }
+
+        tracks->append(track);
+    }
+
+    if(tracks->isEmpty()){
+        if(errorMsg){
+            *errorMsg = "多轨文件为空:" + filePath;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+MultiTrackPlayer::MultiTrackPlayer(RecordPlayer *player, const std::atomic<bool> *running)
+    : m_player(player)
+    , m_running(running)
+{
+}
+
+bool MultiTrackPlayer::load(const QString &recordDir, const QList<TrackEntry> &tracks, QString *errorMsg){
+    m_tracks.clear();
+
+    QHash<QString, QSharedPointer<const RecordData>> loaded;
+    for(const TrackEntry &entry : tracks){
+        QSharedPointer<const RecordData> data = loaded.value(entry.recordName);
+        if(!data){
+            QSharedPointer<RecordData> record(new RecordData);
+            if(!loadRecordFile(recordDir + entry.recordName, record.data(), errorMsg, m_running)){
+                return false;
+            }
+            data = record;
+            loaded.insert(entry.recordName, data);
+        }
+
+        Track track;
+        track.data = data;
+        track.loopCount = entry.loopCount;
+        track.period = entry.periodMs > 0 ? entry.periodMs * 1000000 : data->duration() + LOOP_GAP_MS * 1000000;
+        track.loopStart = entry.offsetMs * 1000000;
+        m_tracks.append(track);
+    }
+
+    return true;
+}
+
+void MultiTrackPlayer::run(){
+    m_player->clock()->start();
+
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> queue;
+    for(int i = 0; i < m_tracks.size(); i++){
+        const Track &track = m_tracks[i];
+        if(!track.data->actionList.isEmpty()){
+            queue.push(Pending{track.loopStart + track.data->actionList[0].actionTime, i});
+        }
+    }
+
+    PlaybackStats *stats = m_player->stats();
+
+    while(!queue.empty()){
+        Pending pending = queue.top();
+        queue.pop();
+
+        if(!m_player->waitToEmit(pending.deadline)){
+            return;
+        }
+
+        qint64 lateness = m_player->lateness(pending.deadline);
+        if(stats){
+            stats->addEmit(lateness);
+            stats->setCurrentEntry(pending.track);
+        }
+
+        Track &track = m_tracks[pending.track];
+        const QList<ActionInfo> &actionList = track.data->actionList;
+        const ActionInfo &actionInfo = actionList[track.next++];
+
+        qint64 emitStart = Tracer::isEnabled() ? Tracer::now() : 0;
+        emitAction(track, actionInfo);
+        if(emitStart){
+            Tracer::complete("late", emitStart - qMax<qint64>(0, lateness), emitStart, "deadline_ns", pending.deadline);
+            Tracer::complete("emit", emitStart, Tracer::now(), "type", actionInfo.actionType, "track", pending.track);
+        }
+
+        // 本轮结束, 松开本轨道未松开的按键
+        if(track.next == actionList.size()){
+            releaseTrack(track);
+            if(stats){
+                stats->addLoop();
+            }
+
+            track.loopsDone++;
+            if(track.loopCount > 0 && track.loopsDone >= track.loopCount){
+                continue;
+            }
+
+            // 周期短于录制时长时, 等本轮播放完再开始下一轮
+            track.loopStart += qMax(track.period, track.data->duration());
+            track.next = 0;
+            Tracer::instant("loopStart", "track", pending.track);
+        }
+
+        queue.push(Pending{track.loopStart + actionList[track.next].actionTime, pending.track});
+    }
+}
+
+void MultiTrackPlayer::emitAction(Track &track, const ActionInfo &actionInfo){
+    if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+        // 各轨道的相对移动直接叠加
+        m_player->emitter()->simulateMouseRelativeMove(actionInfo.dx, actionInfo.dy);
+        return;
+    }
+
+    int bit = actionInfo.actionType == ACTION_KEYBOARD
+                  ? (actionInfo.keyCode & 0xFF)
+                  : HELD_MOUSE_BASE + (actionInfo.keyCode & 0x07);
+
+    if(!actionInfo.isRelease){
+        // 本轨道已按住, 或其他轨道已按住
+        if(track.held.test(bit)){
+            return;
+        }
+        track.held.set(bit);
+        if(m_holdCount[bit]++ > 0){
+            return;
+        }
+    }else{
+        if(!track.held.test(bit)){
+            return;
+        }
+        track.held.reset(bit);
+        if(--m_holdCount[bit] > 0){
+            return;
+        }
+    }
+
+    emitButton(bit, actionInfo.isRelease);
+}
+
+void MultiTrackPlayer::releaseTrack(Track &track){
+    if(track.held.none()){
+        return;
+    }
+
+    for(int bit = 0; bit < HELD_KEY_BITS; bit++){
+        if(track.held.test(bit) && --m_holdCount[bit] == 0){
+            emitButton(bit, true);
+        }
+    }
+    track.held.reset();
+}
+
+void MultiTrackPlayer::emitButton(int bit, bool isRelease){
+    if(bit < HELD_MOUSE_BASE){
+        m_player->emitter()->simulateKeyPress(bit, isRelease);
+    }else{
+        m_player->emitter()->simulateMouseAction(bit - HELD_MOUSE_BASE, isRelease);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef MULTITRACKPLAYER_H
+#define MULTITRACKPLAYER_H
+
+#include "recordplayer.h"
+#include "heldkeytracker.h"
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+#include <bitset>
+
+#define TRACKS_SUFFIX ".tracks"
+
+// 多轨播放中的一条轨道
+struct TrackEntry
+{
+    QString recordName;// 录制文件名
+    qint64 offsetMs;// 第一轮的开始时间 ms
+    qint64 periodMs;// 相邻两轮开始时间的间隔 ms, <=0 表示录制时长加 LOOP_GAP_MS
+    int loopCount;// 循环次数, <=0 表示一直循环
+};
+
+// 读取多轨文件
+// 每行格式: "录制文件名 偏移ms 周期ms 循环次数", 后面的数字可省略, 以#开头的行为注释
+bool loadTracksFile(const QString &filePath, QList<TrackEntry> *tracks, QString *errorMsg = nullptr);
+
+// 同时播放多个录制, 例如一条移动轨道叠加不同的技能轨道
+// 用按下一个操作时间排序的最小堆逐个取出各轨道的操作, 不生成合并后的操作列表
+// 每条轨道单独记录自己按下的按键, 多条轨道按住同一个按键时, 最后一条松开时才真正松开
+class MultiTrackPlayer
+{
+public:
+    MultiTrackPlayer(RecordPlayer *player, const std::atomic<bool> *running);
+
+    // 加载所有轨道的录制文件, 多条轨道使用同一个录制时只加载一次
+    bool load(const QString &recordDir, const QList<TrackEntry> &tracks, QString *errorMsg = nullptr);
+
+    // 播放直到所有轨道播放完或停止
+    void run();
+
+private:
+    struct Track
+    {
+        QSharedPointer<const RecordData> data;
+        int loopCount;
+        qint64 period;// ns
+        qint64 loopStart = 0;// 本轮在时间轴上的开始时间 ns
+        int loopsDone = 0;
+        int next = 0;// 下一个操作的序号
+        std::bitset<HELD_KEY_BITS> held;// 本轨道按下且尚未松开的按键
+    };
+
+    // 堆中每条轨道只有一项: 该轨道下一个操作的时间
+    struct Pending
+    {
+        qint64 deadline;
+        int track;
+
+        bool operator>(const Pending &other) const {
+            return deadline != other.deadline ? deadline > other.deadline : track > other.track;
+        }
+    };
+
+    void emitAction(Track &track, const ActionInfo &actionInfo);
+    // 松开本轨道按住的按键, 其他轨道仍按住的不松开
+    void releaseTrack(Track &track);
+    void emitButton(int bit, bool isRelease);
+
+    RecordPlayer *m_player;
+    const std::atomic<bool> *m_running;
+    QList<Track> m_tracks;
+    // 每个按键被多少条轨道按住
+    quint8 m_holdCount[HELD_KEY_BITS] = {};
+};
+
+#endif // MULTITRACKPLAYER_H
@@ -0,0 +1,48 @@
+#include "playbackclock.h"
+#include "tracer.h"
+
+#include <QThread>
+
+static bool isRunning(const std::atomic<bool> *running){
+    return !running || running->load(std::memory_order_acquire);
+}
+
+bool SystemClock::waitUntil(qint64 time, qint64 spinMargin, const std::atomic<bool> *running){
+    // 等待操作时间到, 期间响应停止播放
+    while(time - m_timer.nsecsElapsed() > spinMargin){
+        if(!isRunning(running)){
+            return false;
+        }
+
+        TraceScope sleepScope("sleep");
+        QThread::msleep(1);
+    }
+
+    // 再睡一次可能超过预定时间, 自旋等待
+    if(time > m_timer.nsecsElapsed()){
+        TraceScope spinScope("spin");
+        while(time > m_timer.nsecsElapsed()){
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    return isRunning(running);
+}
+
+void SystemClock::sleep(int ms){
+    QThread::msleep(ms);
+}
+
+bool VirtualClock::waitUntil(qint64 time, qint64 spinMargin, const std::atomic<bool> *running){
+    Q_UNUSED(spinMargin);
+
+    if(!isRunning(running)){
+        return false;
+    }
+
+    // 时间只前进不后退, 已超过预定时间的等待立即返回
+    qint64 now = m_now.load(std::memory_order_relaxed);
+    while(time > now && !m_now.compare_exchange_weak(now, time, std::memory_order_relaxed)){
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef PLAYBACKCLOCK_H
+#define PLAYBACKCLOCK_H
+
+#include <QElapsedTimer>
+
+#include <atomic>
+
+// 播放的时间源: 播放器、调度器和复位移动都通过它读取时间和等待
+class PlaybackClock
+{
+public:
+    virtual ~PlaybackClock() = default;
+
+    // 开始计时, 时间从0开始
+    virtual void start() = 0;
+    // 开始计时后经过的时间 ns
+    virtual qint64 nsecsElapsed() const = 0;
+
+    // 等待到 time(ns), 剩余时间少于 spinMargin 时改为自旋
+    // running 不为空且变为false时提前返回false
+    virtual bool waitUntil(qint64 time, qint64 spinMargin, const std::atomic<bool> *running) = 0;
+    // 睡眠 ms 毫秒, 用于复位移动的步进
+    virtual void sleep(int ms) = 0;
+
+    // 虚拟时钟不随实际时间前进, 只在等待时直接跳到等待的时间
+    virtual bool isVirtual() const { return false; }
+};
+
+// 实际时间: 高精度计时器, 睡眠加自旋等待
+class SystemClock : public PlaybackClock
+{
+public:
+    void start() override { m_timer.start(); }
+    qint64 nsecsElapsed() const override { return m_timer.nsecsElapsed(); }
+    bool waitUntil(qint64 time, qint64 spinMargin, const std::atomic<bool> *running) override;
+    void sleep(int ms) override;
+
+private:
+    QElapsedTimer m_timer;
+};
+
+// 虚拟时间: 等待时直接前进到预定时间, 不睡眠
+// 播放以CPU允许的最快速度进行, 发送时间与预定时间完全一致, 多次运行结果相同
+// 用于在回环后端上快速验证长时间的播放
+class VirtualClock : public PlaybackClock
+{
+public:
+    void start() override { m_now.store(0, std::memory_order_relaxed); }
+    qint64 nsecsElapsed() const override { return m_now.load(std::memory_order_relaxed); }
+    bool waitUntil(qint64 time, qint64 spinMargin, const std::atomic<bool> *running) override;
+    void sleep(int ms) override { advance(ms * 1000000LL); }
+    bool isVirtual() const override { return true; }
+
+    // 时间前进 ns
+    void advance(qint64 ns) { m_now.fetch_add(qMax<qint64>(0, ns), std::memory_order_relaxed); }
+
+private:
+    // 调度器的时间可能在其它线程读取
+    std::atomic<qint64> m_now{0};
+};
+
+#endif // PLAYBACKCLOCK_H
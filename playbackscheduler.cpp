@@ -0,0 +1,344 @@
+#include "playbackscheduler.h"
+#include "tracer.h"
+
+#include <QDeadlineTimer>
+#include <QThread>
+
+#include <algorithm>
+
+// 就绪列表按发送时间排成最小堆
+static bool laterSession(const TimerNode *a, const TimerNode *b){
+    return a->deadline > b->deadline;
+}
+
+PlaybackScheduler::PlaybackScheduler(PlaybackClock *clock)
+    : m_clock(clock ? clock : &m_systemClock)
+{
+    m_clock->start();
+    m_thread = QThread::create([this]{ run(); });
+    m_thread->start(QThread::TimeCriticalPriority);
+}
+
+PlaybackScheduler::~PlaybackScheduler(){
+    {
+        QMutexLocker locker(&m_mutex);
+        m_quit = true;
+        m_hasCommands.store(true, std::memory_order_release);
+        m_wake.wakeAll();
+    }
+    m_thread->wait();
+    delete m_thread;
+}
+
+void PlaybackScheduler::setTimingProfile(const TimingProfile &profile){
+    QMutexLocker locker(&m_mutex);
+    m_newProfile = profile;
+    m_profileChanged = true;
+    m_hasCommands.store(true, std::memory_order_release);
+    m_wake.wakeAll();
+}
+
+int PlaybackScheduler::addSession(const SessionOptions &options){
+    QMutexLocker locker(&m_mutex);
+    int id = m_nextId++;
+    m_commands.append(Command{Command::ADD, id, options});
+    m_activeSessions.fetch_add(1, std::memory_order_acq_rel);
+    m_hasCommands.store(true, std::memory_order_release);
+    m_wake.wakeAll();
+    return id;
+}
+
+int PlaybackScheduler::addSessions(const QList<SessionOptions> &sessions){
+    QMutexLocker locker(&m_mutex);
+    int firstId = m_nextId;
+    for(const SessionOptions &options : sessions){
+        m_commands.append(Command{Command::ADD, m_nextId++, options});
+    }
+    m_activeSessions.fetch_add(int(sessions.size()), std::memory_order_acq_rel);
+    m_hasCommands.store(true, std::memory_order_release);
+    m_wake.wakeAll();
+    return firstId;
+}
+
+void PlaybackScheduler::stopSession(int id){
+    QMutexLocker locker(&m_mutex);
+    m_commands.append(Command{Command::STOP, id, SessionOptions()});
+    m_hasCommands.store(true, std::memory_order_release);
+    m_wake.wakeAll();
+}
+
+bool PlaybackScheduler::waitForIdle(qint64 timeoutMs){
+    QDeadlineTimer deadline(timeoutMs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(timeoutMs));
+    QMutexLocker locker(&m_mutex);
+    while(activeSessions() > 0){
+        if(!m_idle.wait(&m_mutex, deadline)){
+            return activeSessions() == 0;
+        }
+    }
+    return true;
+}
+
+bool PlaybackScheduler::takeCommands(){
+    if(!m_hasCommands.load(std::memory_order_acquire)){
+        return true;
+    }
+
+    QList<Command> commands;
+    bool quit;
+    {
+        QMutexLocker locker(&m_mutex);
+        commands.swap(m_commands);
+        quit = m_quit;
+        if(m_profileChanged){
+            m_spinMargin = m_newProfile.spinMargin();
+            m_leadTime = m_newProfile.leadTime();
+            m_leadBackend = m_newProfile.backend;
+            m_profileChanged = false;
+        }
+        m_hasCommands.store(false, std::memory_order_release);
+    }
+
+    for(const Command &command : std::as_const(commands)){
+        if(command.kind == Command::ADD){
+            startSession(command.id, command.options);
+        }else{
+            for(const std::unique_ptr<Session> &session : m_sessions){
+                if(session->id == command.id){
+                    finishSession(session.get());
+                    break;
+                }
+            }
+        }
+    }
+
+    if(quit){
+        while(!m_sessions.empty()){
+            finishSession(m_sessions.back().get());
+        }
+        return false;
+    }
+    return true;
+}
+
+qint64 PlaybackScheduler::leadTimeFor(const Session *session) const{
+    return m_leadBackend == session->options.emitter->backendName() ? m_leadTime : 0;
+}
+
+void PlaybackScheduler::startSession(int id, const SessionOptions &options){
+    std::unique_ptr<Session> session(new Session);
+    session->id = id;
+    session->options = options;
+    session->timer.owner = session.get();
+    session->loopStart = options.startTime >= 0 ? options.startTime : m_clock->nsecsElapsed();
+
+    Session *raw = session.get();
+    m_sessions.push_back(std::move(session));
+    m_ready.reserve(m_sessions.size());
+
+    if(raw->options.transform){
+        raw->options.transform->reset();
+    }
+
+    // 空的录制直接结束
+    if(!raw->options.data || !loadPending(raw)){
+        finishSession(raw);
+        return;
+    }
+    schedule(raw);
+}
+
+void PlaybackScheduler::finishSession(Session *session){
+    m_wheel.remove(&session->timer);
+    auto ready = std::find(m_ready.begin(), m_ready.end(), session);
+    if(ready != m_ready.end()){
+        m_ready.erase(ready);
+        std::make_heap(m_ready.begin(), m_ready.end(), [](const Session *a, const Session *b){
+            return laterSession(&a->timer, &b->timer);
+        });
+    }
+
+    // 松开本会话按下的按键
+    session->options.emitter->releaseHeldKeys();
+    if(session->options.finished){
+        session->options.finished(session->id);
+    }
+
+    auto it = std::find_if(m_sessions.begin(), m_sessions.end(), [=](const std::unique_ptr<Session> &item){
+        return item.get() == session;
+    });
+    m_sessions.erase(it);
+
+    if(m_activeSessions.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        QMutexLocker locker(&m_mutex);
+        m_idle.wakeAll();
+    }
+}
+
+bool PlaybackScheduler::loadPending(Session *session){
+    const QList<ActionInfo> &actionList = session->options.data->actionList;
+    ActionTransform *transform = session->options.transform;
+
+    while(session->next < actionList.size()){
+        session->pending = actionList[session->next++];
+        if(!transform || transform->apply(session->pending)){
+            session->hasPending = true;
+            return true;
+        }
+    }
+
+    session->hasPending = false;
+    return false;
+}
+
+void PlaybackScheduler::schedule(Session *session){
+    session->timer.deadline = session->loopStart + session->pending.actionTime - leadTimeFor(session);
+    if(!m_wheel.insert(&session->timer)){
+        // 当前 tick 内就要发送
+        m_ready.push_back(session);
+        std::push_heap(m_ready.begin(), m_ready.end(), [](const Session *a, const Session *b){
+            return laterSession(&a->timer, &b->timer);
+        });
+    }
+}
+
+void PlaybackScheduler::dispatch(Session *session, qint64 now){
+    const SessionOptions &options = session->options;
+    qint64 leadTime = leadTimeFor(session);
+    int count = 0;
+
+    TraceScope scope("dispatch", "session", session->id);
+
+    while(session->hasPending){
+        const ActionInfo &actionInfo = session->pending;
+        qint64 deadline = session->loopStart + actionInfo.actionTime;
+        if(deadline - leadTime > now){
+            break;
+        }
+
+        if(options.stats){
+            options.stats->addEmit(m_clock->nsecsElapsed() + leadTime - deadline);
+        }
+
+        switch(actionInfo.actionType){
+        case ACTION_MOUSE_MOVE:
+            options.emitter->simulateMouseRelativeMove(actionInfo.dx, actionInfo.dy);
+            break;
+        case ACTION_MOUSE_BUTTON:
+            options.emitter->simulateMouseAction(actionInfo.keyCode, actionInfo.isRelease);
+            break;
+        case ACTION_KEYBOARD:
+            options.emitter->simulateKeyPress(actionInfo.keyCode, actionInfo.isRelease);
+            break;
+        }
+        count++;
+
+        if(loadPending(session)){
+            continue;
+        }
+
+        // 本轮结束, 松开未松开的按键
+        options.emitter->releaseHeldKeys();
+        if(options.stats){
+            options.stats->addLoop();
+        }
+        session->loopsDone++;
+        if(options.loopCount > 0 && session->loopsDone >= options.loopCount){
+            break;
+        }
+
+        const RecordData &data = *options.data;
+        qint64 loopDuration = options.transform ? options.transform->duration(data.duration()) : data.duration();
+        session->loopStart += loopDuration + options.loopGap;
+        session->next = 0;
+        if(options.transform){
+            options.transform->reset();
+        }
+        // 下一轮重新排队, 不在一次发送中连续播放多轮
+        loadPending(session);
+        break;
+    }
+
+    if(count > 0){
+        // 一批操作一起送出
+        options.emitter->flush();
+        m_batches.fetch_add(1, std::memory_order_relaxed);
+    }
+    scope.setArg(count);
+
+    if(session->hasPending){
+        schedule(session);
+    }else{
+        finishSession(session);
+    }
+}
+
+void PlaybackScheduler::run(){
+    Tracer::setThreadName("scheduler");
+
+    auto later = [](const Session *a, const Session *b){
+        return laterSession(&a->timer, &b->timer);
+    };
+
+    while(takeCommands()){
+        qint64 now = m_clock->nsecsElapsed();
+
+        // 自旋余量内到期的会话都取出到就绪列表, 之后按精确时间发送
+        m_wheel.advance(TimingWheel::tickOf(now + m_spinMargin), [&](TimerNode *node){
+            m_ready.push_back(static_cast<Session *>(node->owner));
+            std::push_heap(m_ready.begin(), m_ready.end(), later);
+        });
+
+        while(!m_ready.empty() && m_ready.front()->timer.deadline <= now){
+            std::pop_heap(m_ready.begin(), m_ready.end(), later);
+            Session *session = m_ready.back();
+            m_ready.pop_back();
+            dispatch(session, now);
+        }
+
+        // 下一次醒来的时间: 最早的就绪会话, 或时间轮中下一个可能到期的 tick
+        qint64 wake = -1;
+        if(!m_ready.empty()){
+            wake = m_ready.front()->timer.deadline;
+        }
+        qint64 nextTick = m_wheel.nextTick();
+        if(nextTick >= 0){
+            qint64 tickWake = TimingWheel::tickStart(nextTick) - m_spinMargin;
+            wake = wake < 0 ? tickWake : qMin(wake, tickWake);
+        }
+
+        now = m_clock->nsecsElapsed();
+        if(wake >= 0 && wake <= now){
+            continue;
+        }
+
+        // 虚拟时钟直接前进到醒来时间; 没有会话时仍等待新命令
+        if(m_clock->isVirtual() && wake >= 0){
+            if(!m_hasCommands.load(std::memory_order_acquire)){
+                m_clock->waitUntil(wake, 0, nullptr);
+            }
+            m_wakeups.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // 距离醒来时间超过自旋余量时睡眠, 有新命令时立即醒来
+        qint64 remaining = wake < 0 ? -1 : wake - now;
+        qint64 sleepNs = remaining < 0 ? -1 : (m_spinMargin > 0 ? remaining - m_spinMargin : remaining + 999999);
+        if(remaining < 0 || sleepNs >= 1000000){
+            QMutexLocker locker(&m_mutex);
+            if(!m_hasCommands.load(std::memory_order_acquire)){
+                TraceScope sleepScope("sleep");
+                if(remaining < 0){
+                    m_wake.wait(&m_mutex);
+                }else{
+                    m_wake.wait(&m_mutex, QDeadlineTimer(sleepNs / 1000000, Qt::PreciseTimer));
+                }
+            }
+        }else{
+            TraceScope spinScope("spin");
+            while(m_clock->nsecsElapsed() < wake && !m_hasCommands.load(std::memory_order_acquire)){
+                QThread::yieldCurrentThread();
+            }
+        }
+        m_wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef PLAYBACKSCHEDULER_H
+#define PLAYBACKSCHEDULER_H
+
+#include "actiontransform.h"
+#include "inputemitter.h"
+#include "playbackclock.h"
+#include "playbackstats.h"
+#include "recordfile.h"
+#include "timingprofile.h"
+#include "timingwheel.h"
+
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+// 一个播放会话: 一个录制按自己的循环次数播放到自己的发送后端
+struct SessionOptions
+{
+    QSharedPointer<const RecordData> data;
+    InputEmitter *emitter = nullptr;// 会话独占, 只在调度线程中使用
+    PlaybackStats *stats = nullptr;// 为空时不统计
+    ActionTransform *transform = nullptr;// 会话独占, 为空时不变换
+    int loopCount = 1;// <=0 表示一直循环
+    qint64 loopGap = 0;// 两轮之间的间隔 ns
+    qint64 startTime = -1;// 第一轮在调度器时间轴上的开始时间 ns, <0 表示立即开始
+    std::function<void(int)> finished;// 播放完或被停止后在调度线程中调用, 参数为会话id
+};
+
+// 所有会话共用一个调度线程: 每个会话的下一个操作时间放在分级时间轮中
+// 线程只在最近的到期时间醒来, 一次发送一个会话中所有已到时间的操作
+// 几十个会话只占用一个线程, 而不是每个会话一个轮询的线程
+class PlaybackScheduler
+{
+public:
+    // clock 为调度器的时间轴, 为空时使用实际时间; 使用虚拟时钟时不睡眠, 直接前进到下一个到期时间
+    explicit PlaybackScheduler(PlaybackClock *clock = nullptr);
+    // 停止所有会话并结束调度线程
+    ~PlaybackScheduler();
+
+    // 调度器的时间轴, 会话的开始时间和统计都基于它
+    const PlaybackClock &timeline() const { return *m_clock; }
+    qint64 now() const { return m_clock->nsecsElapsed(); }
+
+    // 计时校准, 决定改为自旋等待和提前发送的时间
+    void setTimingProfile(const TimingProfile &profile);
+
+    // 添加会话, 可在任意线程调用, 返回会话id
+    int addSession(const SessionOptions &options);
+    // 一次添加多个会话, 调度线程同时开始处理, 返回第一个会话的id, 之后的id依次加1
+    int addSessions(const QList<SessionOptions> &sessions);
+    // 停止会话并松开它按下的按键
+    void stopSession(int id);
+
+    // 未结束的会话数
+    int activeSessions() const { return m_activeSessions.load(std::memory_order_acquire); }
+    // 等待所有会话结束, timeoutMs <0 表示一直等待, 超时返回false
+    bool waitForIdle(qint64 timeoutMs = -1);
+
+    // 调度线程醒来的次数和发送的批数, 用于评估开销
+    qint64 wakeups() const { return m_wakeups.load(std::memory_order_relaxed); }
+    qint64 batches() const { return m_batches.load(std::memory_order_relaxed); }
+
+private:
+    struct Session
+    {
+        TimerNode timer;// 到期时间为下一个操作的发送时间
+        int id = 0;
+        SessionOptions options;
+        qint64 loopStart = 0;
+        int loopsDone = 0;
+        int next = 0;// 下一个读取的操作
+        ActionInfo pending;// 变换后的下一个操作, 时间为相对本轮开始
+        bool hasPending = false;
+    };
+
+    struct Command
+    {
+        enum Kind { ADD, STOP } kind;
+        int id;
+        SessionOptions options;
+    };
+
+    SystemClock m_systemClock;
+    PlaybackClock *m_clock;
+    QThread *m_thread = nullptr;
+
+    // 其它线程发给调度线程的命令
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QWaitCondition m_idle;
+    QList<Command> m_commands;
+    bool m_quit = false;
+    int m_nextId = 1;
+
+    std::atomic<bool> m_hasCommands{false};
+    // 新的计时校准, 由调度线程取走
+    TimingProfile m_newProfile;
+    bool m_profileChanged = false;
+
+    std::atomic<int> m_activeSessions{0};
+    std::atomic<qint64> m_wakeups{0};
+    std::atomic<qint64> m_batches{0};
+
+    // 以下只在调度线程中访问
+    qint64 m_spinMargin = 0;
+    qint64 m_leadTime = 0;
+    QString m_leadBackend;// 校准时的后端, 只对相同后端的会话提前发送
+    TimingWheel m_wheel;
+    std::vector<std::unique_ptr<Session>> m_sessions;
+    // 已从时间轮中取出、按操作时间排序的会话
+    std::vector<Session *> m_ready;
+
+    void run();
+    // 处理命令, 返回false表示退出
+    bool takeCommands();
+    void startSession(int id, const SessionOptions &options);
+    void finishSession(Session *session);
+
+    // 读取下一个变换后的操作, 本轮结束返回false
+    bool loadPending(Session *session);
+    // 会话下一个操作的到期时间放入时间轮或就绪列表
+    void schedule(Session *session);
+    // 发送会话中所有已到时间的操作
+    void dispatch(Session *session, qint64 now);
+
+    qint64 leadTimeFor(const Session *session) const;
+};
+
+#endif // PLAYBACKSCHEDULER_H
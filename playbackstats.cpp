@@ -0,0 +1,112 @@
+#include "playbackstats.h"
+
+#include <QJsonArray>
+
+// 第 bucket 个桶的上限 ns
+static qint64 bucketLimit(int bucket){
+    return (qint64(1) << bucket) * 1000;
+}
+
+void PlaybackStats::reset(){
+    m_eventsEmitted.store(0, std::memory_order_relaxed);
+    m_loopsCompleted.store(0, std::memory_order_relaxed);
+    m_currentEntry.store(-1, std::memory_order_relaxed);
+    m_latenessSum.store(0, std::memory_order_relaxed);
+    m_maxLateness.store(0, std::memory_order_relaxed);
+    m_triggerTime.store(0, std::memory_order_relaxed);
+    m_wakeTime.store(0, std::memory_order_relaxed);
+    m_firstLateness.store(-1, std::memory_order_relaxed);
+    for(auto &bucket : m_histogram){
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void PlaybackStats::setTriggerTime(qint64 triggerTime, qint64 wakeTime){
+    m_triggerTime.store(triggerTime, std::memory_order_relaxed);
+    m_wakeTime.store(wakeTime, std::memory_order_relaxed);
+}
+
+void PlaybackStats::addEmit(qint64 lateness){
+    if(lateness < 0){
+        lateness = 0;
+    }
+
+    // 第一个操作单独记录延迟, 之后只多一次比较
+    if(m_eventsEmitted.fetch_add(1, std::memory_order_relaxed) == 0){
+        m_firstLateness.store(lateness, std::memory_order_relaxed);
+    }
+    m_latenessSum.fetch_add(lateness, std::memory_order_relaxed);
+
+    // 只有播放线程写入, 不需要比较交换
+    if(lateness > m_maxLateness.load(std::memory_order_relaxed)){
+        m_maxLateness.store(lateness, std::memory_order_relaxed);
+    }
+
+    int bucket = 0;
+    while(bucket < BUCKET_COUNT - 1 && lateness > bucketLimit(bucket)){
+        bucket++;
+    }
+    m_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PlaybackStats::addLoop(){
+    m_loopsCompleted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PlaybackStats::setCurrentEntry(int index){
+    m_currentEntry.store(index, std::memory_order_relaxed);
+}
+
+PlaybackStats::Snapshot PlaybackStats::snapshot() const{
+    Snapshot s;
+    s.eventsEmitted = m_eventsEmitted.load(std::memory_order_relaxed);
+    s.loopsCompleted = m_loopsCompleted.load(std::memory_order_relaxed);
+    s.currentEntry = m_currentEntry.load(std::memory_order_relaxed);
+    s.latenessSum = m_latenessSum.load(std::memory_order_relaxed);
+    s.maxLateness = m_maxLateness.load(std::memory_order_relaxed);
+    s.triggerTime = m_triggerTime.load(std::memory_order_relaxed);
+    s.wakeTime = m_wakeTime.load(std::memory_order_relaxed);
+    s.firstLateness = m_firstLateness.load(std::memory_order_relaxed);
+    for(int i = 0; i < BUCKET_COUNT; i++){
+        s.histogram[i] = m_histogram[i].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+qint64 PlaybackStats::Snapshot::latenessPercentile(double percentile) const{
+    qint64 total = 0;
+    for(qint64 count : histogram){
+        total += count;
+    }
+    if(total == 0){
+        return 0;
+    }
+
+    qint64 target = qint64(total * percentile / 100.0);
+    qint64 accumulated = 0;
+    for(int i = 0; i < BUCKET_COUNT - 1; i++){
+        accumulated += histogram[i];
+        if(accumulated > target){
+            return qMin(bucketLimit(i), maxLateness);
+        }
+    }
+    return maxLateness;
+}
+
+QJsonObject PlaybackStats::Snapshot::toJson() const{
+    QJsonObject json;
+    json["events_emitted"] = eventsEmitted;
+    json["loops_completed"] = loopsCompleted;
+    json["lateness_avg_us"] = eventsEmitted > 0 ? latenessSum / 1000.0 / eventsEmitted : 0.0;
+    json["lateness_p50_us"] = latenessPercentile(50) / 1000.0;
+    json["lateness_p90_us"] = latenessPercentile(90) / 1000.0;
+    json["lateness_p99_us"] = latenessPercentile(99) / 1000.0;
+    json["lateness_max_us"] = maxLateness / 1000.0;
+    if(triggerToWake() >= 0){
+        json["trigger_to_wake_ms"] = triggerToWake() / 1000000.0;
+    }
+    if(firstLateness >= 0){
+        json["first_event_lateness_ms"] = firstLateness / 1000000.0;
+    }
+    return json;
+}
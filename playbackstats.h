@@ -0,0 +1,64 @@
+#ifndef PLAYBACKSTATS_H
+#define PLAYBACKSTATS_H
+
+#include <QJsonObject>
+
+#include <atomic>
+
+// 播放过程的统计: 发送的操作数, 完成的轮数, 操作实际发送时间相对预定时间的延迟分布, 按下热键到播放线程开始的耗时
+// 播放线程写入, 其它线程随时读取, 全部为无锁计数, 读取不会影响播放线程
+class PlaybackStats
+{
+public:
+    // 延迟直方图的桶数, 第i个桶的上限为 2^i us, 最后一个桶没有上限
+    static constexpr int BUCKET_COUNT = 24;
+
+    struct Snapshot
+    {
+        qint64 eventsEmitted = 0;// 发送的操作数
+        qint64 loopsCompleted = 0;// 完成的轮数
+        int currentEntry = -1;// 正在播放的播放列表项, -1表示没有播放
+        qint64 latenessSum = 0;// 延迟总和 ns
+        qint64 maxLateness = 0;// 最大延迟 ns
+        qint64 histogram[BUCKET_COUNT] = {};
+        qint64 triggerTime = 0;// 请求开始播放的时间, Tracer::now() 的时钟, 0表示没有记录
+        qint64 wakeTime = 0;// 播放线程开始这次播放的时间, 同上
+        qint64 firstLateness = -1;// 第一个操作相对预定时间的延迟 ns, -1表示还没有发送
+
+        // 请求开始播放到播放线程开始的耗时 ns, 没有记录时返回-1
+        // 第一个操作的预定时间取决于录制开头的空闲时长和复位移动, 不计入, 其延迟见 firstLateness
+        qint64 triggerToWake() const { return triggerTime > 0 && wakeTime > 0 ? wakeTime - triggerTime : -1; }
+
+        // 延迟的百分位数 ns, 取所在桶的上限
+        qint64 latenessPercentile(double percentile) const;
+        QJsonObject toJson() const;
+    };
+
+    // 开始新的播放前调用
+    void reset();
+
+    // 记录请求开始播放的时间(按下热键或点击按钮)和播放线程开始的时间, Tracer::now() 的时钟, 在 reset 之后调用
+    void setTriggerTime(qint64 triggerTime, qint64 wakeTime);
+
+    // 记录一次发送, lateness 为实际发送时间减预定时间 ns
+    void addEmit(qint64 lateness);
+    // 完成一轮播放
+    void addLoop();
+    // 切换到播放列表的第 index 项
+    void setCurrentEntry(int index);
+
+    Snapshot snapshot() const;
+
+private:
+    std::atomic<qint64> m_eventsEmitted{0};
+    std::atomic<qint64> m_loopsCompleted{0};
+    std::atomic<int> m_currentEntry{-1};
+    std::atomic<qint64> m_latenessSum{0};
+    std::atomic<qint64> m_maxLateness{0};
+    std::atomic<qint64> m_triggerTime{0};
+    std::atomic<qint64> m_wakeTime{0};
+    std::atomic<qint64> m_firstLateness{-1};
+    std::atomic<qint64> m_histogram[BUCKET_COUNT] = {};
+};
+
+#endif // PLAYBACKSTATS_H
@@ -0,0 +1,201 @@
+#include "recordbatch.h"
+#include "heldkeytracker.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <bitset>
+#include <limits>
+
+BatchFileReport processRecordFile(const QString &filePath, const QString &outputPath, RecordFormat outputFormat){
+    BatchFileReport report;
+    report.filePath = filePath;
+    report.bytes = QFileInfo(filePath).size();
+
+    RecordReader reader;
+    if(!reader.open(filePath, &report.error)){
+        return report;
+    }
+
+    // 问题描述带上位置, 便于定位
+    auto addMessage = [&](const QString &msg){
+        if(report.messages.size() < BatchFileReport::MAX_MESSAGES){
+            QString position = reader.format() == RECORD_FORMAT_TEXT
+                                   ? QString("第%1行").arg(reader.position())
+                                   : QString("第%1个操作").arg(reader.position());
+            report.messages.append(position + ": " + msg);
+        }
+    };
+
+    bool converting = !outputPath.isEmpty();
+    RecordWriter writer;
+    if(converting){
+        if(QFileInfo(outputPath).absoluteFilePath() == QFileInfo(filePath).absoluteFilePath()){
+            report.error = "输出文件与输入文件相同:" + outputPath;
+            return report;
+        }
+        QDir().mkpath(QFileInfo(outputPath).absolutePath());
+        if(!writer.open(outputPath, outputFormat, reader.firstX(), reader.firstY(), &report.error)){
+            return report;
+        }
+    }
+
+    // 按下状态, 与 HeldKeyTracker 的位置相同
+    std::bitset<HELD_KEY_BITS> held;
+    qint64 lastTime = std::numeric_limits<qint64>::min();
+
+    ActionInfo actionInfo;
+    bool reading = true;
+    while(reading){
+        switch(reader.readNext(&actionInfo)){
+        case RecordReader::READ_MALFORMED:
+            report.malformedLines++;
+            addMessage(reader.reason());
+            continue;
+        case RecordReader::READ_UNKNOWN_KEY:
+            report.unknownKeys++;
+            addMessage(reader.reason());
+            continue;
+        case RecordReader::READ_ERROR:
+            report.error = reader.reason();
+            if(converting){
+                writer.discard();
+            }
+            return report;
+        case RecordReader::READ_END:
+            reading = false;
+            continue;
+        case RecordReader::READ_ACTION:
+            break;
+        }
+
+        if(actionInfo.actionTime < lastTime){
+            report.nonMonotonic++;
+            addMessage(QString("时间 %1 早于上一个操作的时间 %2").arg(actionInfo.actionTime).arg(lastTime));
+        }
+        lastTime = actionInfo.actionTime;
+
+        if(actionInfo.actionType != ACTION_MOUSE_MOVE){
+            int bit = actionInfo.actionType == ACTION_KEYBOARD
+                          ? (actionInfo.keyCode & 0xFF)
+                          : HELD_MOUSE_BASE + (actionInfo.keyCode & 0x07);
+            if(!actionInfo.isRelease){
+                if(held.test(bit)){
+                    report.unmatchedPresses++;
+                    addMessage("重复按下 " + actionName(actionInfo));
+                }
+                held.set(bit);
+            }else{
+                if(!held.test(bit)){
+                    report.unmatchedReleases++;
+                    addMessage("没有按下就松开 " + actionName(actionInfo));
+                }
+                held.reset(bit);
+            }
+        }
+
+        report.actions++;
+        if(converting){
+            writer.write(actionInfo);
+        }
+    }
+
+    if(held.any()){
+        report.unmatchedPresses += qint64(held.count());
+        addMessage(QString("结尾仍有 %1 个按键未松开").arg(qint64(held.count())));
+    }
+
+    if(converting && !writer.close(&report.error)){
+        writer.discard();
+    }
+
+    return report;
+}
+
+BatchReport processRecordDir(const QString &inputDir, const BatchOptions &options){
+    QElapsedTimer timer;
+    timer.start();
+
+    // 先列出所有文件, 文件名列表远小于文件内容
+    QStringList files;
+    QDirIterator it(inputDir, QStringList() << "*" RECORD_SUFFIX, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()){
+        files.append(it.next());
+    }
+    files.sort();
+
+    QDir input(inputDir);
+    QString outputDir = options.outputDir;
+    RecordFormat outputFormat = options.outputFormat;
+    auto process = [input, outputDir, outputFormat](const QString &filePath){
+        QString outputPath;
+        if(!outputDir.isEmpty()){
+            outputPath = QDir(outputDir).filePath(input.relativeFilePath(filePath));
+        }
+        return processRecordFile(filePath, outputPath, outputFormat);
+    };
+
+    // 汇总时只保留有问题的文件
+    auto reduce = [](BatchReport &report, const BatchFileReport &file){
+        report.files++;
+        report.actions += file.actions;
+        report.bytes += file.bytes;
+        report.malformedLines += file.malformedLines;
+        report.unknownKeys += file.unknownKeys;
+        report.unmatchedPresses += file.unmatchedPresses;
+        report.unmatchedReleases += file.unmatchedReleases;
+        report.nonMonotonic += file.nonMonotonic;
+
+        if(!file.error.isEmpty()){
+            report.failedFiles++;
+        }else if(!file.isValid()){
+            report.invalidFiles++;
+        }
+        if(!file.isValid()){
+            report.problemFiles.append(file);
+        }
+    };
+
+    QThreadPool pool;
+    if(options.threadCount > 0){
+        pool.setMaxThreadCount(options.threadCount);
+    }
+
+    BatchReport report = QtConcurrent::blockingMappedReduced<BatchReport>(
+        &pool, files, process, reduce, QtConcurrent::OrderedReduce);
+    report.elapsed = timer.nsecsElapsed();
+    return report;
+}
+
+QString BatchReport::toText() const{
+    QString text;
+    for(const BatchFileReport &file : problemFiles){
+        text.append(file.filePath).append("\n");
+        if(!file.error.isEmpty()){
+            text.append("  错误: ").append(file.error).append("\n");
+        }
+        if(file.issueCount() > 0){
+            text.append(QString("  格式错误 %1, 未知按键 %2, 未松开 %3, 未按下 %4, 时间倒退 %5\n")
+                            .arg(file.malformedLines).arg(file.unknownKeys).arg(file.unmatchedPresses)
+                            .arg(file.unmatchedReleases).arg(file.nonMonotonic));
+        }
+        for(const QString &msg : file.messages){
+            text.append("  ").append(msg).append("\n");
+        }
+    }
+
+    double seconds = elapsed / 1e9;
+    text.append(QString("文件数: %1, 失败 %2, 有问题 %3\n").arg(files).arg(failedFiles).arg(invalidFiles));
+    text.append(QString("操作数: %1\n").arg(actions));
+    text.append(QString("格式错误 %1, 未知按键 %2, 未松开 %3, 未按下 %4, 时间倒退 %5\n")
+                    .arg(malformedLines).arg(unknownKeys).arg(unmatchedPresses)
+                    .arg(unmatchedReleases).arg(nonMonotonic));
+    text.append(QString("耗时: %1 ms, %2 MB/s\n")
+                    .arg(elapsed / 1000000.0, 0, 'f', 1)
+                    .arg(seconds > 0 ? bytes / 1048576.0 / seconds : 0.0, 0, 'f', 1));
+    return text;
+}
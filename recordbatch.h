@@ -0,0 +1,75 @@
+#ifndef RECORDBATCH_H
+#define RECORDBATCH_H
+
+#include "recordfile.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// 批量处理的参数
+struct BatchOptions
+{
+    // 转换后的文件保存到该目录, 保持相对路径; 为空时只检查不转换
+    QString outputDir;
+    RecordFormat outputFormat = RECORD_FORMAT_TEXT;
+    // 线程数, 0 表示使用所有核心
+    int threadCount = 0;
+};
+
+// 单个文件的检查结果
+struct BatchFileReport
+{
+    // 每个文件最多保留的问题描述条数
+    static constexpr int MAX_MESSAGES = 5;
+
+    QString filePath;
+    QString error;// 无法读取或写入时的错误, 不为空时文件处理失败
+    qint64 actions = 0;// 有效操作数
+    qint64 bytes = 0;// 文件字节数
+
+    qint64 malformedLines = 0;// 格式错误的行
+    qint64 unknownKeys = 0;// 未知按键
+    qint64 unmatchedPresses = 0;// 重复按下或到结尾仍未松开
+    qint64 unmatchedReleases = 0;// 没有按下就松开
+    qint64 nonMonotonic = 0;// 时间早于上一个操作
+
+    QStringList messages;// 前几条问题, 含行号
+
+    qint64 issueCount() const {
+        return malformedLines + unknownKeys + unmatchedPresses + unmatchedReleases + nonMonotonic;
+    }
+    bool isValid() const { return error.isEmpty() && issueCount() == 0; }
+};
+
+// 整个目录的处理结果
+struct BatchReport
+{
+    int files = 0;
+    int failedFiles = 0;// 无法读取或写入的文件
+    int invalidFiles = 0;// 可以读取但有问题的文件
+    qint64 actions = 0;
+    qint64 bytes = 0;// 输入文件的总字节数
+    qint64 elapsed = 0;// 总耗时 ns
+
+    // 各类问题的总数
+    qint64 malformedLines = 0;
+    qint64 unknownKeys = 0;
+    qint64 unmatchedPresses = 0;
+    qint64 unmatchedReleases = 0;
+    qint64 nonMonotonic = 0;
+
+    // 只保留有问题的文件
+    QList<BatchFileReport> problemFiles;
+
+    // 多行文本形式的报告
+    QString toText() const;
+};
+
+// 检查(并转换)一个录制文件, 逐个操作读写, 内存占用与文件大小无关
+BatchFileReport processRecordFile(const QString &filePath, const QString &outputPath, RecordFormat outputFormat);
+
+// 在线程池中处理目录(含子目录)下的所有录制文件
+BatchReport processRecordDir(const QString &inputDir, const BatchOptions &options);
+
+#endif // RECORDBATCH_H
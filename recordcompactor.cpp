@@ -0,0 +1,205 @@
+#include "recordcompactor.h"
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+// 一个操作在录制文件中占用的字节数(含换行)
+static qint64 actionBytes(const ActionInfo &actionInfo){
+    return formatAction(actionInfo).toUtf8().size() + 1;
+}
+
+static void removeAction(const QList<ActionInfo> &actionList, QVector<bool> &removed, int index, CompactRuleStat &stat){
+    removed[index] = true;
+    stat.removedActions++;
+    stat.savedBytes += actionBytes(actionList[index]);
+}
+
+// 删除按键抖动: 同一按键相邻的按下/松开间隔小于阈值时成对删除
+static void removeChatter(const QList<ActionInfo> &actionList, QVector<bool> &removed, qint64 threshold, CompactRuleStat &stat){
+    // 按键 -> 该按键上一个保留的操作
+    QHash<int, int> lastAction;
+
+    for(int i = 0; i < actionList.size(); i++){
+        const ActionInfo &actionInfo = actionList[i];
+        if(removed[i] || actionInfo.actionType == ACTION_MOUSE_MOVE){
+            continue;
+        }
+
+        int keyId = actionInfo.actionType * 0x10000 + actionInfo.keyCode;
+        auto it = lastAction.find(keyId);
+        if(it != lastAction.end()){
+            const ActionInfo &prev = actionList[it.value()];
+            if(prev.isRelease != actionInfo.isRelease && actionInfo.actionTime - prev.actionTime < threshold){
+                removeAction(actionList, removed, it.value(), stat);
+                removeAction(actionList, removed, i, stat);
+
+                // 删除后按键回到更早的状态, 不再与之前的操作配对
+                lastAction.erase(it);
+                continue;
+            }
+        }
+
+        lastAction[keyId] = i;
+    }
+}
+
+// 删除鼠标抖动: 连续的鼠标移动中, 时间窗口内净移动为0的一段整段删除
+static void removeJitter(const QList<ActionInfo> &actionList, QVector<bool> &removed, qint64 window, CompactRuleStat &stat){
+    int i = 0;
+    while(i < actionList.size()){
+        if(removed[i] || actionList[i].actionType != ACTION_MOUSE_MOVE){
+            i++;
+            continue;
+        }
+
+        // 找出一段连续的鼠标移动
+        QVector<int> run;
+        while(i < actionList.size() && (removed[i] || actionList[i].actionType == ACTION_MOUSE_MOVE)){
+            if(!removed[i]){
+                run.append(i);
+            }
+            i++;
+        }
+
+        // 累计移动量 -> 达到该累计量时已处理的移动数
+        QHash<QPair<qint64, qint64>, int> seen;
+        QPair<qint64, qint64> sum(0, 0);
+        seen[sum] = 0;
+
+        for(int t = 1; t <= run.size(); t++){
+            const ActionInfo &move = actionList[run[t - 1]];
+            sum.first += move.dx;
+            sum.second += move.dy;
+
+            auto it = seen.find(sum);
+            if(it != seen.end()){
+                int s = it.value();
+                // run[s..t-1] 的净移动量为0
+                if(move.actionTime - actionList[run[s]].actionTime <= window){
+                    for(int k = s; k < t; k++){
+                        removeAction(actionList, removed, run[k], stat);
+                    }
+                    seen.clear();
+                }
+            }
+
+            seen[sum] = t;
+        }
+    }
+}
+
+// 删除最后一个按键操作之后的鼠标移动
+static void removeTrailingMoves(const QList<ActionInfo> &actionList, QVector<bool> &removed, CompactRuleStat &stat){
+    int lastKey = -1;
+    for(int i = actionList.size() - 1; i >= 0; i--){
+        if(!removed[i] && actionList[i].actionType != ACTION_MOUSE_MOVE){
+            lastKey = i;
+            break;
+        }
+    }
+
+    // 没有按键操作, 只有鼠标移动的录制不处理
+    if(lastKey < 0){
+        return;
+    }
+
+    for(int i = lastKey + 1; i < actionList.size(); i++){
+        if(!removed[i]){
+            removeAction(actionList, removed, i, stat);
+        }
+    }
+}
+
+CompactReport compactRecord(RecordData *data, const CompactOptions &options){
+    CompactReport report;
+    const QList<ActionInfo> &actionList = data->actionList;
+
+    report.originalActions = actionList.size();
+    report.originalDuration = data->duration();
+
+    QVector<bool> removed(actionList.size(), false);
+
+    if(options.chatterThreshold > 0){
+        removeChatter(actionList, removed, options.chatterThreshold, report.chatter);
+    }
+    if(options.jitterWindow > 0){
+        removeJitter(actionList, removed, options.jitterWindow, report.jitter);
+    }
+
+    qint64 durationBeforeTrailing = 0;
+    for(int i = actionList.size() - 1; i >= 0; i--){
+        if(!removed[i]){
+            durationBeforeTrailing = actionList[i].actionTime;
+            break;
+        }
+    }
+    if(options.trimTrailingMoves){
+        removeTrailingMoves(actionList, removed, report.trailing);
+    }
+
+    // 保留的操作, 同时压缩空闲时长
+    QList<ActionInfo> result;
+    result.reserve(actionList.size());
+
+    qint64 shift = 0;
+    qint64 prevTime = 0;
+    for(int i = 0; i < actionList.size(); i++){
+        if(removed[i]){
+            continue;
+        }
+
+        ActionInfo actionInfo = actionList[i];
+        qint64 originalTime = actionInfo.actionTime;
+
+        if(result.isEmpty()){
+            if(options.maxLeadingIdle > 0 && originalTime > options.maxLeadingIdle){
+                shift = originalTime - options.maxLeadingIdle;
+            }
+        }else if(options.maxIdleGap > 0 && originalTime - prevTime > options.maxIdleGap){
+            shift += originalTime - prevTime - options.maxIdleGap;
+        }
+        prevTime = originalTime;
+
+        if(shift > 0){
+            qint64 bytesBefore = actionBytes(actionInfo);
+            actionInfo.actionTime = originalTime - shift;
+            report.idle.savedBytes += bytesBefore - actionBytes(actionInfo);
+        }
+
+        result.append(actionInfo);
+    }
+
+    if(!result.isEmpty()){
+        report.trailing.savedTime = durationBeforeTrailing - prevTime;
+    }
+    report.idle.savedTime = shift;
+
+    data->actionList = result;
+
+    report.remainingActions = data->actionList.size();
+    report.remainingDuration = data->duration();
+
+    return report;
+}
+
+static QString ruleText(const QString &name, const CompactRuleStat &stat){
+    return QString("%1: 删除 %2 个操作, 减少 %3 字节, 缩短 %4 ms\n")
+        .arg(name)
+        .arg(stat.removedActions)
+        .arg(stat.savedBytes)
+        .arg(stat.savedTime / 1000000.0, 0, 'f', 1);
+}
+
+QString CompactReport::toText() const{
+    QString text;
+    text.append(QString("操作数: %1 -> %2\n").arg(originalActions).arg(remainingActions));
+    text.append(QString("时长: %1 ms -> %2 ms\n")
+                    .arg(originalDuration / 1000000.0, 0, 'f', 1)
+                    .arg(remainingDuration / 1000000.0, 0, 'f', 1));
+    text.append(ruleText("按键抖动", chatter));
+    text.append(ruleText("鼠标抖动", jitter));
+    text.append(ruleText("结尾鼠标移动", trailing));
+    text.append(ruleText("空闲时长", idle));
+    return text;
+}
@@ -0,0 +1,51 @@
+#ifndef RECORDCOMPACTOR_H
+#define RECORDCOMPACTOR_H
+
+#include "recordfile.h"
+
+#include <QString>
+
+// 精简规则, 时长单位均为 ns, 为0表示不启用该规则
+struct CompactOptions
+{
+    // 按下到松开(或松开到再次按下)短于该时长的按键抖动, 成对删除
+    qint64 chatterThreshold = 3000000;
+    // 该时长内净移动量为0的连续鼠标移动, 整段删除
+    qint64 jitterWindow = 20000000;
+    // 第一个操作前最多保留的空闲时长
+    qint64 maxLeadingIdle = 500000000;
+    // 操作之间最多保留的空闲时长
+    qint64 maxIdleGap = 0;
+    // 删除最后一个按键操作之后的鼠标移动(按F7结束录制时产生)
+    bool trimTrailingMoves = true;
+};
+
+// 单条规则的精简结果
+struct CompactRuleStat
+{
+    int removedActions = 0;// 删除的操作数
+    qint64 savedBytes = 0;// 减少的文件字节数
+    qint64 savedTime = 0;// 缩短的时长 ns
+};
+
+// 精简报告
+struct CompactReport
+{
+    int originalActions = 0;
+    int remainingActions = 0;
+    qint64 originalDuration = 0;
+    qint64 remainingDuration = 0;
+
+    CompactRuleStat chatter;// 按键抖动
+    CompactRuleStat jitter;// 鼠标抖动
+    CompactRuleStat trailing;// 结尾鼠标移动
+    CompactRuleStat idle;// 开头和中间的空闲时长
+
+    // 多行文本形式的报告
+    QString toText() const;
+};
+
+// 按规则精简录制, 直接修改 data
+CompactReport compactRecord(RecordData *data, const CompactOptions &options = CompactOptions());
+
+#endif // RECORDCOMPACTOR_H
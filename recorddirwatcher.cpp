@@ -0,0 +1,107 @@
+#include "recorddirwatcher.h"
+#include "tracer.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+// 文件夹变化后等待的时间 ms, 复制大量文件时只扫描一次
+#define RESCAN_DELAY_MS 200
+
+RecordDirWatcher::RecordDirWatcher(const QStringList &nameFilters, QObject *parent)
+    : QObject(parent)
+    , m_nameFilters(nameFilters)
+{
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(RESCAN_DELAY_MS);
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, &m_debounce, qOverload<>(&QTimer::start));
+    connect(&m_debounce, &QTimer::timeout, this, &RecordDirWatcher::rescan);
+    connect(&m_scan, &QFutureWatcher<ScanResult>::finished, this, &RecordDirWatcher::applyScan);
+}
+
+void RecordDirWatcher::start(const QString &dir){
+    m_dir = QDir(dir).absolutePath();
+    if(!m_watcher.directories().isEmpty()){
+        m_watcher.removePaths(m_watcher.directories());
+    }
+
+    // 第一次扫描时文件夹可能还不存在, 创建后再监视
+    m_pending = false;
+    m_scan.setFuture(QtConcurrent::run(&RecordDirWatcher::scan, m_dir, m_nameFilters, true));
+}
+
+void RecordDirWatcher::rescan(){
+    if(m_dir.isEmpty()){
+        return;
+    }
+    if(m_scan.isRunning()){
+        m_pending = true;
+        return;
+    }
+    m_scan.setFuture(QtConcurrent::run(&RecordDirWatcher::scan, m_dir, m_nameFilters, false));
+}
+
+RecordDirWatcher::ScanResult RecordDirWatcher::scan(const QString &dir, const QStringList &nameFilters, bool create){
+    TraceScope scope("scanRecordDir");
+    QElapsedTimer timer;
+    timer.start();
+
+    ScanResult result;
+    QDir directory(dir);
+    if(create && !directory.exists() && !directory.mkpath(".")){
+        result.errorMsg = QString("存放录制文件的文件夹创建失败: %1").arg(dir);
+        return result;
+    }
+
+    // 只需要文件名, 不读取文件信息
+    result.files = directory.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot, QDir::Unsorted);
+    std::sort(result.files.begin(), result.files.end());
+
+    result.elapsed = timer.nsecsElapsed();
+    scope.setArg(result.files.size());
+    return result;
+}
+
+void RecordDirWatcher::applyScan(){
+    ScanResult result = m_scan.result();
+
+    if(!result.errorMsg.isEmpty()){
+        emit scanFailed(result.errorMsg);
+    }else{
+        if(m_watcher.directories().isEmpty()){
+            m_watcher.addPath(m_dir);
+        }
+
+        // 两个有序列表对比, 得到新增和删除的文件
+        QStringList added, removed;
+        auto oldIt = m_files.cbegin();
+        auto newIt = result.files.cbegin();
+        while(oldIt != m_files.cend() || newIt != result.files.cend()){
+            if(newIt == result.files.cend() || (oldIt != m_files.cend() && *oldIt < *newIt)){
+                removed.append(*oldIt++);
+            }else if(oldIt == m_files.cend() || *newIt < *oldIt){
+                added.append(*newIt++);
+            }else{
+                ++oldIt;
+                ++newIt;
+            }
+        }
+        m_files = result.files;
+
+        if(!removed.isEmpty()){
+            emit filesRemoved(removed);
+        }
+        if(!added.isEmpty()){
+            emit filesAdded(added);
+        }
+        emit scanFinished(m_files.size(), result.elapsed);
+    }
+
+    if(m_pending){
+        m_pending = false;
+        rescan();
+    }
+}
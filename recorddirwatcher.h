@@ -0,0 +1,59 @@
+#ifndef RECORDDIRWATCHER_H
+#define RECORDDIRWATCHER_H
+
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+// 监视存放录制文件的文件夹, 在后台线程中列出文件, 只通知新增和删除的文件名
+// 文件夹变化时由 QFileSystemWatcher 触发, 短时间内的多次变化合并为一次扫描
+class RecordDirWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    // nameFilters 为要列出的文件, 例如 "*.record"
+    explicit RecordDirWatcher(const QStringList &nameFilters, QObject *parent = nullptr);
+
+    // 开始监视 dir, 不存在时在后台创建, 第一次扫描完成后通过 filesAdded 通知所有文件
+    void start(const QString &dir);
+    // 重新扫描一次, 正在扫描时在扫描结束后再扫描
+    void rescan();
+
+    // 上次扫描的结果, 按文件名排序
+    const QStringList &files() const { return m_files; }
+
+signals:
+    // 新增和删除的文件名, 按文件名排序
+    void filesAdded(const QStringList &names);
+    void filesRemoved(const QStringList &names);
+    // 每次扫描结束, elapsed 为后台列出文件的耗时 ns
+    void scanFinished(int fileCount, qint64 elapsed);
+    void scanFailed(const QString &errorMsg);
+
+private:
+    struct ScanResult
+    {
+        QStringList files;
+        QString errorMsg;
+        qint64 elapsed = 0;
+    };
+
+    static ScanResult scan(const QString &dir, const QStringList &nameFilters, bool create);
+    void applyScan();
+
+    QStringList m_nameFilters;
+    QString m_dir;
+    QStringList m_files;
+
+    QFileSystemWatcher m_watcher;
+    QFutureWatcher<ScanResult> m_scan;
+    // 合并短时间内的多次变化
+    QTimer m_debounce;
+    // 扫描期间又有变化
+    bool m_pending = false;
+};
+
+#endif // RECORDDIRWATCHER_H
@@ -0,0 +1,277 @@
+#include "recordeditor.h"
+
+RecordEditor::RecordEditor(const RecordData &data)
+    : m_name(data.name)
+    , m_firstX(data.firstX)
+    , m_firstY(data.firstY)
+{
+    if(!data.actionList.isEmpty()){
+        m_root = makePiece(data.actionList, 0, data.actionList.size(), 0);
+    }
+}
+
+qint64 RecordEditor::size() const{
+    return countOf(m_root);
+}
+
+ActionInfo RecordEditor::at(qint64 index) const{
+    const Node *node = m_root.get();
+    qint64 shift = 0;
+    while(node){
+        shift += node->subtreeShift;
+        qint64 leftCount = countOf(node->left);
+        if(index < leftCount){
+            node = node->left.get();
+        }else if(index < leftCount + node->length){
+            ActionInfo actionInfo = node->buffer[node->start + (index - leftCount)];
+            actionInfo.actionTime += shift + node->pieceShift;
+            return actionInfo;
+        }else{
+            index -= leftCount + node->length;
+            node = node->right.get();
+        }
+    }
+
+    Q_ASSERT_X(false, "RecordEditor::at", "index out of range");
+    return ActionInfo{};
+}
+
+qint64 RecordEditor::duration() const{
+    return isEmpty() ? 0 : at(size() - 1).actionTime;
+}
+
+void RecordEditor::cut(qint64 from, qint64 to, bool closeGap){
+    from = qBound<qint64>(0, from, size());
+    to = qBound<qint64>(from, to, size());
+    if(from == to){
+        return;
+    }
+
+    qint64 shift = closeGap && to < size() ? at(from).actionTime - at(to).actionTime : 0;
+
+    auto [left, rest] = split(m_root, from);
+    auto [removed, right] = split(rest, to - from);
+    commit(merge(left, withShift(right, shift)));
+}
+
+void RecordEditor::insert(qint64 index, const RecordData &source, qint64 from, qint64 to, qint64 gap){
+    if(to < 0){
+        to = source.actionList.size();
+    }
+    from = qBound<qint64>(0, from, source.actionList.size());
+    to = qBound<qint64>(from, to, source.actionList.size());
+    index = qBound<qint64>(0, index, size());
+    if(from == to){
+        return;
+    }
+
+    qint64 prevTime = index > 0 ? at(index - 1).actionTime : 0;
+    qint64 firstTime = source.actionList[from].actionTime;
+    qint64 span = source.actionList[to - 1].actionTime - firstTime;
+
+    NodePtr piece = makePiece(source.actionList, from, to - from, prevTime + gap - firstTime);
+
+    auto [left, right] = split(m_root, index);
+    commit(merge(merge(left, piece), withShift(right, gap + span)));
+}
+
+void RecordEditor::shiftTime(qint64 from, qint64 to, qint64 delta){
+    from = qBound<qint64>(0, from, size());
+    to = qBound<qint64>(from, to, size());
+    if(from == to || delta == 0){
+        return;
+    }
+
+    // 保持操作按时间排序
+    if(delta < 0){
+        qint64 prevTime = from > 0 ? at(from - 1).actionTime : 0;
+        delta = qMax(delta, prevTime - at(from).actionTime);
+    }else if(to < size()){
+        delta = qMin(delta, at(to).actionTime - at(to - 1).actionTime);
+    }
+    if(delta == 0){
+        return;
+    }
+
+    auto [left, rest] = split(m_root, from);
+    auto [middle, right] = split(rest, to - from);
+    commit(merge(merge(left, withShift(middle, delta)), right));
+}
+
+bool RecordEditor::removeKeyPress(qint64 index){
+    if(index < 0 || index >= size()){
+        return false;
+    }
+
+    ActionInfo press = at(index);
+    if(press.actionType == ACTION_MOUSE_MOVE || press.isRelease){
+        return false;
+    }
+
+    // 向后找到对应的松开, 没有松开时只删除按下
+    qint64 releaseIndex = -1;
+    for(qint64 i = index + 1; i < size(); i++){
+        ActionInfo actionInfo = at(i);
+        if(actionInfo.actionType == press.actionType && actionInfo.keyCode == press.keyCode){
+            if(actionInfo.isRelease){
+                releaseIndex = i;
+            }
+            break;
+        }
+    }
+
+    NodePtr root = m_root;
+    if(releaseIndex >= 0){
+        auto [left, rest] = split(root, releaseIndex);
+        root = merge(left, split(rest, 1).second);
+    }
+    auto [left, rest] = split(root, index);
+    commit(merge(left, split(rest, 1).second));
+    return true;
+}
+
+bool RecordEditor::undo(){
+    if(m_undoList.isEmpty()){
+        return false;
+    }
+    m_redoList.append(m_root);
+    m_root = m_undoList.takeLast();
+    return true;
+}
+
+bool RecordEditor::redo(){
+    if(m_redoList.isEmpty()){
+        return false;
+    }
+    m_undoList.append(m_root);
+    m_root = m_redoList.takeLast();
+    return true;
+}
+
+RecordData RecordEditor::toRecordData() const{
+    RecordData data;
+    data.name = m_name;
+    data.firstX = m_firstX;
+    data.firstY = m_firstY;
+    data.actionList.reserve(size());
+    forEach([&data](const ActionInfo &actionInfo){
+        data.actionList.append(actionInfo);
+    });
+    return data;
+}
+
+bool RecordEditor::save(const QString &filePath, QString *errorMsg, RecordFormat format) const{
+    RecordWriter writer;
+    if(!writer.open(filePath, format, m_firstX, m_firstY, errorMsg)){
+        return false;
+    }
+
+    forEach([&writer](const ActionInfo &actionInfo){
+        writer.write(actionInfo);
+    });
+
+    return writer.close(errorMsg);
+}
+
+RecordEditor::NodePtr RecordEditor::makeNode(Node node){
+    node.count = countOf(node.left) + node.length + countOf(node.right);
+    return std::make_shared<const Node>(std::move(node));
+}
+
+RecordEditor::NodePtr RecordEditor::withShift(const NodePtr &node, qint64 shift){
+    if(!node || shift == 0){
+        return node;
+    }
+    Node copy = *node;
+    copy.subtreeShift += shift;
+    return std::make_shared<const Node>(std::move(copy));
+}
+
+// 将子树偏移下传到本片段和子节点, 返回可修改的副本
+RecordEditor::Node RecordEditor::pushDown(const NodePtr &node){
+    Node copy = *node;
+    if(copy.subtreeShift != 0){
+        copy.pieceShift += copy.subtreeShift;
+        copy.left = withShift(copy.left, copy.subtreeShift);
+        copy.right = withShift(copy.right, copy.subtreeShift);
+        copy.subtreeShift = 0;
+    }
+    return copy;
+}
+
+RecordEditor::NodePtr RecordEditor::makePiece(const QList<ActionInfo> &buffer, qsizetype start, qsizetype length, qint64 shift){
+    Node node;
+    node.buffer = buffer;
+    node.start = start;
+    node.length = length;
+    node.pieceShift = shift;
+    node.priority = nextPriority();
+    return makeNode(std::move(node));
+}
+
+// 分为前 count 个操作和其余操作, 位置落在片段中间时将片段一分为二
+std::pair<RecordEditor::NodePtr, RecordEditor::NodePtr> RecordEditor::split(const NodePtr &node, qint64 count){
+    if(!node || count <= 0){
+        return {nullptr, node};
+    }
+    if(count >= node->count){
+        return {node, nullptr};
+    }
+
+    Node copy = pushDown(node);
+    qint64 leftCount = countOf(copy.left);
+
+    if(count <= leftCount){
+        auto [left, right] = split(copy.left, count);
+        copy.left = right;
+        return {left, makeNode(std::move(copy))};
+    }
+
+    if(count >= leftCount + copy.length){
+        auto [left, right] = split(copy.right, count - leftCount - copy.length);
+        copy.right = left;
+        return {makeNode(std::move(copy)), right};
+    }
+
+    // 片段后半部分成为新片段, 与右子树合并
+    qsizetype offset = count - leftCount;
+    NodePtr tail = makePiece(copy.buffer, copy.start + offset, copy.length - offset, copy.pieceShift);
+    NodePtr right = merge(tail, copy.right);
+
+    copy.length = offset;
+    copy.right = nullptr;
+    return {makeNode(std::move(copy)), right};
+}
+
+RecordEditor::NodePtr RecordEditor::merge(const NodePtr &left, const NodePtr &right){
+    if(!left){
+        return right;
+    }
+    if(!right){
+        return left;
+    }
+
+    if(left->priority > right->priority){
+        Node copy = pushDown(left);
+        copy.right = merge(copy.right, right);
+        return makeNode(std::move(copy));
+    }
+
+    Node copy = pushDown(right);
+    copy.left = merge(left, copy.left);
+    return makeNode(std::move(copy));
+}
+
+quint32 RecordEditor::nextPriority(){
+    // xorshift32
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+void RecordEditor::commit(const NodePtr &root){
+    m_undoList.append(m_root);
+    m_redoList.clear();
+    m_root = root;
+}
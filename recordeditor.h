@@ -0,0 +1,122 @@
+#ifndef RECORDEDITOR_H
+#define RECORDEDITOR_H
+
+#include "recordfile.h"
+
+#include <QList>
+#include <QString>
+
+#include <memory>
+#include <utility>
+
+// 编辑已加载的录制, 不复制操作列表
+// 录制由若干片段组成, 每个片段引用某个操作列表中的一段, 并带有时间偏移
+// 片段保存在按位置排列的 treap 中, 剪切、插入、平移时间、删除按键都只修改 O(log n) 个节点
+// 节点创建后不再修改, 每次编辑生成新的根节点并与旧版本共享其余节点, 撤销只需换回旧的根节点
+class RecordEditor
+{
+public:
+    explicit RecordEditor(const RecordData &data);
+
+    const QString &name() const { return m_name; }
+    int firstX() const { return m_firstX; }
+    int firstY() const { return m_firstY; }
+
+    // 操作数
+    qint64 size() const;
+    bool isEmpty() const { return size() == 0; }
+    // 第 index 个操作, 时间已加上偏移
+    ActionInfo at(qint64 index) const;
+    // 最后一个操作的时间 ns
+    qint64 duration() const;
+
+    // 删除 [from, to) 的操作, closeGap 为true时之后的操作提前, 使第 to 个操作落在原第 from 个操作的时间
+    void cut(qint64 from, qint64 to, bool closeGap = true);
+
+    // 在 index 前插入 source 中 [from, to) 的操作(to<0表示到结尾)
+    // 插入的操作从第 index-1 个操作的时间加 gap 开始, 之后的操作整体推后
+    void insert(qint64 index, const RecordData &source, qint64 from = 0, qint64 to = -1, qint64 gap = 0);
+
+    // 将 [from, to) 的操作平移 delta ns, 不越过前后相邻的操作
+    void shiftTime(qint64 from, qint64 to, qint64 delta);
+
+    // 删除第 index 个按下操作和与之对应的松开操作, 不改变其他操作的时间
+    bool removeKeyPress(qint64 index);
+
+    bool canUndo() const { return !m_undoList.isEmpty(); }
+    bool canRedo() const { return !m_redoList.isEmpty(); }
+    bool undo();
+    bool redo();
+
+    // 按顺序访问所有操作, func(const ActionInfo &)
+    template<typename Func>
+    void forEach(Func func) const {
+        visit(m_root.get(), 0, func);
+    }
+
+    // 生成编辑后的录制
+    RecordData toRecordData() const;
+    // 逐个操作写入文件, 不生成完整的操作列表
+    bool save(const QString &filePath, QString *errorMsg = nullptr, RecordFormat format = RECORD_FORMAT_TEXT) const;
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    // 一个片段, 同时是 treap 的节点
+    struct Node
+    {
+        NodePtr left;
+        NodePtr right;
+        QList<ActionInfo> buffer;// 片段所在的操作列表, 与原录制共享数据
+        qsizetype start = 0;// 片段在 buffer 中的起始位置
+        qsizetype length = 0;// 片段的操作数
+        qint64 pieceShift = 0;// 本片段的时间偏移
+        qint64 subtreeShift = 0;// 尚未下传的整个子树的时间偏移
+        qint64 count = 0;// 子树的操作数
+        quint32 priority = 0;
+    };
+
+    template<typename Func>
+    static void visit(const Node *node, qint64 shift, Func &func){
+        if(!node){
+            return;
+        }
+        shift += node->subtreeShift;
+        visit(node->left.get(), shift, func);
+
+        const ActionInfo *actions = node->buffer.constData() + node->start;
+        qint64 pieceShift = shift + node->pieceShift;
+        for(qsizetype i = 0; i < node->length; i++){
+            ActionInfo actionInfo = actions[i];
+            actionInfo.actionTime += pieceShift;
+            func(actionInfo);
+        }
+
+        visit(node->right.get(), shift, func);
+    }
+
+    static qint64 countOf(const NodePtr &node) { return node ? node->count : 0; }
+    static NodePtr makeNode(Node node);
+    static NodePtr withShift(const NodePtr &node, qint64 shift);
+    static Node pushDown(const NodePtr &node);
+
+    NodePtr makePiece(const QList<ActionInfo> &buffer, qsizetype start, qsizetype length, qint64 shift);
+    std::pair<NodePtr, NodePtr> split(const NodePtr &node, qint64 count);
+    NodePtr merge(const NodePtr &left, const NodePtr &right);
+    quint32 nextPriority();
+
+    // 保存当前版本用于撤销, 并切换到新版本
+    void commit(const NodePtr &root);
+
+    QString m_name;
+    int m_firstX = 0;
+    int m_firstY = 0;
+
+    NodePtr m_root;
+    QList<NodePtr> m_undoList;
+    QList<NodePtr> m_redoList;
+    quint32 m_seed = 0x9E3779B9;
+};
+
+#endif // RECORDEDITOR_H
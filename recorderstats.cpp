@@ -0,0 +1,158 @@
+#include "recorderstats.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <chrono>
+
+// 直方图各桶的上限 ns, 最后一个桶没有上限
+static const qint64 BUCKET_LIMITS[RecorderStats::BUCKET_COUNT - 1] = {
+    1000000, 2000000, 4000000, 8000000, 16000000, 32000000, 64000000
+};
+
+void RecorderStats::updateMax(std::atomic<qint64> &target, qint64 val){
+    qint64 current = target.load(std::memory_order_relaxed);
+    while(val > current && !target.compare_exchange_weak(current, val, std::memory_order_relaxed)){
+    }
+}
+
+qint64 RecorderStats::now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RecorderStats::reset(qint64 tickBudget){
+    m_startTime.store(0, std::memory_order_relaxed);
+    m_tickBudget.store(tickBudget, std::memory_order_relaxed);
+    m_tickCount.store(0, std::memory_order_relaxed);
+    m_overBudgetCount.store(0, std::memory_order_relaxed);
+    m_tickPeriodSum.store(0, std::memory_order_relaxed);
+    m_maxTickPeriod.store(0, std::memory_order_relaxed);
+    m_maxTickWork.store(0, std::memory_order_relaxed);
+    for(auto &bucket : m_histogram){
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_idleTickCount.store(0, std::memory_order_relaxed);
+    m_idleTime.store(0, std::memory_order_relaxed);
+    m_cpuTime.store(0, std::memory_order_relaxed);
+    m_rawInputCount.store(0, std::memory_order_relaxed);
+    m_bufferBytes.store(0, std::memory_order_relaxed);
+    m_bufferHighWater.store(0, std::memory_order_relaxed);
+}
+
+void RecorderStats::start(){
+    m_startTime.store(now(), std::memory_order_release);
+}
+
+qint64 RecorderStats::elapsed() const{
+    qint64 startTime = m_startTime.load(std::memory_order_acquire);
+    return startTime ? now() - startTime : 0;
+}
+
+void RecorderStats::addTick(qint64 period, qint64 work){
+    m_tickCount.fetch_add(1, std::memory_order_relaxed);
+    m_tickPeriodSum.fetch_add(period, std::memory_order_relaxed);
+    updateMax(m_maxTickPeriod, period);
+    updateMax(m_maxTickWork, work);
+
+    if(period > m_tickBudget.load(std::memory_order_relaxed)){
+        m_overBudgetCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int bucket = 0;
+    while(bucket < BUCKET_COUNT - 1 && period > BUCKET_LIMITS[bucket]){
+        bucket++;
+    }
+    m_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecorderStats::addIdleTick(qint64 period){
+    m_idleTickCount.fetch_add(1, std::memory_order_relaxed);
+    m_idleTime.fetch_add(period, std::memory_order_relaxed);
+}
+
+void RecorderStats::setCpuTime(qint64 cpuTime){
+    m_cpuTime.store(cpuTime, std::memory_order_relaxed);
+}
+
+void RecorderStats::addRawInputEvent(){
+    m_rawInputCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecorderStats::setBufferBytes(qint64 bytes, qint64 capacityBytes){
+    m_bufferBytes.store(bytes, std::memory_order_relaxed);
+    updateMax(m_bufferHighWater, capacityBytes);
+}
+
+RecorderStats::Snapshot RecorderStats::snapshot(qint64 elapsed) const{
+    Snapshot s;
+    s.elapsed = elapsed;
+    s.tickBudget = m_tickBudget.load(std::memory_order_relaxed);
+    s.tickCount = m_tickCount.load(std::memory_order_relaxed);
+    s.overBudgetCount = m_overBudgetCount.load(std::memory_order_relaxed);
+    s.tickPeriodSum = m_tickPeriodSum.load(std::memory_order_relaxed);
+    s.maxTickPeriod = m_maxTickPeriod.load(std::memory_order_relaxed);
+    s.maxTickWork = m_maxTickWork.load(std::memory_order_relaxed);
+    for(int i = 0; i < BUCKET_COUNT; i++){
+        s.histogram[i] = m_histogram[i].load(std::memory_order_relaxed);
+    }
+    s.idleTickCount = m_idleTickCount.load(std::memory_order_relaxed);
+    s.idleTime = m_idleTime.load(std::memory_order_relaxed);
+    s.cpuTime = m_cpuTime.load(std::memory_order_relaxed);
+    s.rawInputCount = m_rawInputCount.load(std::memory_order_relaxed);
+    s.bufferBytes = m_bufferBytes.load(std::memory_order_relaxed);
+    s.bufferHighWater = m_bufferHighWater.load(std::memory_order_relaxed);
+    return s;
+}
+
+QString RecorderStats::Snapshot::toStatusText() const{
+    return QString("采样 %1 次, 平均 %2ms, 最长 %3ms, 超时 %4 次 | 空闲 %5s | CPU %6ms/分钟 | 鼠标 %7/s | 缓冲 %8KB")
+        .arg(tickCount)
+        .arg(averageTickPeriod() / 1000000.0, 0, 'f', 2)
+        .arg(maxTickPeriod / 1000000.0, 0, 'f', 1)
+        .arg(overBudgetCount)
+        .arg(idleTime / 1e9, 0, 'f', 1)
+        .arg(cpuTimePerMinute() / 1000000.0, 0, 'f', 0)
+        .arg(rawInputRate(), 0, 'f', 0)
+        .arg(bufferBytes / 1024);
+}
+
+QJsonObject RecorderStats::Snapshot::toJson() const{
+    QJsonArray histogramArray;
+    for(int i = 0; i < BUCKET_COUNT; i++){
+        QJsonObject bucket;
+        bucket["le_ms"] = i < BUCKET_COUNT - 1 ? QJsonValue(BUCKET_LIMITS[i] / 1000000.0) : QJsonValue("inf");
+        bucket["count"] = histogram[i];
+        histogramArray.append(bucket);
+    }
+
+    QJsonObject json;
+    json["elapsed_ms"] = elapsed / 1000000.0;
+    json["tick_budget_ms"] = tickBudget / 1000000.0;
+    json["tick_count"] = tickCount;
+    json["ticks_over_budget"] = overBudgetCount;
+    json["tick_period_avg_ms"] = averageTickPeriod() / 1000000.0;
+    json["tick_period_max_ms"] = maxTickPeriod / 1000000.0;
+    json["tick_work_max_ms"] = maxTickWork / 1000000.0;
+    json["tick_period_histogram"] = histogramArray;
+    json["idle_ticks"] = idleTickCount;
+    json["idle_ms"] = idleTime / 1000000.0;
+    json["cpu_ms"] = cpuTime / 1000000.0;
+    json["cpu_ms_per_minute"] = cpuTimePerMinute() / 1000000.0;
+    json["raw_input_events"] = rawInputCount;
+    json["raw_input_rate"] = rawInputRate();
+    json["buffer_bytes"] = bufferBytes;
+    json["buffer_high_water_bytes"] = bufferHighWater;
+    return json;
+}
+
+bool RecorderStats::saveToFile(const QString &filePath, qint64 elapsed) const{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    file.write(QJsonDocument(snapshot(elapsed).toJson()).toJson());
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef RECORDERSTATS_H
+#define RECORDERSTATS_H
+
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+
+// 统计摘要文件的后缀, 与录制文件同名
+#define RECORDER_STATS_SUFFIX ".stats.json"
+
+// 录制过程的健康统计: 采样间隔分布, 超时次数, 空闲降频, 录制线程的CPU时间, 原始输入事件速率, 缓冲区占用
+// 录制线程和原始输入回调写入, 界面线程随时读取, 全部为无锁计数
+class RecorderStats
+{
+public:
+    // 采样间隔直方图的桶数, 上限依次为 1,2,4,8,16,32,64ms 和无穷大
+    static constexpr int BUCKET_COUNT = 8;
+
+    // 一次统计结果
+    struct Snapshot
+    {
+        qint64 elapsed = 0;// 录制时长 ns
+        qint64 tickBudget = 0;// 采样间隔预算 ns
+        qint64 tickCount = 0;// 采样次数
+        qint64 overBudgetCount = 0;// 间隔超出预算的次数, 期间的短按可能丢失
+        qint64 tickPeriodSum = 0;// 采样间隔总和 ns
+        qint64 maxTickPeriod = 0;// 最长采样间隔 ns
+        qint64 maxTickWork = 0;// 单次扫描按键的最长耗时 ns
+        qint64 histogram[BUCKET_COUNT] = {};// 采样间隔分布
+        qint64 idleTickCount = 0;// 空闲降频时的采样次数, 不计入上面的间隔统计
+        qint64 idleTime = 0;// 空闲降频的总时长 ns
+        qint64 cpuTime = 0;// 录制线程的CPU时间 ns
+        qint64 rawInputCount = 0;// 原始输入事件数
+        qint64 bufferBytes = 0;// 当前缓冲的字节数
+        qint64 bufferHighWater = 0;// 缓冲区已分配字节数的最高值
+
+        double averageTickPeriod() const { return tickCount > 0 ? double(tickPeriodSum) / tickCount : 0; }
+        double rawInputRate() const { return elapsed > 0 ? rawInputCount * 1e9 / elapsed : 0; }
+        // 每录制一分钟录制线程占用的CPU时间 ns
+        double cpuTimePerMinute() const { return elapsed > 0 ? cpuTime * 60e9 / elapsed : 0; }
+
+        // 界面上显示的一行状态
+        QString toStatusText() const;
+        QJsonObject toJson() const;
+    };
+
+    // 开始新的录制前调用, tickBudget 为采样间隔预算 ns
+    void reset(qint64 tickBudget);
+    // 录制线程开始计时时调用, 记录开始时间
+    void start();
+    // 从 start() 到现在的时长 ns, 任意线程都可调用, 未开始时为 0
+    qint64 elapsed() const;
+
+    // 记录一次采样, period 为与上次采样开始的间隔, work 为扫描按键的耗时
+    void addTick(qint64 period, qint64 work);
+    // 记录一次空闲降频时的采样, period 为与上次采样开始的间隔
+    void addIdleTick(qint64 period);
+    // 记录录制线程到目前为止的CPU时间 ns
+    void setCpuTime(qint64 cpuTime);
+    // 记录一次原始输入事件
+    void addRawInputEvent();
+    // 记录缓冲区当前字节数和已分配的字节数
+    void setBufferBytes(qint64 bytes, qint64 capacityBytes);
+
+    Snapshot snapshot(qint64 elapsed) const;
+
+    // 保存统计摘要(json)
+    bool saveToFile(const QString &filePath, qint64 elapsed) const;
+
+private:
+    // 录制开始时 steady_clock 的时间 ns, 各线程据此计算录制时长, 不共享计时器对象
+    std::atomic<qint64> m_startTime{0};
+    std::atomic<qint64> m_tickBudget{0};
+    std::atomic<qint64> m_tickCount{0};
+    std::atomic<qint64> m_overBudgetCount{0};
+    std::atomic<qint64> m_tickPeriodSum{0};
+    std::atomic<qint64> m_maxTickPeriod{0};
+    std::atomic<qint64> m_maxTickWork{0};
+    std::atomic<qint64> m_histogram[BUCKET_COUNT] = {};
+    std::atomic<qint64> m_idleTickCount{0};
+    std::atomic<qint64> m_idleTime{0};
+    std::atomic<qint64> m_cpuTime{0};
+    std::atomic<qint64> m_rawInputCount{0};
+    std::atomic<qint64> m_bufferBytes{0};
+    std::atomic<qint64> m_bufferHighWater{0};
+
+    static qint64 now();
+    static void updateMax(std::atomic<qint64> &target, qint64 val);
+};
+
+#endif // RECORDERSTATS_H
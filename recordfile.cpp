@@ -0,0 +1,355 @@
+#include "recordfile.h"
+#include "key_map.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QtEndian>
+
+#include <cstring>
+
+// 二进制格式中一个操作的字节数
+#define BINARY_ACTION_SIZE 20
+
+bool RecordReader::open(const QString &filePath, QString *errorMsg){
+    m_file.setFileName(filePath);
+    // 先以二进制打开, 识别格式后再决定是否按文本读取
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        if(errorMsg){
+            *errorMsg = "无法打开文件:" + filePath;
+        }
+        return false;
+    }
+
+    m_position = 0;
+    m_reason.clear();
+
+    if(m_file.peek(4) == RECORD_BINARY_MAGIC){
+        m_format = RECORD_FORMAT_BINARY;
+
+        QByteArray header = m_file.read(12);
+        if(header.size() != 12){
+            if(errorMsg){
+                *errorMsg = "录制文件的文件头不完整!";
+            }
+            return false;
+        }
+        m_firstX = qFromLittleEndian<qint32>(header.constData() + 4);
+        m_firstY = qFromLittleEndian<qint32>(header.constData() + 8);
+        return true;
+    }
+
+    m_format = RECORD_FORMAT_TEXT;
+    m_file.setTextModeEnabled(true);
+    m_stream.setDevice(&m_file);
+
+    // 读取第一行, 获取初始鼠标位置
+    QString line = m_stream.readLine();
+    m_position = 1;
+    auto itemSplit = line.split(":");
+
+    // 第一行信息错误(包括空文件)
+    if(!line.contains(INITIAL_POS) || itemSplit.size() != 2 || itemSplit[1].split(",").size() != 2){
+        if(errorMsg){
+            *errorMsg = "录制文件的首行信息格式错误!";
+        }
+        return false;
+    }
+
+    auto posList = itemSplit[1].split(",");
+    m_firstX = posList[0].toInt();
+    m_firstY = posList[1].toInt();
+    return true;
+}
+
+RecordReader::Status RecordReader::readNext(ActionInfo *actionInfo){
+    m_reason.clear();
+    return m_format == RECORD_FORMAT_BINARY ? readBinary(actionInfo) : readText(actionInfo);
+}
+
+RecordReader::Status RecordReader::readText(ActionInfo *actionInfo){
+    // 读取一行, 跳过空行
+    QString line;
+    while(line.isEmpty()){
+        if(m_stream.atEnd()){
+            return READ_END;
+        }
+        line = m_stream.readLine();
+        m_position++;
+    }
+
+    // 数据格式示例: "10 mouseMove:0,0"  示例2: "18 A:press"
+    // 取出开头的时间
+    int spaceIndex = line.indexOf(' ');
+    bool ok = false;
+    qint64 actionTime = spaceIndex > 0 ? line.left(spaceIndex).toLongLong(&ok) : 0;
+    if(!ok){
+        m_reason = "格式错误: " + line;
+        return READ_MALFORMED;
+    }
+
+    // 按键操作的信息
+    QString item = line.mid(spaceIndex + 1);
+
+    // 按键名称本身可能是":", 所以从最后一个":"分割
+    int colonIndex = item.lastIndexOf(':');
+    if(colonIndex <= 0){
+        m_reason = "格式错误: " + line;
+        return READ_MALFORMED;
+    }
+
+    // 操作的按键名称
+    QString key = item.left(colonIndex);
+    // 其它信息
+    // 如果key是键盘按键或鼠标按键, action则记录按键按下或者松开, 格式: 键盘按键 key:action 示例 "F:release", 鼠标按键 key:action 示例 "mouseLeft:press"
+    // 如果key是鼠标移动, action则记录移动的量, key:action 示例 "mouseMove:dx,dy"
+    QString action = item.mid(colonIndex + 1);
+    bool isRelease = action == "release";
+
+    // 鼠标移动
+    if(key == MOUSE_MOVE_NAME){
+        auto moveDis = action.split(",");
+        if(moveDis.size() != 2){
+            m_reason = "格式错误: " + line;
+            return READ_MALFORMED;
+        }
+        int dx = moveDis[0].toInt();
+        int dy = moveDis[1].toInt();
+
+        *actionInfo = ActionInfo{actionTime, 0, dx, dy, false, ACTION_MOUSE_MOVE};
+        return READ_ACTION;
+    }
+
+    // 鼠标按键
+    short mouseVK = findMouseButton(key);
+    if(mouseVK >= 0){
+        *actionInfo = ActionInfo{actionTime, mouseVK, 0, 0, isRelease, ACTION_MOUSE_BUTTON};
+        return READ_ACTION;
+    }
+
+    // 键盘按键
+    short scanCode = findScanCode(key);
+    if(scanCode >= 0){
+        *actionInfo = ActionInfo{actionTime, scanCode, 0, 0, isRelease, ACTION_KEYBOARD};
+        return READ_ACTION;
+    }
+
+    m_reason = "未知按键: " + key;
+    return READ_UNKNOWN_KEY;
+}
+
+RecordReader::Status RecordReader::readBinary(ActionInfo *actionInfo){
+    // 操作时间 qint64, 类型 quint8, 是否松开 quint8, 键码 qint16, dx qint32, dy qint32
+    char buffer[BINARY_ACTION_SIZE];
+    qint64 size = m_file.read(buffer, BINARY_ACTION_SIZE);
+    if(size == 0){
+        return READ_END;
+    }
+    m_position++;
+    if(size != BINARY_ACTION_SIZE){
+        m_reason = "录制文件不完整!";
+        return READ_ERROR;
+    }
+
+    qint64 actionTime = qFromLittleEndian<qint64>(buffer);
+    quint8 type = quint8(buffer[8]);
+    bool isRelease = buffer[9] != 0;
+    int keyCode = qFromLittleEndian<qint16>(buffer + 10);
+    int dx = qFromLittleEndian<qint32>(buffer + 12);
+    int dy = qFromLittleEndian<qint32>(buffer + 16);
+
+    switch(type){
+    case ACTION_MOUSE_MOVE:
+        *actionInfo = ActionInfo{actionTime, 0, dx, dy, false, ACTION_MOUSE_MOVE};
+        return READ_ACTION;
+    case ACTION_MOUSE_BUTTON:
+        if(!findMouseButtonByCode(keyCode)){
+            break;
+        }
+        *actionInfo = ActionInfo{actionTime, keyCode, 0, 0, isRelease, ACTION_MOUSE_BUTTON};
+        return READ_ACTION;
+    case ACTION_KEYBOARD:
+        if(!findKeyByScanCode(keyCode)){
+            break;
+        }
+        *actionInfo = ActionInfo{actionTime, keyCode, 0, 0, isRelease, ACTION_KEYBOARD};
+        return READ_ACTION;
+    default:
+        m_reason = QString("未知操作类型: %1").arg(int(type));
+        return READ_MALFORMED;
+    }
+
+    m_reason = QString("未知键码: %1").arg(keyCode);
+    return READ_UNKNOWN_KEY;
+}
+
+bool RecordWriter::open(const QString &filePath, RecordFormat format, int firstX, int firstY, QString *errorMsg){
+    m_file.setFileName(filePath);
+    m_format = format;
+
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    if(format == RECORD_FORMAT_TEXT){
+        mode |= QIODevice::Text;
+    }
+    if (!m_file.open(mode)) {
+        if(errorMsg){
+            *errorMsg = "创建文件失败:" + filePath;
+        }
+        return false;
+    }
+
+    if(format == RECORD_FORMAT_BINARY){
+        char header[12];
+        memcpy(header, RECORD_BINARY_MAGIC, 4);
+        qToLittleEndian<qint32>(firstX, header + 4);
+        qToLittleEndian<qint32>(firstY, header + 8);
+        m_file.write(header, sizeof(header));
+        return true;
+    }
+
+    m_stream.setDevice(&m_file);
+    // 首行记录初始的鼠标位置
+    m_stream << INITIAL_POS << ":" << firstX << "," << firstY << "\n";
+    return true;
+}
+
+void RecordWriter::write(const ActionInfo &actionInfo){
+    if(m_format == RECORD_FORMAT_TEXT){
+        m_stream << formatAction(actionInfo) << "\n";
+        return;
+    }
+
+    char buffer[BINARY_ACTION_SIZE];
+    qToLittleEndian<qint64>(actionInfo.actionTime, buffer);
+    buffer[8] = char(actionInfo.actionType);
+    buffer[9] = actionInfo.isRelease ? 1 : 0;
+    qToLittleEndian<qint16>(actionInfo.keyCode, buffer + 10);
+    qToLittleEndian<qint32>(actionInfo.dx, buffer + 12);
+    qToLittleEndian<qint32>(actionInfo.dy, buffer + 16);
+    m_file.write(buffer, BINARY_ACTION_SIZE);
+}
+
+bool RecordWriter::close(QString *errorMsg){
+    bool ok = true;
+    if(m_format == RECORD_FORMAT_TEXT){
+        m_stream.flush();
+        ok = m_stream.status() == QTextStream::Ok;
+    }
+    ok = m_file.flush() && ok;
+    m_file.close();
+
+    if(!ok && errorMsg){
+        *errorMsg = "写入文件失败:" + m_file.fileName();
+    }
+    return ok;
+}
+
+void RecordWriter::discard(){
+    m_stream.setDevice(nullptr);
+    m_file.remove();
+}
+
+bool parseRecordFormat(const QString &name, RecordFormat *format){
+    if(name == "text"){
+        *format = RECORD_FORMAT_TEXT;
+    }else if(name == "binary"){
+        *format = RECORD_FORMAT_BINARY;
+    }else{
+        return false;
+    }
+    return true;
+}
+
+bool loadRecordFile(const QString &filePath, RecordData *data, QString *errorMsg, const std::atomic<bool> *running){
+    RecordReader reader;
+    if(!reader.open(filePath, errorMsg)){
+        return false;
+    }
+
+    data->name = QFileInfo(filePath).fileName();
+    data->firstX = reader.firstX();
+    data->firstY = reader.firstY();
+    data->actionList.clear();
+
+    // 二进制文件的大小可以直接算出操作数
+    if(reader.format() == RECORD_FORMAT_BINARY){
+        data->actionList.reserve(QFileInfo(filePath).size() / BINARY_ACTION_SIZE);
+    }
+
+    // 读取录制文件到内存, 格式错误和未知按键的行直接跳过
+    ActionInfo actionInfo;
+    while(true){
+        if(running && !running->load(std::memory_order_acquire)){
+            return false;
+        }
+
+        switch(reader.readNext(&actionInfo)){
+        case RecordReader::READ_ACTION:
+            data->actionList.append(actionInfo);
+            break;
+        case RecordReader::READ_MALFORMED:
+        case RecordReader::READ_UNKNOWN_KEY:
+            break;
+        case RecordReader::READ_END:
+            return true;
+        case RecordReader::READ_ERROR:
+            if(errorMsg){
+                *errorMsg = reader.reason();
+            }
+            return false;
+        }
+    }
+}
+
+QString actionName(const ActionInfo &actionInfo){
+    const KeyInfo *key = nullptr;
+    switch(actionInfo.actionType){
+    case ACTION_MOUSE_MOVE:
+        return MOUSE_MOVE_NAME;
+    case ACTION_MOUSE_BUTTON:
+        key = findMouseButtonByCode(actionInfo.keyCode);
+        break;
+    case ACTION_KEYBOARD:
+        key = findKeyByScanCode(actionInfo.keyCode);
+        break;
+    }
+    return key ? QString::fromUtf16(key->name) : QString();
+}
+
+QString formatAction(const ActionInfo &actionInfo){
+    QString line = QString::number(actionInfo.actionTime) + " " + actionName(actionInfo) + ":";
+
+    if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+        line.append(QString::number(actionInfo.dx)).append(",").append(QString::number(actionInfo.dy));
+    }else{
+        line.append(actionInfo.isRelease ? "release" : "press");
+    }
+
+    return line;
+}
+
+bool saveRecordFile(const QString &filePath, const RecordData &data, QString *errorMsg, RecordFormat format){
+    RecordWriter writer;
+    if(!writer.open(filePath, format, data.firstX, data.firstY, errorMsg)){
+        return false;
+    }
+
+    for(const ActionInfo &actionInfo : data.actionList){
+        writer.write(actionInfo);
+    }
+
+    return writer.close(errorMsg);
+}
+
+QString defaultRecordDir(){
+    // 软件本地数据目录
+    QString dataDir = QDir::homePath() + "/AppData/Local/KeyRecorderData/";
+    QDir dir = QDir(QDir::homePath() + "/AppData/Local/");
+
+    // 文件夹创建失败
+    if(!dir.exists("KeyMappingToolData")){
+        return "";
+    }
+    return dataDir;
+}
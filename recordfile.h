@@ -0,0 +1,136 @@
+#ifndef RECORDFILE_H
+#define RECORDFILE_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QTextStream>
+
+#include <atomic>
+#include <type_traits>
+
+#define RECORD_SUFFIX ".record"
+#define INITIAL_POS "initialPos"
+#define MOUSE_MOVE_NAME "mouseMove"
+// 二进制录制文件开头的标识, 文本录制文件总是以 initialPos 开头
+#define RECORD_BINARY_MAGIC "KRB1"
+
+// 录制文件格式, 读取时按文件开头自动识别
+enum RecordFormat
+{
+    RECORD_FORMAT_TEXT,  // 文本, 每行一个操作
+    RECORD_FORMAT_BINARY // 二进制, 每个操作固定 20 字节, 小端序
+};
+
+// 操作类型
+enum ActionType
+{
+    ACTION_KEYBOARD,    // 键盘按键
+    ACTION_MOUSE_BUTTON,// 鼠标按键
+    ACTION_MOUSE_MOVE   // 鼠标移动
+};
+
+struct ActionInfo
+{
+    qint64 actionTime; // 操作时间
+    int keyCode;// 键盘按键的扫描码, 或鼠标按键的虚拟键码
+    int dx;// 鼠标移动的x轴量
+    int dy;// y轴量
+    bool isRelease;// 是否为松开按键
+    ActionType actionType;// 操作类型, 加载时确定, 播放时不再比较按键名称
+};
+
+// 按键名称由 keyCode 查表得到, 操作本身不保存字符串, 可以直接按内存复制
+static_assert(std::is_trivially_copyable<ActionInfo>::value, "ActionInfo 必须是 POD");
+
+// 加载到内存的录制文件
+struct RecordData
+{
+    QString name;// 录制文件名
+    int firstX = 0;// 鼠标初始位置
+    int firstY = 0;
+    QList<ActionInfo> actionList;// 操作列表
+
+    // 录制时长(最后一个操作的时间) ns
+    qint64 duration() const {
+        return actionList.isEmpty() ? 0 : actionList.last().actionTime;
+    }
+};
+
+// 逐个读取录制文件中的操作, 不把整个文件读入内存
+class RecordReader
+{
+public:
+    // 一次读取的结果
+    enum Status
+    {
+        READ_ACTION,     // 读到一个操作
+        READ_MALFORMED,  // 该行格式错误, 已跳过
+        READ_UNKNOWN_KEY,// 未知的按键名称或键码, 已跳过
+        READ_END,        // 文件结束
+        READ_ERROR       // 无法继续读取
+    };
+
+    // 打开文件并读取文件头(初始鼠标位置)
+    bool open(const QString &filePath, QString *errorMsg = nullptr);
+
+    Status readNext(ActionInfo *actionInfo);
+
+    RecordFormat format() const { return m_format; }
+    int firstX() const { return m_firstX; }
+    int firstY() const { return m_firstY; }
+
+    // 上一次读取的位置, 文本为行号, 二进制为操作序号
+    qint64 position() const { return m_position; }
+    // 上一次读取不是 READ_ACTION 时的原因
+    const QString &reason() const { return m_reason; }
+
+private:
+    Status readText(ActionInfo *actionInfo);
+    Status readBinary(ActionInfo *actionInfo);
+
+    QFile m_file;
+    QTextStream m_stream;
+    RecordFormat m_format = RECORD_FORMAT_TEXT;
+    int m_firstX = 0;
+    int m_firstY = 0;
+    qint64 m_position = 0;
+    QString m_reason;
+};
+
+// 逐个写入操作到录制文件
+class RecordWriter
+{
+public:
+    bool open(const QString &filePath, RecordFormat format, int firstX, int firstY, QString *errorMsg = nullptr);
+    void write(const ActionInfo &actionInfo);
+    // 写入剩余数据并关闭文件
+    bool close(QString *errorMsg = nullptr);
+    // 关闭并删除写了一半的文件
+    void discard();
+
+private:
+    QFile m_file;
+    QTextStream m_stream;
+    RecordFormat m_format = RECORD_FORMAT_TEXT;
+};
+
+// 格式名称 "text"/"binary" 转为格式
+bool parseRecordFormat(const QString &name, RecordFormat *format);
+
+// 保存录制文件的文件夹, 以 "/" 结尾, 为空时使用当前文件夹
+QString defaultRecordDir();
+
+// 读取录制文件到内存, running 不为空时, 其值变为false则中止读取
+bool loadRecordFile(const QString &filePath, RecordData *data, QString *errorMsg = nullptr, const std::atomic<bool> *running = nullptr);
+
+// 操作的按键名称, 鼠标移动为 "mouseMove"
+QString actionName(const ActionInfo &actionInfo);
+
+// 一个操作在录制文件中的文本, 不含换行, 格式示例: "10 mouseMove:0,0", "18 A:press"
+QString formatAction(const ActionInfo &actionInfo);
+
+// 将录制保存为录制文件
+bool saveRecordFile(const QString &filePath, const RecordData &data, QString *errorMsg = nullptr, RecordFormat format = RECORD_FORMAT_TEXT);
+
+#endif // RECORDFILE_H
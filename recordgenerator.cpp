@@ -0,0 +1,189 @@
+#include "recordgenerator.h"
+#include "key_map.h"
+
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// 随机数, 只使用 mt19937_64 的原始输出, 分布自行实现
+// 标准库的分布在不同编译器上结果不同, 会导致同一种子生成不同的录制
+// log/exp/cos/sin 在不同的数学库上舍入可能不同, 因此只保证同一构建和平台上结果相同
+class GeneratorRandom
+{
+public:
+    explicit GeneratorRandom(quint64 seed) : m_engine(seed) {}
+
+    // [0, 1)
+    double uniform(){
+        return (m_engine() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // [0, count)
+    int index(int count){
+        return int(uniform() * count);
+    }
+
+    // 指数分布, 用于泊松过程的间隔
+    double exponential(double mean){
+        return -std::log(1.0 - uniform()) * mean;
+    }
+
+    // 标准正态分布, Box-Muller
+    double normal(){
+        double u1 = 1.0 - uniform();
+        double u2 = uniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    }
+
+    // 对数正态分布, median 为中位数
+    double logNormal(double median, double spread){
+        return median * std::exp(spread * normal());
+    }
+
+private:
+    std::mt19937_64 m_engine;
+};
+
+// 正在按住的按键
+struct HeldKey
+{
+    int code;
+    qint64 releaseTime;
+};
+
+static ActionInfo makeButton(qint64 time, int code, bool isRelease, ActionType type){
+    return ActionInfo{time, code, 0, 0, isRelease, type};
+}
+
+// 以泊松过程生成按键, 每次按下时同时生成对应的松开
+static void generateKeys(GeneratorRandom &random, const GeneratorOptions &options, double rate, int maxHeld,
+                         const QList<int> &codes, ActionType type, QList<ActionInfo> *actions){
+    if(rate <= 0 || codes.isEmpty() || maxHeld <= 0){
+        return;
+    }
+
+    const double meanInterval = 1e9 / rate;
+    QVarLengthArray<HeldKey, 16> held;
+
+    double time = random.exponential(meanInterval);
+    while(time < options.duration){
+        qint64 now = qint64(time);
+        time += random.exponential(meanInterval);
+
+        // 去掉已经松开的按键
+        for(int i = held.size() - 1; i >= 0; i--){
+            if(held[i].releaseTime <= now){
+                held.remove(i);
+            }
+        }
+        if(held.size() >= maxHeld || held.size() >= codes.size()){
+            continue;
+        }
+
+        // 选一个没有按住的按键
+        int code;
+        bool isHeld;
+        do{
+            code = codes[random.index(codes.size())];
+            isHeld = std::any_of(held.begin(), held.end(), [code](const HeldKey &key){ return key.code == code; });
+        }while(isHeld);
+
+        qint64 hold = qMax<qint64>(1000000, qint64(random.logNormal(options.holdMean, options.holdSpread) * 1000000));
+        qint64 releaseTime = qMin(now + hold, options.duration);
+        held.append(HeldKey{code, releaseTime});
+
+        // 松开先于同一按键之后的按下加入, 时间相同时排序后仍在前面
+        actions->append(makeButton(now, code, false, type));
+        actions->append(makeButton(releaseTime, code, true, type));
+    }
+}
+
+// 鼠标在移动和静止之间交替, 移动时按回报率产生事件
+static void generateMouseMoves(GeneratorRandom &random, const GeneratorOptions &options, QList<ActionInfo> *actions){
+    double ratio = options.mouseActiveRatio;
+    if(ratio <= 0 || options.mouseRate <= 0 || options.mouseSpeed <= 0){
+        return;
+    }
+
+    // 移动段和静止段的平均时长, 两者平均为 burstMean
+    const double activeMean = options.burstMean * 1000000 * 2 * qMin(ratio, 1.0);
+    const double idleMean = options.burstMean * 1000000 * 2 * qMax(1.0 - ratio, 0.0);
+    const double period = 1e9 / options.mouseRate;
+
+    double time = idleMean > 0 ? random.exponential(idleMean) : 0;
+    while(time < options.duration){
+        const double segmentStart = time;
+        double segmentEnd = qMin<double>(time + random.exponential(activeMean), options.duration);
+
+        // 每段有自己的速度, 方向缓慢变化
+        double speed = random.logNormal(options.mouseSpeed, 0.5) / options.mouseRate;
+        double angle = random.uniform() * 6.283185307179586;
+        double restX = 0, restY = 0;
+
+        for(; time < segmentEnd; time += period){
+            angle += random.normal() * 0.05;
+            restX += speed * std::cos(angle);
+            restY += speed * std::sin(angle);
+
+            // 和真实录制一样, 只记录移动了整数像素的回报
+            int dx = int(std::lround(restX));
+            int dy = int(std::lround(restY));
+            if(dx == 0 && dy == 0){
+                continue;
+            }
+            restX -= dx;
+            restY -= dy;
+
+            actions->append(ActionInfo{qint64(time), 0, dx, dy, false, ACTION_MOUSE_MOVE});
+        }
+
+        if(idleMean > 0){
+            time = segmentEnd + random.exponential(idleMean);
+        }
+        // 移动段和静止段的时长都为 0 时时间不会前进, 每段至少前进一个回报间隔
+        time = qMax(time, segmentStart + period);
+    }
+}
+
+RecordData generateRecord(const GeneratorOptions &options){
+    RecordData data;
+    data.name = QString("generated-%1.record").arg(options.seed);
+
+    GeneratorRandom random(options.seed);
+    data.firstX = random.index(1920);
+    data.firstY = random.index(1080);
+
+    // 录制/播放快捷键不会出现在录制中
+    QList<int> keyCodes;
+    for(int i = 0; i < KEYBOARD_KEY_COUNT; i++){
+        if(KEYBOARD_KEYS[i].code != 0x41 && KEYBOARD_KEYS[i].code != 0x42){
+            keyCodes.append(KEYBOARD_KEYS[i].code);
+        }
+    }
+    QList<int> buttonCodes;
+    for(int i = 0; i < MOUSE_BUTTON_COUNT; i++){
+        buttonCodes.append(MOUSE_BUTTONS[i].code);
+    }
+
+    // 预估事件数, 避免生成大录制时反复扩容
+    double seconds = options.duration / 1e9;
+    double estimate = seconds * (2 * options.keyRate + 2 * options.mouseButtonRate
+                                 + qBound(0.0, options.mouseActiveRatio, 1.0) * qMin(options.mouseRate, options.mouseSpeed * 2));
+    data.actionList.reserve(qsizetype(qMin(estimate * 1.1, 1e9)));
+
+    // 每类事件使用各自的随机序列, 修改一类参数不影响其他事件
+    GeneratorRandom keyRandom(options.seed ^ 0x6B6579ULL);
+    GeneratorRandom buttonRandom(options.seed ^ 0x627574ULL);
+    GeneratorRandom mouseRandom(options.seed ^ 0x6D6F76ULL);
+    generateKeys(keyRandom, options, options.keyRate, options.maxRollover, keyCodes, ACTION_KEYBOARD, &data.actionList);
+    generateKeys(buttonRandom, options, options.mouseButtonRate, buttonCodes.size(), buttonCodes, ACTION_MOUSE_BUTTON, &data.actionList);
+    generateMouseMoves(mouseRandom, options, &data.actionList);
+
+    std::stable_sort(data.actionList.begin(), data.actionList.end(), [](const ActionInfo &a, const ActionInfo &b){
+        return a.actionTime < b.actionTime;
+    });
+
+    return data;
+}
@@ -0,0 +1,28 @@
+#ifndef RECORDGENERATOR_H
+#define RECORDGENERATOR_H
+
+#include "recordfile.h"
+
+// 生成录制的参数, 同一构建下相同参数和种子总是生成相同的录制
+struct GeneratorOptions
+{
+    quint64 seed = 1;// 随机种子
+    qint64 duration = 60000000000;// 录制时长 ns
+
+    double keyRate = 5;// 平均每秒按下键盘按键的次数
+    double holdMean = 80;// 按键按住时长的中位数 ms, 对数正态分布
+    double holdSpread = 0.6;// 按住时长对数的标准差, 越大长按越多
+    int maxRollover = 4;// 同时按住的最多键盘按键数
+
+    double mouseButtonRate = 0.5;// 平均每秒按下鼠标按键的次数
+
+    double mouseRate = 1000;// 鼠标移动时的回报率 Hz, 例如 8000 为8kHz鼠标
+    double mouseSpeed = 600;// 鼠标移动时的平均速度 像素/秒
+    double mouseActiveRatio = 0.5;// 鼠标处于移动状态的时间比例
+    double burstMean = 400;// 每段连续移动或静止的平均时长 ms, 越大越集中
+};
+
+// 按参数生成一个录制
+RecordData generateRecord(const GeneratorOptions &options);
+
+#endif // RECORDGENERATOR_H
@@ -0,0 +1,181 @@
+#include "recordpipeline.h"
+#include "tracer.h"
+
+#include <QFileInfo>
+#include <QThread>
+
+// 加载线程一次放入队列、播放线程一次取出的最多操作数
+#define PIPELINE_CHUNK 256
+// 等待对方时检查是否停止的间隔 ms
+#define PIPELINE_POLL_MS 10
+
+RecordPipeline::RecordPipeline(int capacity)
+    : m_queue(qMax(PIPELINE_CHUNK, capacity))
+{
+    m_batch.reserve(PIPELINE_CHUNK);
+}
+
+RecordPipeline::~RecordPipeline(){
+    if(m_thread){
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopped = true;
+            m_notFull.wakeAll();
+        }
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+bool RecordPipeline::start(const QString &filePath, const std::atomic<bool> *running, QString *errorMsg){
+    m_timer.start();
+    if(!m_reader.open(filePath, errorMsg)){
+        return false;
+    }
+
+    m_running = running;
+    m_header.name = QFileInfo(filePath).fileName();
+    m_header.firstX = m_reader.firstX();
+    m_header.firstY = m_reader.firstY();
+
+    m_data.reset(new RecordData(m_header));
+
+    m_thread = QThread::create([this]{ load(); });
+    m_thread->start();
+    return true;
+}
+
+void RecordPipeline::load(){
+    Tracer::setThreadName("loader");
+
+    std::vector<ActionInfo> chunk;
+    chunk.reserve(PIPELINE_CHUNK);
+    bool end = false;
+    bool failed = false;
+    QString errorMsg;
+
+    while(!end){
+        // 读取一批操作, 格式错误和未知按键的行直接跳过
+        {
+            TraceScope scope("parse");
+            ActionInfo actionInfo;
+            while(!end && chunk.size() < PIPELINE_CHUNK){
+                switch(m_reader.readNext(&actionInfo)){
+                case RecordReader::READ_ACTION:
+                    chunk.push_back(actionInfo);
+                    m_data->actionList.append(actionInfo);
+                    break;
+                case RecordReader::READ_MALFORMED:
+                case RecordReader::READ_UNKNOWN_KEY:
+                    break;
+                case RecordReader::READ_END:
+                    end = true;
+                    break;
+                case RecordReader::READ_ERROR:
+                    end = failed = true;
+                    errorMsg = m_reader.reason();
+                    break;
+                }
+            }
+        }
+
+        // 放入队列, 队列满时等待播放线程取出
+        QMutexLocker locker(&m_mutex);
+        size_t pos = 0;
+        while(pos < chunk.size()){
+            if(m_stopped || !isRunning()){
+                m_failed = true;
+                m_notEmpty.wakeAll();
+                return;
+            }
+
+            qint64 space = qint64(m_queue.size()) - (m_tail - m_head);
+            if(space == 0){
+                m_notFull.wait(&m_mutex, PIPELINE_POLL_MS);
+                continue;
+            }
+
+            size_t count = qMin<size_t>(space, chunk.size() - pos);
+            for(size_t i = 0; i < count; i++){
+                m_queue[(m_tail + i) % m_queue.size()] = chunk[pos + i];
+            }
+            m_tail += count;
+            pos += count;
+            m_lastTime = m_queue[(m_tail - 1) % m_queue.size()].actionTime;
+            m_notEmpty.wakeAll();
+        }
+        chunk.clear();
+
+        if(end){
+            m_finished = true;
+            m_failed = failed;
+            m_errorMsg = errorMsg;
+            m_notEmpty.wakeAll();
+        }
+    }
+}
+
+bool RecordPipeline::waitLead(qint64 leadTime){
+    QMutexLocker locker(&m_mutex);
+    while(m_lastTime < leadTime && m_tail - m_head < qint64(m_queue.size()) && !m_finished && !m_failed){
+        if(!isRunning()){
+            return false;
+        }
+        m_notEmpty.wait(&m_mutex, PIPELINE_POLL_MS);
+    }
+
+    m_leadWaitTime = m_timer.nsecsElapsed();
+    return !m_failed && isRunning();
+}
+
+bool RecordPipeline::next(ActionInfo *actionInfo){
+    if(m_batchPos < m_batch.size()){
+        *actionInfo = m_batch[m_batchPos++];
+        return true;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if(m_head == m_tail && !m_finished && !m_failed){
+        // 播放追上了加载
+        m_underruns++;
+        TraceScope scope("pipelineWait");
+        while(m_head == m_tail && !m_finished && !m_failed){
+            if(!isRunning()){
+                return false;
+            }
+            m_notEmpty.wait(&m_mutex, PIPELINE_POLL_MS);
+        }
+    }
+
+    if(m_head == m_tail){
+        return false;
+    }
+
+    size_t count = size_t(qMin<qint64>(PIPELINE_CHUNK, m_tail - m_head));
+    m_batch.clear();
+    for(size_t i = 0; i < count; i++){
+        m_batch.push_back(m_queue[(m_head + i) % m_queue.size()]);
+    }
+    m_head += count;
+    m_notFull.wakeAll();
+
+    m_batchPos = 1;
+    *actionInfo = m_batch[0];
+    return true;
+}
+
+QSharedPointer<RecordData> RecordPipeline::waitFinished(QString *errorMsg){
+    if(!m_thread){
+        return QSharedPointer<RecordData>();
+    }
+    m_thread->wait();
+
+    QMutexLocker locker(&m_mutex);
+    if(m_failed || !m_finished){
+        if(errorMsg){
+            *errorMsg = m_errorMsg;
+        }
+        return QSharedPointer<RecordData>();
+    }
+    return m_data;
+}
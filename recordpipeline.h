@@ -0,0 +1,80 @@
+#ifndef RECORDPIPELINE_H
+#define RECORDPIPELINE_H
+
+#include "recordfile.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <vector>
+
+class QThread;
+
+// 加载线程最多领先播放的操作数
+#define PIPELINE_CAPACITY 8192
+// 开始播放前预先读取的录制时长 ms
+#define PIPELINE_LEAD_MS 200
+
+// 边加载边播放: 加载线程读取录制文件放入有界队列, 播放线程从队列头部取出
+// 开始播放只需要等待读取开头 leadTime 的操作, 与文件大小无关
+// 加载线程领先播放不超过队列容量; 读到的操作同时保存为完整的录制, 之后的轮次直接按它播放
+class RecordPipeline
+{
+public:
+    explicit RecordPipeline(int capacity = PIPELINE_CAPACITY);
+    // 停止并等待加载线程结束
+    ~RecordPipeline();
+
+    // 打开文件并在后台线程中开始读取, running 变为false时停止读取, 同时 waitLead 和 next 返回false
+    bool start(const QString &filePath, const std::atomic<bool> *running, QString *errorMsg = nullptr);
+
+    // 只有文件头(初始鼠标位置)的录制, 打开后即可用
+    const RecordData &header() const { return m_header; }
+
+    // 等待读取到时间不早于 leadTime(ns) 的操作、队列已满或文件结束, 返回false表示读取出错或已停止
+    bool waitLead(qint64 leadTime);
+    // 按顺序取出下一个操作, 队列为空时等待加载线程, 读完、出错或停止时返回false
+    bool next(ActionInfo *actionInfo);
+
+    // 等待读取完成, 返回完整的录制, 出错或停止时返回空
+    QSharedPointer<RecordData> waitFinished(QString *errorMsg = nullptr);
+
+    // 开始读取到可以开始播放的耗时, 以及播放时队列为空而等待加载线程的次数
+    qint64 leadWaitTime() const { return m_leadWaitTime; }
+    qint64 underruns() const { return m_underruns; }
+
+private:
+    void load();
+    bool isRunning() const { return !m_running || m_running->load(std::memory_order_acquire); }
+
+    RecordReader m_reader;
+    RecordData m_header;
+    QSharedPointer<RecordData> m_data;// 读取完成前只在加载线程中访问
+    const std::atomic<bool> *m_running = nullptr;
+    QThread *m_thread = nullptr;
+    QElapsedTimer m_timer;
+
+    // 加载线程和播放线程共用的队列
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    std::vector<ActionInfo> m_queue;
+    qint64 m_head = 0;// 已取出的操作数
+    qint64 m_tail = 0;// 已放入的操作数
+    qint64 m_lastTime = -1;// 最后放入的操作时间
+    bool m_finished = false;
+    bool m_failed = false;
+    bool m_stopped = false;// 析构时停止读取
+    QString m_errorMsg;
+
+    // 以下只在播放线程中访问: 一次从队列取出多个操作, 减少加锁
+    std::vector<ActionInfo> m_batch;
+    size_t m_batchPos = 0;
+    qint64 m_leadWaitTime = 0;
+    qint64 m_underruns = 0;
+};
+
+#endif // RECORDPIPELINE_H
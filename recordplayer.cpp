@@ -0,0 +1,273 @@
+#include "recordplayer.h"
+#include "tracer.h"
+
+#include <QVarLengthArray>
+
+RecordPlayer::RecordPlayer(InputEmitter *emitter, const std::atomic<bool> *running)
+    : m_emitter(emitter)
+    , m_running(running)
+{
+}
+
+void RecordPlayer::prepareLoop(const RecordData &data){
+    // 移动鼠标到初始位置(绝对坐标)
+    if(m_moveToInitialPos){
+        // 线性移动鼠标到指定坐标
+        moveMouseToPos(data.firstX, data.firstY);
+    }
+
+    // 恢复游戏视角为初始视角
+    if(m_restoreView){
+        // 线性移动鼠标, 相对移动
+        moveMouseDxDy(-m_moveX, -m_moveY);
+    }
+
+    // 重置播放过程中鼠标 x,y的移动量
+    m_moveX = 0, m_moveY = 0;
+}
+
+void RecordPlayer::setTimingProfile(const TimingProfile &profile){
+    m_spinMargin = profile.spinMargin();
+    m_leadTime = profile.backend == m_emitter->backendName() ? profile.leadTime() : 0;
+}
+
+bool RecordPlayer::playOnce(const RecordData &data, qint64 startTime){
+    if(m_transform){
+        m_transform->reset();
+    }
+
+    for(ActionInfo actionInfo : data.actionList){
+        if(!playAction(actionInfo, startTime)){
+            return false;
+        }
+    }
+
+    return finishLoop();
+}
+
+bool RecordPlayer::playPipeline(RecordPipeline *pipeline, qint64 startTime){
+    if(m_transform){
+        m_transform->reset();
+    }
+
+    ActionInfo actionInfo;
+    while(pipeline->next(&actionInfo)){
+        if(!playAction(actionInfo, startTime)){
+            return false;
+        }
+    }
+
+    return finishLoop();
+}
+
+bool RecordPlayer::playMacro(const MacroProgram &program, qint64 startTime, qint64 *endTime){
+    if(m_transform){
+        m_transform->reset();
+    }
+
+    // 每层循环剩余的次数和本次循环开始的时间
+    QVarLengthArray<int, 8> counters;
+    QVarLengthArray<qint64, 8> loopStarts;
+    // 当前指令在时间轴上的开始时间
+    qint64 time = startTime;
+
+    for(int ip = 0; ; ){
+        const MacroInstruction &instruction = program.code[ip++];
+        switch(instruction.opcode){
+        case MACRO_PLAY:{
+            const RecordData &segment = *program.segments[instruction.operand];
+            for(ActionInfo actionInfo : segment.actionList){
+                if(!playAction(actionInfo, time)){
+                    return false;
+                }
+            }
+            time += loopDuration(segment);
+            break;
+        }
+        case MACRO_WAIT:
+            time += instruction.value;
+            break;
+        case MACRO_REPEAT:
+            counters.append(instruction.operand);
+            loopStarts.append(time);
+            break;
+        case MACRO_NEXT:
+            // 循环体中可能没有需要等待的操作, 每次循环都检查是否停止
+            if(!isRunning()){
+                return false;
+            }
+            if(counters.last() <= 0){
+                // 一直循环时每次循环至少前进 MACRO_MIN_FOREVER_PERIOD, 并等待到该时间
+                if(time < loopStarts.last() + MACRO_MIN_FOREVER_PERIOD){
+                    time = loopStarts.last() + MACRO_MIN_FOREVER_PERIOD;
+                    if(!waitUntil(time)){
+                        return false;
+                    }
+                }
+                loopStarts.last() = time;
+                ip = instruction.operand;
+            }else if(--counters.last() > 0){
+                ip = instruction.operand;
+            }else{
+                counters.removeLast();
+                loopStarts.removeLast();
+            }
+            break;
+        case MACRO_END:
+            if(endTime){
+                *endTime = time;
+            }
+            return finishLoop();
+        }
+    }
+}
+
+bool RecordPlayer::playAction(ActionInfo &actionInfo, qint64 startTime){
+    // 变换后丢弃的操作
+    if(m_transform && !m_transform->apply(actionInfo)){
+        return true;
+    }
+
+    // 还没到操作时间
+    qint64 deadline = startTime + actionInfo.actionTime;
+    if(!waitToEmit(deadline)){
+        return false;
+    }
+
+    qint64 lateness = this->lateness(deadline);
+    if(m_stats){
+        m_stats->addEmit(lateness);
+    }
+
+    // 预定时间到实际发送之间的延迟, 以及发送本身的耗时
+    qint64 emitStart = Tracer::isEnabled() ? Tracer::now() : 0;
+
+    switch(actionInfo.actionType){
+    // 鼠标移动
+    case ACTION_MOUSE_MOVE:
+        // 记录播放过程中鼠标 x,y的移动量, 用于恢复游戏视角
+        m_moveX += actionInfo.dx;
+        m_moveY += actionInfo.dy;
+
+        // 模拟鼠标移动
+        m_emitter->simulateMouseRelativeMove(actionInfo.dx, actionInfo.dy);
+        break;
+    case ACTION_MOUSE_BUTTON:
+        // 模拟鼠标按键
+        m_emitter->simulateMouseAction(actionInfo.keyCode, actionInfo.isRelease);
+        break;
+    case ACTION_KEYBOARD:
+        // 模拟键盘按键
+        m_emitter->simulateKeyPress(actionInfo.keyCode, actionInfo.isRelease);
+        break;
+    }
+
+    if(emitStart){
+        Tracer::complete("late", emitStart - qMax<qint64>(0, lateness), emitStart, "deadline_ns", deadline);
+        Tracer::complete("emit", emitStart, Tracer::now(), "type", actionInfo.actionType, "code", actionInfo.keyCode);
+    }
+    return true;
+}
+
+bool RecordPlayer::finishLoop(){
+    // 本轮结束, 松开录制中未松开的按键, 避免带入下一轮
+    m_emitter->releaseHeldKeys();
+
+    if(m_stats){
+        m_stats->addLoop();
+    }
+
+    return isRunning();
+}
+
+void RecordPlayer::moveMouseToPos(int targetX, int targetY){
+    TraceScope scope("moveMouseToPos");
+
+    // 将当前鼠标 线性移动到 targetX,targetY
+    while(isRunning()){
+        int dx = 0, dy = 0;
+        // 获取鼠标的屏幕坐标（物理位置）
+        int cursorX, cursorY;
+        if (m_emitter->getCursorPos(&cursorX, &cursorY)) {
+            if(targetX > cursorX){
+                dx = (cursorX + 10) > targetX ? targetX : (cursorX + 10);
+            }else{
+                dx = (cursorX - 10) < targetX ? targetX : (cursorX - 10);
+            }
+
+            if(targetY > cursorY){
+                dy = (cursorY + 10) > targetY ? targetY : (cursorY + 10);
+            }else{
+                dy = (cursorY - 10) < targetY ? targetY : (cursorY - 10);
+            }
+
+            // 模拟鼠标移动
+            m_emitter->simulateMouseAbsolutelyMove(dx, dy);
+            m_emitter->flush();
+
+            // 已到达目标位置
+            if(dx == targetX && dy == targetY){
+                break;
+            }
+        }
+
+        m_clock->sleep(15);
+    }
+}
+
+void RecordPlayer::moveMouseDxDy(int dx, int dy){
+    TraceScope scope("moveMouseDxDy");
+
+    // 每次移动的步长
+    int stepLen = 8;
+
+    // 将当前鼠标线性相对移动 dx, dy
+    while(isRunning()){
+        if(dx == 0 && dy == 0){
+            break;
+        }
+
+        int mX = 0, mY = 0;
+
+        if(dx < 0){
+            if(dx + stepLen < 0){
+                mX = -stepLen;
+                dx += stepLen;
+            }else{
+                mX = dx;
+                dx = 0;
+            }
+        }else{
+            if(dx - stepLen > 0){
+                mX = stepLen;
+                dx -= stepLen;
+            }else{
+                mX = dx;
+                dx = 0;
+            }
+        }
+
+        if(dy < 0){
+            if(dy + stepLen < 0){
+                mY = -stepLen;
+                dy += stepLen;
+            }else{
+                mY = dy;
+                dy = 0;
+            }
+        }else{
+            if(dy - stepLen > 0){
+                mY = stepLen;
+                dy -= stepLen;
+            }else{
+                mY = dy;
+                dy = 0;
+            }
+        }
+
+        m_emitter->simulateMouseRelativeMove(mX, mY);
+        m_emitter->flush();
+
+        m_clock->sleep(5);
+    }
+}
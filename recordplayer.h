@@ -0,0 +1,112 @@
+#ifndef RECORDPLAYER_H
+#define RECORDPLAYER_H
+
+#include "recordfile.h"
+#include "actiontransform.h"
+#include "inputemitter.h"
+#include "macroprogram.h"
+#include "playbackclock.h"
+#include "playbackstats.h"
+#include "recordpipeline.h"
+#include "timingprofile.h"
+
+#include <atomic>
+#include <limits>
+
+// 在一条时间轴上播放已加载的录制
+class RecordPlayer
+{
+public:
+    // running 变为false时停止播放
+    RecordPlayer(InputEmitter *emitter, const std::atomic<bool> *running);
+
+    // 每轮播放前将鼠标移动到录制时初始位置
+    void setMoveToInitialPos(bool val) { m_moveToInitialPos = val; }
+    // 下一轮播放前将游戏视角恢复到第一轮的初始视角
+    void setRestoreView(bool val) { m_restoreView = val; }
+
+    // 播放统计, 为空时不统计
+    void setStats(PlaybackStats *stats) { m_stats = stats; }
+    PlaybackStats *stats() const { return m_stats; }
+
+    InputEmitter *emitter() const { return m_emitter; }
+
+    // 播放的时间轴, 默认为实际时间; 使用虚拟时钟时不等待, 立即播放完
+    // 循环播放、播放列表和多轨播放都使用播放器的时间轴
+    void setClock(PlaybackClock *clock) { m_clock = clock ? clock : &m_systemClock; }
+    PlaybackClock *clock() const { return m_clock; }
+
+    // 发送前对每个操作做的变换, 为空时按录制原样播放
+    void setTransform(ActionTransform *transform) { m_transform = transform; }
+    ActionTransform *transform() const { return m_transform; }
+    // 变换后一轮的时长 ns
+    qint64 loopDuration(const RecordData &data) const{
+        return m_transform ? m_transform->duration(data.duration()) : data.duration();
+    }
+
+    // 使用本机的计时校准: 距离预定时间少于自旋余量时改为自旋等待
+    // 校准使用的后端与当前后端相同时, 提前发送延迟的时间
+    void setTimingProfile(const TimingProfile &profile);
+
+    // 每轮播放前的复位动作: 移动鼠标到初始位置或恢复视角
+    void prepareLoop(const RecordData &data);
+
+    // 从时间轴上的 startTime(ns) 开始播放一轮, 返回false表示播放被停止
+    bool playOnce(const RecordData &data, qint64 startTime);
+    // 从 startTime(ns) 开始边加载边播放一轮, 按顺序从 pipeline 取出操作直到读完
+    bool playPipeline(RecordPipeline *pipeline, qint64 startTime);
+    // 从 startTime(ns) 开始解释执行一遍宏程序, endTime 为程序结束的时间(含最后的等待)
+    bool playMacro(const MacroProgram &program, qint64 startTime, qint64 *endTime = nullptr);
+
+    // 等待时间轴到达 time(ns), 返回false表示播放被停止
+    // 需要等待或等待的时间改变时先送出排队中的操作, 同一时刻到期的操作一起送出
+    // 落后于时间轴时不需要等待, 每个已到期的时刻也立即送出, 不留在缓冲区中等到下一次等待
+    bool waitUntil(qint64 time){
+        if(time != m_batchTime || time > m_clock->nsecsElapsed()){
+            m_emitter->flush();
+            m_batchTime = time;
+        }
+        return m_clock->waitUntil(time, m_spinMargin, m_running);
+    }
+    // 等待到发送预定时间为 deadline(ns) 的操作的时间, 提前发送延迟的时间
+    bool waitToEmit(qint64 deadline) { return waitUntil(deadline - m_leadTime); }
+    // 操作预计到达系统的时间与预定时间之差
+    qint64 lateness(qint64 deadline) const { return m_clock->nsecsElapsed() + m_leadTime - deadline; }
+
+    // 线性移动鼠标到指定位置(绝对移动)
+    void moveMouseToPos(int targetX, int targetY);
+
+    // 线性移动鼠标(相对移动)
+    void moveMouseDxDy(int dx, int dy);
+
+private:
+    InputEmitter *m_emitter;
+    const std::atomic<bool> *m_running;
+    PlaybackStats *m_stats = nullptr;
+    ActionTransform *m_transform = nullptr;
+    SystemClock m_systemClock;
+    PlaybackClock *m_clock = &m_systemClock;
+
+    // 排队中的操作的预定时间, 下一次等待的时间不同时先送出
+    qint64 m_batchTime = std::numeric_limits<qint64>::min();
+
+    // 计时校准, 默认只睡眠不自旋, 不提前发送
+    qint64 m_spinMargin = 0;
+    qint64 m_leadTime = 0;
+
+    bool m_moveToInitialPos = false;
+    bool m_restoreView = false;
+
+    // 记录播放过程中鼠标 x,y的移动量, 用于恢复游戏视角
+    int m_moveX = 0;
+    int m_moveY = 0;
+
+    bool isRunning() const { return m_running->load(std::memory_order_acquire); }
+
+    // 变换并在预定时间发送一个操作, 返回false表示播放被停止
+    bool playAction(ActionInfo &actionInfo, qint64 startTime);
+    // 一轮播放结束
+    bool finishLoop();
+};
+
+#endif // RECORDPLAYER_H
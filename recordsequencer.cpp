@@ -0,0 +1,250 @@
+#include "recordsequencer.h"
+#include "tracer.h"
+
+#include <QFile>
+#include <QScopeGuard>
+#include <QSharedPointer>
+#include <QTextStream>
+#include <QtConcurrent>
+
+#include <memory>
+
+bool loadPlaylistFile(const QString &filePath, QList<PlaylistEntry> *entries, QString *errorMsg){
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法打开文件:" + filePath;
+        }
+        return false;
+    }
+
+    entries->clear();
+
+    QTextStream in(&file);
+    while(!in.atEnd()){
+        QString line = in.readLine().trimmed();
+
+        // 空行和注释
+        if(line.isEmpty() || line.startsWith('#')){
+            continue;
+        }
+
+        // 录制文件名可能包含空格, 从行尾取出循环次数和间隔
+        PlaylistEntry entry{line, 1, LOOP_GAP_MS};
+        QList<qint64> numbers;
+        while(numbers.size() < 2){
+            int spaceIndex = entry.recordName.lastIndexOf(' ');
+            if(spaceIndex <= 0){
+                break;
+            }
+
+            bool ok;
+            qint64 val = entry.recordName.mid(spaceIndex + 1).toLongLong(&ok);
+            if(!ok){
+                break;
+            }
+
+            numbers.prepend(val);
+            entry.recordName = entry.recordName.left(spaceIndex).trimmed();
+        }
+
+        if(numbers.size() > 0){
+            entry.loopCount = numbers[0];
+        }
+        if(numbers.size() > 1){
+            entry.gapMs = qMax<qint64>(0, numbers[1]);
+        }
+
+        if(!entry.recordName.endsWith(RECORD_SUFFIX)){
+            entry.recordName.append(RECORD_SUFFIX);
+        }
+
+        entries->append(entry);
+    }
+
+    if(entries->isEmpty()){
+        if(errorMsg){
+            *errorMsg = "播放列表为空:" + filePath;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+// 后台加载的结果
+struct PreloadResult
+{
+    QSharedPointer<RecordData> data;// 加载失败时为空
+    QSharedPointer<ActionTransform> transform;// 没有变换时为空
+    QString errorMsg;
+};
+
+// 录制文件旁边同名变换文件的规则加上共用的规则, 没有变换时 transform 为空
+static bool loadRecordTransform(const QString &filePath, const QList<TransformRule> &baseRules,
+                                QSharedPointer<ActionTransform> *transform, QString *errorMsg){
+    QList<TransformRule> rules;
+    QString transformPath = filePath.chopped(QString(RECORD_SUFFIX).size()) + TRANSFORM_SUFFIX;
+    if(filePath.endsWith(RECORD_SUFFIX) && QFile::exists(transformPath)
+        && !loadTransformFile(transformPath, &rules, errorMsg)){
+        return false;
+    }
+    rules.append(baseRules);
+    transform->reset(makeTransform(rules).release());
+    return true;
+}
+
+bool prepareRecord(const QString &recordDir, const QString &recordName, const QList<TransformRule> &baseRules,
+                   PreparedRecord *prepared, QString *errorMsg, const std::atomic<bool> *running){
+    QString filePath = recordDir + recordName;
+    QSharedPointer<ActionTransform> transform;
+    if(!loadRecordTransform(filePath, baseRules, &transform, errorMsg)){
+        return false;
+    }
+
+    QSharedPointer<RecordData> data(new RecordData);
+    if(!loadRecordFile(filePath, data.data(), errorMsg, running)){
+        return false;
+    }
+
+    prepared->recordName = recordName;
+    prepared->data = data;
+    prepared->transform = transform;
+    return true;
+}
+
+static QFuture<PreloadResult> preloadRecord(const QString &filePath, const QList<TransformRule> &baseRules, const std::atomic<bool> *running){
+    return QtConcurrent::run([filePath, baseRules, running](){
+        PreloadResult result;
+        PreparedRecord prepared;
+        if(prepareRecord(QString(), filePath, baseRules, &prepared, &result.errorMsg, running)){
+            result.data = prepared.data;
+            result.transform = prepared.transform;
+        }
+        return result;
+    });
+}
+
+RecordSequencer::RecordSequencer(RecordPlayer *player, const std::atomic<bool> *running)
+    : m_player(player)
+    , m_running(running)
+{
+}
+
+bool RecordSequencer::run(const QString &recordDir, const QList<PlaylistEntry> &entries, QString *errorMsg){
+    if(entries.isEmpty()){
+        return true;
+    }
+
+    // 整个列表共用播放器的时间轴
+    PlaybackClock *clock = m_player->clock();
+    clock->start();
+
+    // 下一轮在时间轴上的开始时间 ns
+    qint64 nextStart = 0;
+
+    int index = 0;
+    QSharedPointer<RecordData> current;
+    QSharedPointer<ActionTransform> currentTransform;
+    // 变换随函数返回释放, 返回前从播放器中移除
+    auto clearTransform = qScopeGuard([this]{ m_player->setTransform(nullptr); });
+
+    // 第一项边加载边播放, 其余项在播放前一项时于后台加载
+    QFuture<PreloadResult> next;
+    std::unique_ptr<RecordPipeline> pipeline;
+    if(m_prepared.data && m_prepared.recordName == entries[0].recordName){
+        // 开始播放前已加载好
+        current = m_prepared.data;
+        currentTransform = m_prepared.transform;
+        m_player->setTransform(currentTransform.data());
+    }else if(m_pipelineLeadTime >= 0){
+        QString filePath = recordDir + entries[0].recordName;
+        pipeline.reset(new RecordPipeline);
+        if(!loadRecordTransform(filePath, m_transformRules, &currentTransform, errorMsg)
+            || !pipeline->start(filePath, m_running, errorMsg)){
+            return false;
+        }
+        m_player->setTransform(currentTransform.data());
+    }else{
+        next = preloadRecord(recordDir + entries[0].recordName, m_transformRules, m_running);
+    }
+
+    while(m_running->load(std::memory_order_acquire)){
+        const PlaylistEntry &entry = entries[index];
+        if(m_player->stats()){
+            m_player->stats()->setCurrentEntry(index);
+        }
+        index = (index + 1) % entries.size();
+        bool isLastEntry = !m_repeatList && index == 0;
+
+        // 同一个录制连续播放时不需要重新加载
+        if(!pipeline && (!current || next.isValid())){
+            PreloadResult result = next.result();
+            if(!result.data){
+                // 停止播放导致的中止不算错误
+                if(!m_running->load(std::memory_order_acquire)){
+                    return true;
+                }
+                if(errorMsg){
+                    *errorMsg = result.errorMsg;
+                }
+                return false;
+            }
+            current = result.data;
+            currentTransform = result.transform;
+            m_player->setTransform(currentTransform.data());
+            next = QFuture<PreloadResult>();
+        }
+
+        // 播放当前项的同时, 在后台加载下一项
+        if(!isLastEntry && entries[index].recordName != entry.recordName){
+            next = preloadRecord(recordDir + entries[index].recordName, m_transformRules, m_running);
+        }
+
+        for(int loop = 0; entry.loopCount <= 0 || loop < entry.loopCount; loop++){
+            if(!m_player->waitUntil(nextStart)){
+                return true;
+            }
+
+            Tracer::instant("loopStart", "entry", (index + entries.size() - 1) % entries.size());
+            m_player->prepareLoop(pipeline ? pipeline->header() : *current);
+
+            bool played;
+            qint64 startTime;
+            if(pipeline){
+                // 预先读取开头一段再开始, 之后加载线程保持领先
+                if(!pipeline->waitLead(m_pipelineLeadTime)){
+                    // 停止播放导致的中止不算错误
+                    pipeline->waitFinished(errorMsg);
+                    return !m_running->load(std::memory_order_acquire);
+                }
+                startTime = qMax(nextStart, clock->nsecsElapsed());
+                played = m_player->playPipeline(pipeline.get(), startTime);
+
+                // 第一轮播放完时已读取完整个录制, 之后的轮次直接播放
+                current = pipeline->waitFinished(errorMsg);
+                pipeline.reset();
+                if(!current){
+                    return !m_running->load(std::memory_order_acquire);
+                }
+            }else{
+                // 复位动作可能超出预定时间, 从当前时间开始
+                startTime = qMax(nextStart, clock->nsecsElapsed());
+                played = m_player->playOnce(*current, startTime);
+            }
+            if(!played){
+                return true;
+            }
+
+            bool isLastLoop = entry.loopCount > 0 && loop == entry.loopCount - 1;
+            nextStart = startTime + m_player->loopDuration(*current) + (isLastLoop ? entry.gapMs : LOOP_GAP_MS) * 1000000;
+        }
+
+        // 不重复时列表播放完即结束, 不等待最后一项之后的间隔
+        if(isLastEntry){
+            break;
+        }
+    }
+
+    return true;
+}
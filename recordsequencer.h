@@ -0,0 +1,67 @@
+#ifndef RECORDSEQUENCER_H
+#define RECORDSEQUENCER_H
+
+#include "recordplayer.h"
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+#define PLAYLIST_SUFFIX ".playlist"
+
+// 同一录制两轮播放之间的等待 ms
+#define LOOP_GAP_MS 500
+
+// 播放列表中的一项
+struct PlaylistEntry
+{
+    QString recordName;// 录制文件名
+    int loopCount;// 循环次数, <=0 表示一直循环
+    qint64 gapMs;// 本项播放完后到下一项开始的间隔 ms
+};
+
+// 读取播放列表文件
+// 每行格式: "录制文件名 循环次数 间隔ms", 循环次数和间隔可省略, 以#开头的行为注释
+bool loadPlaylistFile(const QString &filePath, QList<PlaylistEntry> *entries, QString *errorMsg = nullptr);
+
+// 加载好的录制和变换, 可在开始播放前准备好交给 RecordSequencer
+struct PreparedRecord
+{
+    QString recordName;// 录制文件名
+    QSharedPointer<RecordData> data;
+    QSharedPointer<ActionTransform> transform;// 没有变换时为空
+};
+
+// 加载录制文件和旁边同名 .transform 文件的规则, baseRules 加在文件中的规则之后
+bool prepareRecord(const QString &recordDir, const QString &recordName, const QList<TransformRule> &baseRules,
+                   PreparedRecord *prepared, QString *errorMsg = nullptr, const std::atomic<bool> *running = nullptr);
+
+// 按播放列表顺序播放多个录制, 播放当前项时在后台线程加载下一项
+// 所有项共用一条时间轴, 切换时不会因为读取文件而停顿
+class RecordSequencer
+{
+public:
+    RecordSequencer(RecordPlayer *player, const std::atomic<bool> *running);
+
+    // 所有录制共用的变换规则, 加在录制旁边同名 .transform 文件的规则之后
+    void setTransformRules(const QList<TransformRule> &rules) { m_transformRules = rules; }
+    // 第一项边加载边播放, 读取到开头 leadTime(ns) 的操作后就开始, <0 表示加载完再播放
+    void setPipelineLeadTime(qint64 leadTime) { m_pipelineLeadTime = leadTime; }
+    // 播放完整个列表后是否从头重复, 默认重复直到停止
+    void setRepeatList(bool val) { m_repeatList = val; }
+    // 已加载的录制, 列表第一项是它时直接播放, 不再读取文件
+    void setPrepared(const PreparedRecord &prepared) { m_prepared = prepared; }
+
+    // 循环播放整个列表直到停止(不重复时播放一遍), 加载录制文件失败时返回false
+    bool run(const QString &recordDir, const QList<PlaylistEntry> &entries, QString *errorMsg = nullptr);
+
+private:
+    RecordPlayer *m_player;
+    const std::atomic<bool> *m_running;
+    QList<TransformRule> m_transformRules;
+    qint64 m_pipelineLeadTime = -1;
+    bool m_repeatList = true;
+    PreparedRecord m_prepared;
+};
+
+#endif // RECORDSEQUENCER_H
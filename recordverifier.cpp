@@ -0,0 +1,222 @@
+#include "recordverifier.h"
+#include "loopbackemitter.h"
+#include "recordpipeline.h"
+#include "recordplayer.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+
+#include <algorithm>
+#include <vector>
+
+QList<ActionInfo> playLoopback(const RecordData &source, const std::atomic<bool> *running, ActionTransform *transform, PlaybackClock *clock){
+    std::atomic<bool> alwaysRunning{true};
+
+    LoopbackEmitter emitter;
+    emitter.setCursorPos(source.firstX, source.firstY);
+
+    RecordPlayer player(&emitter, running ? running : &alwaysRunning);
+    player.setTransform(transform);
+    player.setClock(clock);
+
+    // 播放和记录共用一条时间轴, 记录的时间可直接与录制时间比较
+    player.clock()->start();
+    emitter.setClock(player.clock());
+
+    player.playOnce(source, 0);
+    return emitter.captured();
+}
+
+QList<ActionInfo> playLoopbackMacro(const MacroProgram &program, ActionTransform *transform, PlaybackClock *clock){
+    std::atomic<bool> running{true};
+
+    LoopbackEmitter emitter;
+    emitter.setCursorPos(program.header.firstX, program.header.firstY);
+
+    RecordPlayer player(&emitter, &running);
+    player.setTransform(transform);
+    player.setClock(clock);
+
+    player.clock()->start();
+    emitter.setClock(player.clock());
+
+    player.playMacro(program, 0);
+    return emitter.captured();
+}
+
+bool playLoopbackPipelined(const QString &filePath, qint64 leadTime, ActionTransform *transform, PlaybackClock *clock,
+                           RecordData *source, QList<ActionInfo> *captured, qint64 *startDelay, QString *errorMsg){
+    std::atomic<bool> running{true};
+
+    LoopbackEmitter emitter;
+    RecordPlayer player(&emitter, &running);
+    player.setTransform(transform);
+    player.setClock(clock);
+
+    // 读取文件的耗时总是按实际时间计算
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    player.clock()->start();
+
+    RecordPipeline pipeline;
+    if(!pipeline.start(filePath, &running, errorMsg) || !pipeline.waitLead(leadTime)){
+        pipeline.waitFinished(errorMsg);
+        return false;
+    }
+    *startDelay = loadTimer.nsecsElapsed();
+    qint64 startTime = player.clock()->nsecsElapsed();
+
+    emitter.setCursorPos(pipeline.header().firstX, pipeline.header().firstY);
+    emitter.setClock(player.clock());
+    player.playPipeline(&pipeline, startTime);
+
+    QSharedPointer<RecordData> data = pipeline.waitFinished(errorMsg);
+    if(!data){
+        return false;
+    }
+    *source = *data;
+
+    // 发送时间改为相对播放开始
+    *captured = emitter.captured();
+    for(ActionInfo &actionInfo : *captured){
+        actionInfo.actionTime -= startTime;
+    }
+    return true;
+}
+
+// 对齐时使用的键: 操作类型、按键和动作, 鼠标移动都相同
+static int matchKey(const ActionInfo &actionInfo){
+    if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+        return -1;
+    }
+    return (int(actionInfo.actionType) << 16) | ((actionInfo.keyCode & 0x7FFF) << 1) | (actionInfo.isRelease ? 1 : 0);
+}
+
+// 最长递增子序列的长度
+static qint64 longestIncreasing(const std::vector<qint64> &values){
+    std::vector<qint64> tails;
+    for(qint64 value : values){
+        auto it = std::lower_bound(tails.begin(), tails.end(), value);
+        if(it == tails.end()){
+            tails.push_back(value);
+        }else{
+            *it = value;
+        }
+    }
+    return qint64(tails.size());
+}
+
+VerifyReport compareCapture(const RecordData &source, const QList<ActionInfo> &captured, const VerifyThresholds &thresholds){
+    VerifyReport report;
+    report.sourceEvents = source.actionList.size();
+    report.capturedEvents = captured.size();
+
+    // 每个键在发送结果中出现的位置
+    QHash<int, std::vector<qint64>> capturedIndex;
+    for(qint64 i = 0; i < captured.size(); i++){
+        capturedIndex[matchKey(captured[i])].push_back(i);
+    }
+    QHash<int, size_t> nextIndex;
+
+    // 发送结果中到每个位置为止的鼠标位置
+    std::vector<qint64> capturedX(captured.size()), capturedY(captured.size());
+    qint64 x = 0, y = 0;
+    for(qint64 i = 0; i < captured.size(); i++){
+        x += captured[i].dx;
+        y += captured[i].dy;
+        capturedX[i] = x;
+        capturedY[i] = y;
+    }
+    report.netMouseDx = x;
+    report.netMouseDy = y;
+
+    std::vector<qint64> matchedOrder;
+    std::vector<qint64> errors;
+    matchedOrder.reserve(source.actionList.size());
+    errors.reserve(source.actionList.size());
+
+    x = 0, y = 0;
+    for(const ActionInfo &actionInfo : source.actionList){
+        x += actionInfo.dx;
+        y += actionInfo.dy;
+
+        int key = matchKey(actionInfo);
+        const std::vector<qint64> &indices = capturedIndex[key];
+        size_t &next = nextIndex[key];
+        if(next >= indices.size()){
+            report.missing++;
+            continue;
+        }
+
+        qint64 j = indices[next++];
+        matchedOrder.push_back(j);
+        errors.push_back(captured[j].actionTime - actionInfo.actionTime);
+
+        if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+            qint64 error = qMax(qAbs(capturedX[j] - x), qAbs(capturedY[j] - y));
+            report.maxMouseError = qMax(report.maxMouseError, error);
+        }
+    }
+    report.netMouseDx -= x;
+    report.netMouseDy -= y;
+    report.maxMouseError = qMax(report.maxMouseError, qMax(qAbs(report.netMouseDx), qAbs(report.netMouseDy)));
+
+    report.matched = qint64(matchedOrder.size());
+    report.extra = report.capturedEvents - report.matched;
+    // 不在最长的保持顺序的子序列中的操作, 即为顺序错乱的操作
+    report.reordered = report.matched - longestIncreasing(matchedOrder);
+
+    if(!errors.empty()){
+        qint64 sum = 0;
+        for(qint64 error : errors){
+            sum += error;
+        }
+        std::sort(errors.begin(), errors.end());
+        report.minError = errors.front();
+        report.maxError = errors.back();
+        report.meanError = sum / qint64(errors.size());
+        report.p50Error = errors[(errors.size() - 1) * 50 / 100];
+        report.p99Error = errors[(errors.size() - 1) * 99 / 100];
+    }
+
+    if(report.missing > thresholds.maxMissing){
+        report.failures.append(QString("缺少 %1 个操作, 允许 %2").arg(report.missing).arg(thresholds.maxMissing));
+    }
+    if(report.extra > thresholds.maxExtra){
+        report.failures.append(QString("多出 %1 个操作, 允许 %2").arg(report.extra).arg(thresholds.maxExtra));
+    }
+    if(report.reordered > thresholds.maxReordered){
+        report.failures.append(QString("%1 个操作顺序错乱, 允许 %2").arg(report.reordered).arg(thresholds.maxReordered));
+    }
+    if(report.maxMouseError > thresholds.maxMouseError){
+        report.failures.append(QString("鼠标位置误差 %1 像素, 允许 %2").arg(report.maxMouseError).arg(thresholds.maxMouseError));
+    }
+    if(report.p99Error > thresholds.maxP99Error){
+        report.failures.append(QString("p99 延迟 %1 ms, 允许 %2 ms")
+                                   .arg(report.p99Error / 1000000.0, 0, 'f', 3).arg(thresholds.maxP99Error / 1000000.0, 0, 'f', 3));
+    }
+    if(thresholds.maxError > 0 && report.maxError > thresholds.maxError){
+        report.failures.append(QString("最大延迟 %1 ms, 允许 %2 ms")
+                                   .arg(report.maxError / 1000000.0, 0, 'f', 3).arg(thresholds.maxError / 1000000.0, 0, 'f', 3));
+    }
+
+    return report;
+}
+
+QString VerifyReport::toText() const{
+    auto ms = [](qint64 ns){
+        return QString::number(ns / 1000000.0, 'f', 3);
+    };
+
+    QString text;
+    text.append(QString("操作数: 录制 %1, 发送 %2, 对应 %3\n").arg(sourceEvents).arg(capturedEvents).arg(matched));
+    text.append(QString("缺少 %1, 多出 %2, 顺序错乱 %3\n").arg(missing).arg(extra).arg(reordered));
+    text.append(QString("鼠标: 总量误差 %1,%2, 路径最大误差 %3 像素\n").arg(netMouseDx).arg(netMouseDy).arg(maxMouseError));
+    text.append(QString("延迟 ms: 最小 %1, 平均 %2, p50 %3, p99 %4, 最大 %5\n")
+                    .arg(ms(minError), ms(meanError), ms(p50Error), ms(p99Error), ms(maxError)));
+    for(const QString &failure : failures){
+        text.append("未通过: ").append(failure).append("\n");
+    }
+    text.append(passed() ? "结果: 通过\n" : "结果: 未通过\n");
+    return text;
+}
@@ -0,0 +1,76 @@
+#ifndef RECORDVERIFIER_H
+#define RECORDVERIFIER_H
+
+#include "macroprogram.h"
+#include "recordfile.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+class ActionTransform;
+class PlaybackClock;
+
+// 验证通过的条件
+struct VerifyThresholds
+{
+    qint64 maxMissing = 0;// 最多缺少的操作数
+    qint64 maxExtra = 0;// 最多多出的操作数
+    qint64 maxReordered = 0;// 最多顺序错乱的操作数
+    qint64 maxMouseError = 0;// 鼠标路径上任一点的最大位置误差 像素
+    qint64 maxP99Error = 2000000;// 99%操作的最大发送延迟 ns
+    qint64 maxError = 0;// 所有操作的最大发送延迟 ns, 0表示不检查
+};
+
+// 播放结果与录制的比较结果
+struct VerifyReport
+{
+    qint64 sourceEvents = 0;
+    qint64 capturedEvents = 0;
+    qint64 matched = 0;
+    qint64 missing = 0;// 录制中有但没有发送
+    qint64 extra = 0;// 发送了但录制中没有, 包括每轮结尾松开未松开的按键
+    qint64 reordered = 0;// 与录制顺序不一致
+
+    // 鼠标移动的总量误差和路径上的最大误差 像素
+    qint64 netMouseDx = 0;
+    qint64 netMouseDy = 0;
+    qint64 maxMouseError = 0;
+
+    // 发送时间减去录制时间 ns
+    qint64 minError = 0;
+    qint64 meanError = 0;
+    qint64 p50Error = 0;
+    qint64 p99Error = 0;
+    qint64 maxError = 0;
+
+    QStringList failures;// 未满足的条件, 为空表示通过
+
+    bool passed() const { return failures.isEmpty(); }
+    // 多行文本形式的报告
+    QString toText() const;
+};
+
+// 以下函数的 clock 为播放和记录共用的时间轴, 为空时按实际时间播放; 使用虚拟时钟时立即播放完, 发送时间没有误差
+
+// 通过回环后端播放一轮录制, 返回发送的操作, actionTime 为相对播放开始的时间
+// transform 不为空时播放前对每个操作做变换
+QList<ActionInfo> playLoopback(const RecordData &source, const std::atomic<bool> *running = nullptr, ActionTransform *transform = nullptr,
+                               PlaybackClock *clock = nullptr);
+
+// 通过回环后端解释执行一遍宏程序, 返回发送的操作, actionTime 为相对播放开始的时间
+QList<ActionInfo> playLoopbackMacro(const MacroProgram &program, ActionTransform *transform = nullptr, PlaybackClock *clock = nullptr);
+
+// 边加载边播放录制文件到回环后端, 读取到开头 leadTime(ns) 的操作后开始播放
+// source 为读取完的录制, captured 的时间为相对播放开始, startDelay 为开始读取到开始播放的实际耗时 ns
+bool playLoopbackPipelined(const QString &filePath, qint64 leadTime, ActionTransform *transform, PlaybackClock *clock,
+                           RecordData *source, QList<ActionInfo> *captured, qint64 *startDelay, QString *errorMsg = nullptr);
+
+// 将发送的操作与录制对齐比较
+// 同一按键的同一动作、以及鼠标移动, 按出现顺序一一对应
+VerifyReport compareCapture(const RecordData &source, const QList<ActionInfo> &captured,
+                            const VerifyThresholds &thresholds = VerifyThresholds());
+
+#endif // RECORDVERIFIER_H
@@ -0,0 +1,143 @@
+#include "sendinputemitter.h"
+#include "key_map.h"
+
+void SendInputEmitter::fillKeyInput(INPUT *input, short scanCode, bool isKeyRelease){
+    short tmpDwFlags;
+
+    // 设置为使用硬件扫描码, 并为某些功能按键添加扩展码
+    if(scanCodeFlags(scanCode) & KEY_FLAG_EXTENDED){
+        tmpDwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_EXTENDEDKEY;
+    }else{
+        tmpDwFlags = KEYEVENTF_SCANCODE;
+    }
+
+    // 模拟按下键
+    input->type = INPUT_KEYBOARD;
+    input->ki.dwFlags = tmpDwFlags;
+    // 设置扫描码
+    input->ki.wScan = scanCode;
+
+    // 模拟释放键
+    if(isKeyRelease){
+        input->ki.dwFlags = tmpDwFlags | KEYEVENTF_KEYUP;
+    }
+}
+
+bool SendInputEmitter::fillMouseInput(INPUT *input, short mouseVK, bool isKeyRelease){
+    input->type = INPUT_MOUSE;
+
+    switch(mouseVK){
+    // 鼠标左键点击
+    case VK_LBUTTON:
+        input->mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP;
+        break;
+    // 鼠标右键点击
+    case VK_RBUTTON:
+        input->mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
+        break;
+    // 鼠标中键
+    case VK_MBUTTON:
+        input->mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP;
+        break;
+    // 鼠标侧键（前进/后退）
+    case VK_XBUTTON1:
+    case VK_XBUTTON2:
+        input->mi.dwFlags = !isKeyRelease ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP;
+        // 指定具体的侧键
+        input->mi.mouseData = mouseVK == VK_XBUTTON2 ? XBUTTON2 : XBUTTON1;
+        break;
+    default:
+        // 其它无效操作不模拟
+        return false;
+    }
+
+    return true;
+}
+
+void SendInputEmitter::sendKey(short scanCode, bool isKeyRelease){
+    // 模拟键盘操作
+    INPUT input = {0};
+    fillKeyInput(&input, scanCode, isKeyRelease);
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+// 模拟鼠标相对移动
+void SendInputEmitter::sendMouseMove(int dx, int dy){
+    // 构造鼠标事件
+    INPUT input = {0};
+    input.type = INPUT_MOUSE;
+
+    input.mi.dwFlags = MOUSEEVENTF_MOVE;  // 相对移动
+    input.mi.dx = dx;
+    input.mi.dy = dy;
+
+    // 发送鼠标事件
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+// 模拟鼠标绝对移动
+void SendInputEmitter::sendMouseMoveTo(int x, int y){
+    // 构造鼠标事件
+    INPUT input = {0};
+    input.type = INPUT_MOUSE;
+
+    // 获取屏幕分辨率
+    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+
+    // 转换为绝对坐标（0-65535）
+    int absoluteX = (x * 65535) / (screenWidth - 1);
+    int absoluteY = (y * 65535) / (screenHeight - 1);
+
+    // 使用绝对移动
+    input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+    input.mi.dx = absoluteX;
+    input.mi.dy = absoluteY;
+
+    // 发送鼠标事件
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+void SendInputEmitter::sendMouseButton(short mouseVK, bool isKeyRelease){
+    // 构造鼠标事件
+    INPUT input = {0};
+    if(!fillMouseInput(&input, mouseVK, isKeyRelease)){
+        return;
+    }
+
+    // 发送鼠标事件
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+bool SendInputEmitter::getCursorPos(int *x, int *y){
+    POINT cursorPos;
+    if (!GetCursorPos(&cursorPos)) {
+        return false;
+    }
+
+    *x = cursorPos.x;
+    *y = cursorPos.y;
+    return true;
+}
+
+void SendInputEmitter::sendReleases(const int *indices, int count){
+    INPUT inputs[HELD_KEY_BITS];
+    UINT inputCount = 0;
+
+    for(int i = 0; i < count; i++){
+        INPUT &input = inputs[inputCount];
+        ZeroMemory(&input, sizeof(INPUT));
+
+        if(indices[i] < HELD_MOUSE_BASE){
+            fillKeyInput(&input, indices[i], true);
+            inputCount++;
+        }else if(fillMouseInput(&input, indices[i] - HELD_MOUSE_BASE, true)){
+            inputCount++;
+        }
+    }
+
+    // 一次性松开所有按键
+    if(inputCount > 0){
+        SendInput(inputCount, inputs, sizeof(INPUT));
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef SENDINPUTEMITTER_H
+#define SENDINPUTEMITTER_H
+
+#include <windows.h>
+
+#include "inputemitter.h"
+
+// 通过 SendInput 发送到系统
+class SendInputEmitter : public InputEmitter
+{
+public:
+    const char *backendName() const override { return "sendinput"; }
+    bool getCursorPos(int *x, int *y) override;
+
+protected:
+    void sendKey(short scanCode, bool isKeyRelease) override;
+    void sendMouseButton(short mouseVK, bool isKeyRelease) override;
+    void sendMouseMove(int dx, int dy) override;
+    void sendMouseMoveTo(int x, int y) override;
+    // 只调用一次SendInput
+    void sendReleases(const int *indices, int count) override;
+
+private:
+    static void fillKeyInput(INPUT *input, short scanCode, bool isKeyRelease);
+    // 构造鼠标按键事件, 无效的按键返回false
+    static bool fillMouseInput(INPUT *input, short mouseVK, bool isKeyRelease);
+};
+
+#endif // SENDINPUTEMITTER_H
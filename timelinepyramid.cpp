@@ -0,0 +1,152 @@
+#include "timelinepyramid.h"
+#include "heldkeytracker.h"
+
+#include <QHash>
+
+void TimelinePyramid::build(const RecordData &data){
+    m_actions = data.actionList;
+    m_duration = qMax<qint64>(1, data.duration());
+    m_baseWidth = m_duration / BASE_BINS + 1;
+    int baseCount = int(m_duration / m_baseWidth) + 1;
+
+    m_laneNames.clear();
+    m_holds.clear();
+    m_keyLevels.clear();
+    m_mouseLevels.clear();
+    m_maxMouseCount.clear();
+
+    // 按首次出现的顺序为每个按键分配一行, 与 HeldKeyTracker 使用相同的位置
+    QHash<int, int> laneIndex;
+    QList<qint64> pressTime;
+    QList<MouseBin> mouseBins(baseCount);
+
+    for(const ActionInfo &actionInfo : std::as_const(m_actions)){
+        if(actionInfo.actionType == ACTION_MOUSE_MOVE){
+            MouseBin move;
+            move.count = 1;
+            move.minDx = move.maxDx = actionInfo.dx;
+            move.minDy = move.maxDy = actionInfo.dy;
+            MouseBin &bin = mouseBins[int(qBound<qint64>(0, actionInfo.actionTime, m_duration) / m_baseWidth)];
+            bin = mergeMouseBins(bin, move);
+            continue;
+        }
+
+        int bit = actionInfo.actionType == ACTION_KEYBOARD
+                      ? (actionInfo.keyCode & 0xFF)
+                      : HELD_MOUSE_BASE + (actionInfo.keyCode & 0x07);
+        int lane = laneIndex.value(bit, -1);
+        if(lane < 0){
+            lane = m_laneNames.size();
+            laneIndex.insert(bit, lane);
+            m_laneNames.append(actionName(actionInfo));
+            m_holds.append(QList<Hold>());
+            pressTime.append(-1);
+        }
+
+        if(!actionInfo.isRelease){
+            if(pressTime[lane] < 0){
+                pressTime[lane] = actionInfo.actionTime;
+            }
+        }else if(pressTime[lane] >= 0){
+            m_holds[lane].append(Hold{pressTime[lane], actionInfo.actionTime});
+            pressTime[lane] = -1;
+        }
+    }
+
+    // 到结尾仍未松开的按键
+    for(int lane = 0; lane < pressTime.size(); lane++){
+        if(pressTime[lane] >= 0){
+            m_holds[lane].append(Hold{pressTime[lane], m_duration});
+        }
+    }
+
+    // 第0级
+    QList<KeyBin> keyBins(laneCount() * baseCount);
+    for(int lane = 0; lane < laneCount(); lane++){
+        KeyBin *bins = keyBins.data() + lane * baseCount;
+        for(const Hold &hold : std::as_const(m_holds[lane])){
+            int first = int(qBound<qint64>(0, hold.start, m_duration) / m_baseWidth);
+            int last = int((qBound<qint64>(hold.start + 1, hold.end, m_duration + 1) - 1) / m_baseWidth);
+            if(bins[first].presses < 0xFFFF){
+                bins[first].presses++;
+            }
+            for(int i = first; i <= last; i++){
+                bins[i].maxHeld = 1;
+                if(hold.start <= i * m_baseWidth && hold.end >= (i + 1) * m_baseWidth){
+                    bins[i].minHeld = 1;
+                }
+            }
+        }
+    }
+
+    m_keyLevels.append(keyBins);
+    m_mouseLevels.append(mouseBins);
+
+    // 逐级合并相邻两段
+    while(true){
+        int level = m_mouseLevels.size() - 1;
+        const QList<MouseBin> &mouse = m_mouseLevels[level];
+        const QList<KeyBin> &keys = m_keyLevels[level];
+        int count = mouse.size();
+
+        quint32 maxCount = 0;
+        for(const MouseBin &bin : mouse){
+            maxCount = qMax(maxCount, bin.count);
+        }
+        m_maxMouseCount.append(maxCount);
+
+        if(count <= 1){
+            break;
+        }
+
+        int nextCount = (count + 1) / 2;
+        QList<MouseBin> nextMouse(nextCount);
+        QList<KeyBin> nextKeys(laneCount() * nextCount);
+        for(int i = 0; i < nextCount; i++){
+            nextMouse[i] = 2 * i + 1 < count ? mergeMouseBins(mouse[2 * i], mouse[2 * i + 1]) : mouse[2 * i];
+        }
+        for(int lane = 0; lane < laneCount(); lane++){
+            const KeyBin *bins = keys.constData() + lane * count;
+            KeyBin *nextBins = nextKeys.data() + lane * nextCount;
+            for(int i = 0; i < nextCount; i++){
+                nextBins[i] = 2 * i + 1 < count ? mergeKeyBins(bins[2 * i], bins[2 * i + 1]) : bins[2 * i];
+            }
+        }
+
+        m_mouseLevels.append(nextMouse);
+        m_keyLevels.append(nextKeys);
+    }
+}
+
+int TimelinePyramid::levelFor(qint64 ns) const{
+    int level = 0;
+    while(level + 1 < levelCount() && binWidth(level + 1) <= ns){
+        level++;
+    }
+    return level;
+}
+
+TimelinePyramid::KeyBin TimelinePyramid::mergeKeyBins(const KeyBin &a, const KeyBin &b){
+    KeyBin bin;
+    bin.presses = quint16(qMin(0xFFFF, a.presses + b.presses));
+    bin.minHeld = qMin(a.minHeld, b.minHeld);
+    bin.maxHeld = qMax(a.maxHeld, b.maxHeld);
+    return bin;
+}
+
+TimelinePyramid::MouseBin TimelinePyramid::mergeMouseBins(const MouseBin &a, const MouseBin &b){
+    if(a.count == 0){
+        return b;
+    }
+    if(b.count == 0){
+        return a;
+    }
+
+    MouseBin bin;
+    bin.count = a.count + b.count;
+    bin.minDx = qMin(a.minDx, b.minDx);
+    bin.maxDx = qMax(a.maxDx, b.maxDx);
+    bin.minDy = qMin(a.minDy, b.minDy);
+    bin.maxDy = qMax(a.maxDy, b.maxDy);
+    return bin;
+}
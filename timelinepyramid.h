@@ -0,0 +1,90 @@
+#ifndef TIMELINEPYRAMID_H
+#define TIMELINEPYRAMID_H
+
+#include "recordfile.h"
+
+#include <QList>
+#include <QString>
+
+// 时间线视图使用的多级汇总数据
+// 第0级把录制等分为 BASE_BINS 个时间段, 每上一级合并相邻两段, 直到只剩一段
+// 每段记录按键的按下次数和是否按住(最小值/最大值), 以及鼠标移动的次数和移动量的最小值/最大值
+// 绘制时每个像素只需读取一两个时间段, 耗时与操作数无关
+class TimelinePyramid
+{
+public:
+    // 第0级的时间段数
+    static constexpr int BASE_BINS = 1 << 15;
+
+    // 一个按键在一个时间段内的状态
+    struct KeyBin
+    {
+        quint16 presses = 0;// 按下次数
+        quint8 minHeld = 0;// 整段都按住时为1
+        quint8 maxHeld = 0;// 段内按住过时为1
+    };
+
+    // 一个时间段内的鼠标移动
+    struct MouseBin
+    {
+        quint32 count = 0;
+        qint32 minDx = 0;
+        qint32 maxDx = 0;
+        qint32 minDy = 0;
+        qint32 maxDy = 0;
+    };
+
+    // 一次按住, [start, end) ns
+    struct Hold
+    {
+        qint64 start;
+        qint64 end;
+    };
+
+    // 由录制生成所有级别, 耗时与操作数成正比
+    void build(const RecordData &data);
+
+    qint64 duration() const { return m_duration; }
+    int levelCount() const { return m_mouseLevels.size(); }
+    // 第 level 级每段的时长 ns
+    qint64 binWidth(int level) const { return m_baseWidth << level; }
+    // 第 level 级的段数
+    int binCount(int level) const { return m_mouseLevels[level].size(); }
+    // 每段时长不超过 ns 的最粗的级别
+    int levelFor(qint64 ns) const;
+
+    // 录制中出现过的按键, 每个按键一行
+    int laneCount() const { return m_laneNames.size(); }
+    const QString &laneName(int lane) const { return m_laneNames[lane]; }
+
+    const KeyBin &keyBin(int lane, int level, int index) const {
+        return m_keyLevels[level][lane * binCount(level) + index];
+    }
+    const MouseBin &mouseBin(int level, int index) const {
+        return m_mouseLevels[level][index];
+    }
+    // 第 level 级中鼠标移动最多的一段的次数, 用于归一化
+    quint32 maxMouseCount(int level) const { return m_maxMouseCount[level]; }
+
+    // 放大到第0级以下时逐个绘制, 按开始时间排序
+    const QList<Hold> &holds(int lane) const { return m_holds[lane]; }
+    const QList<ActionInfo> &actions() const { return m_actions; }
+
+    static KeyBin mergeKeyBins(const KeyBin &a, const KeyBin &b);
+    static MouseBin mergeMouseBins(const MouseBin &a, const MouseBin &b);
+
+private:
+    qint64 m_duration = 0;
+    qint64 m_baseWidth = 1;
+
+    QList<QString> m_laneNames;
+    QList<QList<Hold>> m_holds;
+    QList<ActionInfo> m_actions;
+
+    // 每级按 lane * binCount + index 排列
+    QList<QList<KeyBin>> m_keyLevels;
+    QList<QList<MouseBin>> m_mouseLevels;
+    QList<quint32> m_maxMouseCount;
+};
+
+#endif // TIMELINEPYRAMID_H
@@ -0,0 +1,242 @@
+#include "timelinewidget.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+
+// 左侧按键名称的宽度
+#define TIMELINE_LABEL_WIDTH 72
+// 鼠标移动行的高度
+#define TIMELINE_MOUSE_HEIGHT 28
+// 按键行的最大高度
+#define TIMELINE_LANE_HEIGHT 14
+// 放大到第0级以下时, 可见操作数不超过该值才逐个绘制
+#define TIMELINE_EXACT_LIMIT 20000
+// 最小显示时长 ns
+#define TIMELINE_MIN_SPAN 100000
+
+static const QColor HOLD_COLOR(57, 187, 244);
+static const QColor PARTIAL_COLOR(57, 187, 244, 110);
+static const QColor MOUSE_COLOR(6, 200, 99);
+
+TimelineWidget::TimelineWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    setMouseTracking(false);
+}
+
+void TimelineWidget::setPyramid(QSharedPointer<const TimelinePyramid> pyramid){
+    m_pyramid = pyramid;
+    setView(0, m_pyramid ? m_pyramid->duration() : 1);
+}
+
+void TimelineWidget::setView(qint64 start, qint64 span){
+    qint64 duration = m_pyramid ? m_pyramid->duration() : 1;
+    m_viewSpan = qBound<qint64>(qMin<qint64>(TIMELINE_MIN_SPAN, duration), span, duration);
+    m_viewStart = qBound<qint64>(0, start, duration - m_viewSpan);
+    update();
+}
+
+qint64 TimelineWidget::timeAt(qreal x) const{
+    qreal width = qMax(1, this->width() - TIMELINE_LABEL_WIDTH);
+    return m_viewStart + qint64((x - TIMELINE_LABEL_WIDTH) * m_viewSpan / width);
+}
+
+void TimelineWidget::paintEvent(QPaintEvent *event){
+    Q_UNUSED(event);
+    QPainter painter(this);
+    paintTimeline(&painter, rect(), m_pyramid.data(), m_viewStart, m_viewSpan);
+}
+
+void TimelineWidget::wheelEvent(QWheelEvent *event){
+    if(!m_pyramid){
+        return;
+    }
+
+    // 以鼠标所在位置为中心缩放
+    double factor = std::pow(0.8, event->angleDelta().y() / 120.0);
+    qint64 anchor = timeAt(event->position().x());
+    qint64 span = qint64(m_viewSpan * factor);
+    setView(anchor - qint64((anchor - m_viewStart) * factor), span);
+    event->accept();
+}
+
+void TimelineWidget::mousePressEvent(QMouseEvent *event){
+    m_dragX = event->position().x();
+    m_dragStart = m_viewStart;
+}
+
+void TimelineWidget::mouseMoveEvent(QMouseEvent *event){
+    if(!m_pyramid || !(event->buttons() & Qt::LeftButton)){
+        return;
+    }
+
+    qreal width = qMax(1, this->width() - TIMELINE_LABEL_WIDTH);
+    qreal dx = event->position().x() - m_dragX;
+    setView(m_dragStart - qint64(dx * m_viewSpan / width), m_viewSpan);
+}
+
+void TimelineWidget::mouseDoubleClickEvent(QMouseEvent *event){
+    Q_UNUSED(event);
+    if(m_pyramid){
+        setView(0, m_pyramid->duration());
+    }
+}
+
+// 一列像素覆盖的时间段 [first, last]
+static bool columnBins(const TimelinePyramid *pyramid, int level, qint64 t0, qint64 t1, int *first, int *last){
+    if(t0 > pyramid->duration()){
+        return false;
+    }
+    qint64 width = pyramid->binWidth(level);
+    int count = pyramid->binCount(level);
+    *first = int(qBound<qint64>(0, t0 / width, count - 1));
+    *last = int(qBound<qint64>(*first, (qMax(t1, t0 + 1) - 1) / width, count - 1));
+    return true;
+}
+
+void TimelineWidget::paintTimeline(QPainter *painter, const QRect &rect, const TimelinePyramid *pyramid,
+                                   qint64 viewStart, qint64 viewSpan){
+    painter->save();
+    painter->fillRect(rect, QColor(251, 251, 251));
+
+    if(!pyramid || pyramid->levelCount() == 0 || rect.width() <= TIMELINE_LABEL_WIDTH){
+        painter->setPen(QColor(128, 128, 128));
+        painter->drawText(rect, Qt::AlignCenter, "选择录制文件后显示时间线");
+        painter->restore();
+        return;
+    }
+
+    QRect plot(rect.left() + TIMELINE_LABEL_WIDTH, rect.top(), rect.width() - TIMELINE_LABEL_WIDTH,
+               qMax(0, rect.height() - TIMELINE_MOUSE_HEIGHT));
+    QRect mouseRow(plot.left(), plot.bottom() + 1, plot.width(), rect.bottom() - plot.bottom());
+
+    const int width = plot.width();
+    const int lanes = pyramid->laneCount();
+    const int laneHeight = lanes > 0 ? qMin(TIMELINE_LANE_HEIGHT, plot.height() / lanes) : 0;
+    const qint64 viewEnd = viewStart + viewSpan;
+    const qint64 nsPerPixel = qMax<qint64>(1, viewSpan / width);
+    const int level = pyramid->levelFor(nsPerPixel);
+    const bool belowBase = nsPerPixel < pyramid->binWidth(0);
+
+    // 第 x 列的开始时间
+    auto columnTime = [=](int x){
+        return viewStart + viewSpan * x / width;
+    };
+    auto timeX = [=](qint64 time){
+        return plot.left() + qreal(time - viewStart) * width / viewSpan;
+    };
+
+    // 按键名称
+    QFont font = painter->font();
+    font.setPixelSize(qMax(8, qMin(laneHeight, TIMELINE_LANE_HEIGHT) - 2));
+    painter->setFont(font);
+    painter->setPen(QColor(90, 90, 90));
+    if(laneHeight >= 8){
+        for(int lane = 0; lane < lanes; lane++){
+            painter->drawText(QRect(rect.left() + 2, plot.top() + lane * laneHeight, TIMELINE_LABEL_WIDTH - 4, laneHeight),
+                              Qt::AlignLeft | Qt::AlignVCenter, pyramid->laneName(lane));
+        }
+    }
+    painter->drawText(QRect(rect.left() + 2, mouseRow.top(), TIMELINE_LABEL_WIDTH - 4, mouseRow.height()),
+                      Qt::AlignLeft | Qt::AlignVCenter, "mouseMove");
+
+    // 放大到第0级以下, 可见的按住条不多时逐个绘制
+    bool exactHolds = false;
+    if(belowBase){
+        qint64 visible = 0;
+        for(int lane = 0; lane < lanes; lane++){
+            const QList<TimelinePyramid::Hold> &holds = pyramid->holds(lane);
+            auto first = std::partition_point(holds.begin(), holds.end(), [=](const TimelinePyramid::Hold &hold){ return hold.end <= viewStart; });
+            auto last = std::partition_point(first, holds.end(), [=](const TimelinePyramid::Hold &hold){ return hold.start < viewEnd; });
+            visible += last - first;
+        }
+        exactHolds = visible <= TIMELINE_EXACT_LIMIT;
+    }
+
+    for(int lane = 0; lane < lanes && laneHeight > 0; lane++){
+        int top = plot.top() + lane * laneHeight + 1;
+        int height = qMax(1, laneHeight - 2);
+
+        if(exactHolds){
+            const QList<TimelinePyramid::Hold> &holds = pyramid->holds(lane);
+            auto it = std::partition_point(holds.begin(), holds.end(), [=](const TimelinePyramid::Hold &hold){ return hold.end <= viewStart; });
+            for(; it != holds.end() && it->start < viewEnd; ++it){
+                qreal x0 = qMax<qreal>(plot.left(), timeX(it->start));
+                qreal x1 = qMin<qreal>(plot.right() + 1, timeX(it->end));
+                painter->fillRect(QRectF(x0, top, qMax<qreal>(1, x1 - x0), height), HOLD_COLOR);
+            }
+            continue;
+        }
+
+        // 相同状态的相邻列合并为一个矩形: 0 未按住, 1 部分按住, 2 整列按住
+        int runStart = 0;
+        int runState = 0;
+        for(int x = 0; x <= width; x++){
+            int state = 0;
+            int first, last;
+            if(x < width && columnBins(pyramid, level, columnTime(x), columnTime(x + 1), &first, &last)){
+                TimelinePyramid::KeyBin bin = pyramid->keyBin(lane, level, first);
+                for(int i = first + 1; i <= last; i++){
+                    bin = TimelinePyramid::mergeKeyBins(bin, pyramid->keyBin(lane, level, i));
+                }
+                state = bin.minHeld ? 2 : (bin.maxHeld ? 1 : 0);
+            }
+
+            if(state != runState || x == width){
+                if(runState != 0){
+                    painter->fillRect(QRect(plot.left() + runStart, top, x - runStart, height),
+                                      runState == 2 ? HOLD_COLOR : PARTIAL_COLOR);
+                }
+                runStart = x;
+                runState = state;
+            }
+        }
+    }
+
+    // 鼠标移动
+    const QList<ActionInfo> &actions = pyramid->actions();
+    auto firstAction = std::partition_point(actions.begin(), actions.end(), [=](const ActionInfo &action){ return action.actionTime < viewStart; });
+    auto lastAction = std::partition_point(firstAction, actions.end(), [=](const ActionInfo &action){ return action.actionTime < viewEnd; });
+    const int rowHeight = mouseRow.height() - 2;
+
+    if(belowBase && lastAction - firstAction <= TIMELINE_EXACT_LIMIT){
+        // 每次移动一条竖线, 高度表示移动量
+        for(auto it = firstAction; it != lastAction; ++it){
+            if(it->actionType != ACTION_MOUSE_MOVE){
+                continue;
+            }
+            double ratio = qMin(1.0, std::log1p(std::abs(it->dx) + std::abs(it->dy)) / std::log1p(64));
+            int height = qMax(1, int(ratio * rowHeight));
+            painter->fillRect(QRectF(timeX(it->actionTime), mouseRow.bottom() - height, 1, height), MOUSE_COLOR);
+        }
+    }else{
+        // 每列的高度表示移动次数
+        double maxCount = std::log1p(qMax<quint32>(1, pyramid->maxMouseCount(level)));
+        for(int x = 0; x < width; x++){
+            int first, last;
+            if(!columnBins(pyramid, level, columnTime(x), columnTime(x + 1), &first, &last)){
+                break;
+            }
+            quint32 count = 0;
+            for(int i = first; i <= last; i++){
+                count += pyramid->mouseBin(level, i).count;
+            }
+            if(count == 0){
+                continue;
+            }
+            int height = qMax(1, int(qMin(1.0, std::log1p(count) / maxCount) * rowHeight));
+            painter->fillRect(QRect(plot.left() + x, mouseRow.bottom() - height, 1, height), MOUSE_COLOR);
+        }
+    }
+
+    // 分隔线
+    painter->setPen(QColor(220, 220, 220));
+    painter->drawLine(plot.left() - 1, rect.top(), plot.left() - 1, rect.bottom());
+    painter->drawLine(rect.left(), mouseRow.top(), rect.right(), mouseRow.top());
+
+    painter->restore();
+}
@@ -0,0 +1,53 @@
+#ifndef TIMELINEWIDGET_H
+#define TIMELINEWIDGET_H
+
+#include "timelinepyramid.h"
+
+#include <QSharedPointer>
+#include <QWidget>
+
+class QPainter;
+
+// 显示录制的时间线: 每个按键一行按住条, 最下面一行为鼠标移动密度
+// 滚轮缩放, 拖动平移, 双击显示整个录制
+class TimelineWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TimelineWidget(QWidget *parent = nullptr);
+
+    // 设置要显示的录制, 为空时清空, 视图重置为整个录制
+    void setPyramid(QSharedPointer<const TimelinePyramid> pyramid);
+    QSharedPointer<const TimelinePyramid> pyramid() const { return m_pyramid; }
+
+    // 显示 [start, start + span) ns
+    void setView(qint64 start, qint64 span);
+    qint64 viewStart() const { return m_viewStart; }
+    qint64 viewSpan() const { return m_viewSpan; }
+
+    // 绘制时间线到 painter 的 rect 区域, 不依赖窗口, 可绘制到 QImage 离屏渲染
+    static void paintTimeline(QPainter *painter, const QRect &rect, const TimelinePyramid *pyramid,
+                              qint64 viewStart, qint64 viewSpan);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    // 像素横坐标对应的时间 ns
+    qint64 timeAt(qreal x) const;
+
+    QSharedPointer<const TimelinePyramid> m_pyramid;
+    qint64 m_viewStart = 0;
+    qint64 m_viewSpan = 1;
+
+    // 拖动开始时的位置和视图
+    qreal m_dragX = 0;
+    qint64 m_dragStart = 0;
+};
+
+#endif // TIMELINEWIDGET_H
@@ -0,0 +1,199 @@
+#include "timingprofile.h"
+#include "inputemitter.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+// 播放时每次睡眠的时长 ns
+#define SLEEP_REQUEST_NS 1000000
+
+qint64 TimingProfile::spinMargin() const{
+    // 再睡一次也不会超过预定时间
+    return SLEEP_REQUEST_NS + sleepOvershootP99 + clockReadCost;
+}
+
+QJsonObject TimingProfile::toJson() const{
+    QJsonObject json;
+    json["backend"] = backend;
+    json["measured_at"] = measuredAt;
+    json["sleep_overshoot_p50_ns"] = sleepOvershootP50;
+    json["sleep_overshoot_p99_ns"] = sleepOvershootP99;
+    json["sleep_overshoot_max_ns"] = sleepOvershootMax;
+    json["clock_read_ns"] = clockReadCost;
+    json["spin_ns"] = spinCost;
+    json["emit_p50_ns"] = emitLatencyP50;
+    json["emit_p99_ns"] = emitLatencyP99;
+    json["batch_emit_ns"] = batchEmitLatency;
+    json["spin_margin_ns"] = spinMargin();
+    json["lead_time_ns"] = leadTime();
+    return json;
+}
+
+bool TimingProfile::fromJson(const QJsonObject &json, TimingProfile *profile){
+    const char *keys[] = {"sleep_overshoot_p50_ns", "sleep_overshoot_p99_ns", "sleep_overshoot_max_ns", "clock_read_ns",
+                          "spin_ns", "emit_p50_ns", "emit_p99_ns", "batch_emit_ns"};
+    for(const char *key : keys){
+        if(!json.value(key).isDouble()){
+            return false;
+        }
+    }
+
+    profile->backend = json.value("backend").toString();
+    profile->measuredAt = json.value("measured_at").toString();
+    profile->sleepOvershootP50 = json.value("sleep_overshoot_p50_ns").toInteger();
+    profile->sleepOvershootP99 = json.value("sleep_overshoot_p99_ns").toInteger();
+    profile->sleepOvershootMax = json.value("sleep_overshoot_max_ns").toInteger();
+    profile->clockReadCost = json.value("clock_read_ns").toInteger();
+    profile->spinCost = json.value("spin_ns").toInteger();
+    profile->emitLatencyP50 = json.value("emit_p50_ns").toInteger();
+    profile->emitLatencyP99 = json.value("emit_p99_ns").toInteger();
+    profile->batchEmitLatency = json.value("batch_emit_ns").toInteger();
+    return true;
+}
+
+QString TimingProfile::toText() const{
+    auto us = [](qint64 ns){
+        return QString::number(ns / 1000.0, 'f', 1);
+    };
+
+    QString text;
+    text.append(QString("后端: %1, 测量时间: %2\n").arg(backend, measuredAt));
+    text.append(QString("睡眠1ms多睡 us: p50 %1, p99 %2, 最大 %3\n").arg(us(sleepOvershootP50), us(sleepOvershootP99), us(sleepOvershootMax)));
+    text.append(QString("读取计时器 %1 ns, 自旋一次 %2 ns\n").arg(clockReadCost).arg(spinCost));
+    text.append(QString("发送 us: 单次 p50 %1, p99 %2, 连续发送平均 %3\n").arg(us(emitLatencyP50), us(emitLatencyP99), us(batchEmitLatency)));
+    text.append(QString("播放时: 提前 %1 us 改为自旋等待, 提前 %2 us 发送\n").arg(us(spinMargin()), us(leadTime())));
+    return text;
+}
+
+bool saveTimingProfile(const QString &filePath, const TimingProfile &profile, QString *errorMsg){
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法创建文件:" + filePath;
+        }
+        return false;
+    }
+
+    file.write(QJsonDocument(profile.toJson()).toJson());
+    return true;
+}
+
+bool loadTimingProfile(const QString &filePath, TimingProfile *profile, QString *errorMsg){
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if(errorMsg){
+            *errorMsg = "无法打开文件:" + filePath;
+        }
+        return false;
+    }
+
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    if(!document.isObject() || !TimingProfile::fromJson(document.object(), profile)){
+        if(errorMsg){
+            *errorMsg = "计时校准文件格式错误:" + filePath;
+        }
+        return false;
+    }
+    return true;
+}
+
+// 排序后取百分位数
+static qint64 percentile(std::vector<qint64> &samples, int percent){
+    if(samples.empty()){
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * percent / 100];
+}
+
+TimingProfile calibrateTiming(InputEmitter *emitter, const CalibrationOptions &options, const std::atomic<bool> *running){
+    auto isRunning = [=](){
+        return !running || running->load(std::memory_order_acquire);
+    };
+
+#ifdef Q_OS_WIN
+    // 与播放时相同的系统定时器精度
+    timeBeginPeriod(1);
+#endif
+
+    TimingProfile profile;
+    profile.backend = emitter->backendName();
+    profile.measuredAt = QDateTime::currentDateTime().toString(Qt::ISODate);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 读取计时器
+    const int clockReads = 100000;
+    qint64 start = timer.nsecsElapsed();
+    qint64 sink = 0;
+    for(int i = 0; i < clockReads; i++){
+        sink += timer.nsecsElapsed();
+    }
+    profile.clockReadCost = (timer.nsecsElapsed() - start) / clockReads;
+    Q_UNUSED(sink);
+
+    // 自旋等待: 与播放时相同, 每次检查时间后让出时间片
+    const qint64 spinWindow = 10000000;
+    qint64 spins = 0;
+    start = timer.nsecsElapsed();
+    while(timer.nsecsElapsed() - start < spinWindow){
+        QThread::yieldCurrentThread();
+        spins++;
+    }
+    profile.spinCost = (timer.nsecsElapsed() - start) / qMax<qint64>(1, spins);
+
+    // 睡眠1ms
+    std::vector<qint64> samples;
+    samples.reserve(qMax(options.sleepSamples, options.emitSamples));
+    for(int i = 0; i < options.sleepSamples && isRunning(); i++){
+        qint64 before = timer.nsecsElapsed();
+        QThread::msleep(1);
+        samples.push_back(qMax<qint64>(0, timer.nsecsElapsed() - before - SLEEP_REQUEST_NS));
+    }
+    profile.sleepOvershootP50 = percentile(samples, 50);
+    profile.sleepOvershootP99 = percentile(samples, 99);
+    profile.sleepOvershootMax = samples.empty() ? 0 : samples.back();
+
+    // 单次发送, 之间睡眠使每次都像播放中间隔较长的操作
+    samples.clear();
+    for(int i = 0; i < options.emitSamples && isRunning(); i++){
+        QThread::msleep(1);
+        qint64 before = timer.nsecsElapsed();
+        emitter->simulateMouseRelativeMove(0, 0);
+        emitter->flush();
+        samples.push_back(timer.nsecsElapsed() - before);
+    }
+    profile.emitLatencyP99 = percentile(samples, 99);
+    profile.emitLatencyP50 = percentile(samples, 50);
+
+    // 连续发送, 取每批平均值的中位数
+    samples.clear();
+    for(int i = 0; i < options.batchCount && isRunning(); i++){
+        QThread::msleep(1);
+        qint64 before = timer.nsecsElapsed();
+        for(int j = 0; j < options.batchSize; j++){
+            emitter->simulateMouseRelativeMove(0, 0);
+        }
+        // 排队的后端一批只送出一次
+        emitter->flush();
+        samples.push_back((timer.nsecsElapsed() - before) / qMax(1, options.batchSize));
+    }
+    profile.batchEmitLatency = percentile(samples, 50);
+
+#ifdef Q_OS_WIN
+    timeEndPeriod(1);
+#endif
+
+    return profile;
+}
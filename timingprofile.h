@@ -0,0 +1,65 @@
+#ifndef TIMINGPROFILE_H
+#define TIMINGPROFILE_H
+
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+
+class InputEmitter;
+
+// 保存在录制文件夹中的计时校准文件名
+#define TIMING_PROFILE_NAME "timing.json"
+
+// 本机的计时和发送延迟, 由 calibrateTiming 测量
+// 播放时据此决定何时从睡眠改为自旋等待, 以及提前多久发送
+struct TimingProfile
+{
+    QString backend;// 测量时使用的发送后端
+    QString measuredAt;// 测量时间
+
+    // 请求睡眠1ms时多睡的时间 ns
+    qint64 sleepOvershootP50 = 0;
+    qint64 sleepOvershootP99 = 0;
+    qint64 sleepOvershootMax = 0;
+
+    // 读取一次计时器的耗时 ns
+    qint64 clockReadCost = 0;
+    // 自旋等待中一次检查的耗时 ns
+    qint64 spinCost = 0;
+
+    // 两次发送间隔较长时, 单次发送的耗时 ns
+    qint64 emitLatencyP50 = 0;
+    qint64 emitLatencyP99 = 0;
+    // 连续发送时平均每次的耗时 ns
+    qint64 batchEmitLatency = 0;
+
+    // 距离预定时间少于该值时不再睡眠, 自旋等待到预定时间
+    qint64 spinMargin() const;
+    // 提前发送的时间, 使操作在预定时间前后到达系统
+    qint64 leadTime() const { return emitLatencyP50; }
+
+    QJsonObject toJson() const;
+    // json 缺少字段时返回false
+    static bool fromJson(const QJsonObject &json, TimingProfile *profile);
+    QString toText() const;
+};
+
+bool saveTimingProfile(const QString &filePath, const TimingProfile &profile, QString *errorMsg = nullptr);
+bool loadTimingProfile(const QString &filePath, TimingProfile *profile, QString *errorMsg = nullptr);
+
+// 校准时的采样数
+struct CalibrationOptions
+{
+    int sleepSamples = 200;// 睡眠1ms的次数
+    int emitSamples = 200;// 单次发送的次数, 每次之间睡眠1ms
+    int batchCount = 20;// 连续发送的批数
+    int batchSize = 64;// 每批连续发送的次数
+};
+
+// 在当前机器上测量计时和通过 emitter 发送的延迟, 发送的是移动量为0的鼠标移动, 不影响鼠标位置
+// 耗时约为 (sleepSamples + emitSamples) ms, running 变为false时提前结束
+TimingProfile calibrateTiming(InputEmitter *emitter, const CalibrationOptions &options = CalibrationOptions(),
+                              const std::atomic<bool> *running = nullptr);
+
+#endif // TIMINGPROFILE_H
@@ -0,0 +1,108 @@
+#include "timingwheel.h"
+
+#include <QtAlgorithms>
+
+TimingWheel::TimingWheel() = default;
+
+bool TimingWheel::insert(TimerNode *node){
+    if(node->slot >= 0){
+        remove(node);
+    }
+    return place(node, false);
+}
+
+bool TimingWheel::place(TimerNode *node, bool allowCurrent){
+    qint64 tick = tickOf(node->deadline);
+    qint64 delta = tick - m_tick;
+    if(delta < 0 || (delta == 0 && !allowCurrent)){
+        return false;
+    }
+
+    // 第 level 级每槽覆盖 SLOTS^level 个 tick
+    int level = 0;
+    while(level < LEVELS - 1 && delta >= (qint64(1) << (SLOT_BITS * (level + 1)))){
+        level++;
+    }
+    // 超出最高级的范围, 放到最远的槽, 转到时重新插入
+    if(delta >= (qint64(1) << (SLOT_BITS * LEVELS))){
+        tick = m_tick + (qint64(SLOTS - 1) << (SLOT_BITS * (LEVELS - 1)));
+    }
+    int index = int((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    Slot &slot = m_slots[level][index];
+    node->prev = nullptr;
+    node->next = slot.head;
+    if(slot.head){
+        slot.head->prev = node;
+    }
+    slot.head = node;
+    node->slot = level * SLOTS + index;
+    m_occupied[level] |= quint64(1) << index;
+    m_count++;
+    return true;
+}
+
+void TimingWheel::remove(TimerNode *node){
+    if(node->slot < 0){
+        return;
+    }
+
+    int level = node->slot / SLOTS;
+    int index = node->slot % SLOTS;
+    Slot &slot = m_slots[level][index];
+    if(node->prev){
+        node->prev->next = node->next;
+    }else{
+        slot.head = node->next;
+    }
+    if(node->next){
+        node->next->prev = node->prev;
+    }
+    if(!slot.head){
+        m_occupied[level] &= ~(quint64(1) << index);
+    }
+
+    node->prev = node->next = nullptr;
+    node->slot = -1;
+    m_count--;
+}
+
+TimerNode *TimingWheel::takeSlot(int level, int index){
+    Slot &slot = m_slots[level][index];
+    TimerNode *head = slot.head;
+    slot.head = nullptr;
+    m_occupied[level] &= ~(quint64(1) << index);
+    return head;
+}
+
+bool TimingWheel::cascade(int level){
+    int index = int((m_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    TimerNode *node = takeSlot(level, index);
+    while(node){
+        TimerNode *next = node->next;
+        node->slot = -1;
+        m_count--;
+        place(node, true);
+        node = next;
+    }
+
+    // 本级也转完一圈时继续处理上一级
+    return index == 0;
+}
+
+qint64 TimingWheel::nextTick() const{
+    if(m_count == 0){
+        return -1;
+    }
+
+    // 第0级当前一圈中, 当前 tick 之后最近的非空槽
+    int index = int(m_tick & (SLOTS - 1));
+    quint64 ahead = index == SLOTS - 1 ? 0 : m_occupied[0] & (~quint64(0) << (index + 1));
+    if(ahead){
+        return m_tick - index + qCountTrailingZeroBits(ahead);
+    }
+
+    // 否则在第0级转完一圈时重新分配
+    return (m_tick | (SLOTS - 1)) + 1;
+}
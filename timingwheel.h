@@ -0,0 +1,105 @@
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <QtGlobal>
+
+// 时间轮中的一个定时, 嵌入到使用者的结构中, 插入和删除都不分配内存
+struct TimerNode
+{
+    TimerNode *prev = nullptr;
+    TimerNode *next = nullptr;
+    qint64 deadline = 0;// 到期时间 ns
+    int slot = -1;// 所在的槽 level * SLOTS + index, -1 表示不在时间轮中
+    void *owner = nullptr;// 使用者的数据
+};
+
+// 分级时间轮: 每级 SLOTS 个槽, 第0级每槽一个 tick, 上一级每槽为下一级一整圈
+// 插入、删除 O(1); 时间前进到下一级一圈的边界时, 把上一级对应槽中的定时重新分配到下面的级别
+// 超出最高级范围的定时放在最高级最远的槽中, 转到时重新插入
+class TimingWheel
+{
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+    // 一个 tick 为 2^TICK_SHIFT ns, 约0.26ms, 四级共约73分钟
+    static constexpr int TICK_SHIFT = 18;
+
+    TimingWheel();
+
+    static qint64 tickOf(qint64 time) { return time >> TICK_SHIFT; }
+    static qint64 tickStart(qint64 tick) { return tick << TICK_SHIFT; }
+
+    // 当前 tick, 该 tick 及之前的定时都已取出
+    qint64 currentTick() const { return m_tick; }
+    bool isEmpty() const { return m_count == 0; }
+    int count() const { return m_count; }
+
+    // 插入定时, 已经到期(不晚于当前 tick)的返回false, 由调用方立即处理
+    bool insert(TimerNode *node);
+    void remove(TimerNode *node);
+
+    // 时间前进到 tick, 到期的定时依次传给 expired(TimerNode*), 调用时已从时间轮中移除
+    template<class Func>
+    void advance(qint64 tick, Func &&expired);
+
+    // 下一个可能有定时到期的 tick: 第0级最近的非空槽, 或第0级转完一圈需要重新分配的时刻
+    // 时间轮为空时返回-1
+    qint64 nextTick() const;
+
+private:
+    struct Slot
+    {
+        TimerNode *head = nullptr;
+    };
+
+    Slot m_slots[LEVELS][SLOTS];
+    // 每级非空槽的位图
+    quint64 m_occupied[LEVELS] = {};
+    qint64 m_tick = 0;
+    int m_count = 0;
+
+    // 按到期 tick 放入对应的槽, allowCurrent 为true时可以放入当前 tick 的槽(重新分配时该槽尚未取出)
+    bool place(TimerNode *node, bool allowCurrent);
+    // 取出一个槽中的所有定时, 返回链表头
+    TimerNode *takeSlot(int level, int index);
+    // 把第 level 级当前槽中的定时重新插入, 返回是否需要继续处理更上一级
+    bool cascade(int level);
+};
+
+template<class Func>
+void TimingWheel::advance(qint64 tick, Func &&expired){
+    if(m_count == 0){
+        // 没有定时时直接跳到目标时刻
+        m_tick = qMax(m_tick, tick);
+        return;
+    }
+
+    while(m_tick < tick){
+        m_tick++;
+        int index = int(m_tick & (SLOTS - 1));
+
+        // 第0级转完一圈, 逐级重新分配
+        if(index == 0){
+            for(int level = 1; level < LEVELS && cascade(level); level++){
+            }
+        }
+
+        TimerNode *node = takeSlot(0, index);
+        while(node){
+            TimerNode *next = node->next;
+            node->prev = node->next = nullptr;
+            node->slot = -1;
+            m_count--;
+            expired(node);
+            node = next;
+        }
+
+        if(m_count == 0){
+            m_tick = qMax(m_tick, tick);
+            return;
+        }
+    }
+}
+
+#endif // TIMINGWHEEL_H
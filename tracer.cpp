@@ -0,0 +1,248 @@
+#include "tracer.h"
+
+#include <QFile>
+#include <QList>
+#include <QMutex>
+
+#include <memory>
+
+std::atomic<bool> Tracer::s_enabled{false};
+QString Tracer::s_outputFile;
+
+struct TraceEvent
+{
+    const char *name;
+    const char *argName1;
+    const char *argName2;
+    qint64 ts;// 开始时间 ns
+    qint64 dur;// 持续时间 ns
+    qint64 arg1;
+    qint64 arg2;
+    char phase;// 'X' 一段时间, 'i' 一个时间点
+};
+
+// 环形缓冲区中的一格, seq 为写入序号: 写入第 index 个事件时先设为 2*index+1, 写完后设为 2*index+2
+// 导出时前后两次读到相同的偶数序号才说明读到的是完整的事件, 否则所属线程正在写入或已覆盖, 跳过
+struct TraceSlot
+{
+    std::atomic<quint64> seq{0};
+    TraceEvent event;
+};
+
+// 一个线程的环形缓冲区, 只有所属线程写入
+struct TraceBuffer
+{
+    int tid = 0;
+    std::atomic<const char *> threadName{nullptr};
+    std::atomic<quint64> writeIndex{0};
+    std::unique_ptr<TraceSlot[]> slots;
+};
+
+// 所有线程的缓冲区, 线程结束后保留, 以便导出
+// 线程结束时缓冲区放入空闲列表, 之后创建的线程优先使用, 不会每个线程都新分配一个
+static QMutex s_buffersMutex;
+static QList<TraceBuffer *> s_buffers;
+static QList<TraceBuffer *> s_freeBuffers;
+
+// 同一时刻只有一个线程导出, 录制线程和播放线程可能同时结束
+static QMutex s_writeMutex;
+
+// 线程结束时把缓冲区放回空闲列表, 其中的事件仍可导出, 直到被新线程覆盖
+struct ThreadBufferHolder
+{
+    TraceBuffer *buffer = nullptr;
+
+    ~ThreadBufferHolder(){
+        if(buffer){
+            QMutexLocker locker(&s_buffersMutex);
+            s_freeBuffers.append(buffer);
+            buffer = nullptr;
+        }
+    }
+};
+
+static thread_local ThreadBufferHolder t_holder;
+
+// 当前线程的缓冲区, 第一次使用时取空闲的缓冲区, 没有时分配
+static TraceBuffer *threadBuffer(){
+    if(!t_holder.buffer){
+        QMutexLocker locker(&s_buffersMutex);
+        if(!s_freeBuffers.isEmpty()){
+            // 沿用原来的 tid, 时间线上与之前的线程显示在同一行
+            TraceBuffer *buffer = s_freeBuffers.takeLast();
+            buffer->threadName.store(nullptr, std::memory_order_release);
+            t_holder.buffer = buffer;
+        }else{
+            TraceBuffer *buffer = new TraceBuffer;
+            buffer->slots.reset(new TraceSlot[Tracer::BUFFER_SIZE]);
+            buffer->tid = s_buffers.size() + 1;
+            s_buffers.append(buffer);
+            t_holder.buffer = buffer;
+        }
+    }
+    return t_holder.buffer;
+}
+
+static void appendEvent(const TraceEvent &event){
+    TraceBuffer *buffer = threadBuffer();
+    quint64 index = buffer->writeIndex.load(std::memory_order_relaxed);
+    TraceSlot &slot = buffer->slots[index & (Tracer::BUFFER_SIZE - 1)];
+    slot.seq.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = event;
+    slot.seq.store(index * 2 + 2, std::memory_order_release);
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+// 读取第 index 个事件, 正在写入或已被覆盖时返回false
+static bool readEvent(const TraceBuffer *buffer, quint64 index, TraceEvent *event){
+    const TraceSlot &slot = buffer->slots[index & (Tracer::BUFFER_SIZE - 1)];
+    quint64 seq = slot.seq.load(std::memory_order_acquire);
+    if(seq != index * 2 + 2){
+        return false;
+    }
+    *event = slot.event;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+}
+
+void Tracer::setThreadName(const char *name){
+    if(isEnabled()){
+        threadBuffer()->threadName.store(name, std::memory_order_release);
+    }
+}
+
+void Tracer::complete(const char *name, qint64 start, qint64 end, const char *argName1, qint64 arg1, const char *argName2, qint64 arg2){
+    if(!isEnabled()){
+        return;
+    }
+    appendEvent(TraceEvent{name, argName1, argName2, start, end - start, arg1, arg2, 'X'});
+}
+
+void Tracer::instant(const char *name, const char *argName1, qint64 arg1){
+    if(!isEnabled()){
+        return;
+    }
+    appendEvent(TraceEvent{name, argName1, nullptr, now(), 0, arg1, 0, 'i'});
+}
+
+// json字符串转义, 名称都是程序内的静态字符串, 只需处理引号和反斜杠
+static QByteArray jsonString(const char *str){
+    QByteArray result = "\"";
+    for(const char *p = str; *p; p++){
+        if(*p == '"' || *p == '\\'){
+            result.append('\\');
+        }
+        result.append(*p);
+    }
+    result.append('"');
+    return result;
+}
+
+// ns 转为 trace 使用的 us
+static QByteArray microseconds(qint64 ns){
+    return QByteArray::number(ns / 1000.0, 'f', 3);
+}
+
+bool Tracer::writeJson(const QString &filePath){
+    QMutexLocker writeLocker(&s_writeMutex);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    // 开始时读取每个缓冲区的写入位置, 只导出这之前的事件, 之后写入的不导出
+    QList<TraceBuffer *> buffers;
+    QList<quint64> ends;
+    {
+        QMutexLocker locker(&s_buffersMutex);
+        buffers = s_buffers;
+    }
+    for(TraceBuffer *buffer : buffers){
+        ends.append(buffer->writeIndex.load(std::memory_order_acquire));
+    }
+
+    // 时间从最早的事件开始
+    qint64 baseTime = -1;
+    for(int b = 0; b < buffers.size(); b++){
+        quint64 end = ends[b];
+        quint64 begin = end > quint64(BUFFER_SIZE) ? end - BUFFER_SIZE : 0;
+        TraceEvent event;
+        for(quint64 i = begin; i < end; i++){
+            // 最早的几个可能已被覆盖, 取第一个完整的事件
+            if(readEvent(buffers[b], i, &event)){
+                if(baseTime < 0 || event.ts < baseTime){
+                    baseTime = event.ts;
+                }
+                break;
+            }
+        }
+    }
+    if(baseTime < 0){
+        baseTime = 0;
+    }
+
+    file.write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+    QByteArray line;
+    for(int b = 0; b < buffers.size(); b++){
+        const TraceBuffer *buffer = buffers[b];
+        QByteArray tid = QByteArray::number(buffer->tid);
+
+        // 线程名称
+        const char *threadName = buffer->threadName.load(std::memory_order_acquire);
+        if(threadName){
+            line = (first ? "" : ",\n");
+            line.append("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":").append(tid)
+                .append(",\"args\":{\"name\":").append(jsonString(threadName)).append("}}");
+            file.write(line);
+            first = false;
+        }
+
+        quint64 end = ends[b];
+        quint64 begin = end > quint64(BUFFER_SIZE) ? end - BUFFER_SIZE : 0;
+        TraceEvent event;
+        for(quint64 i = begin; i < end; i++){
+            if(!readEvent(buffer, i, &event)){
+                continue;
+            }
+
+            line = (first ? "" : ",\n");
+            line.append("{\"ph\":\"").append(event.phase).append("\",\"name\":").append(jsonString(event.name))
+                .append(",\"pid\":1,\"tid\":").append(tid)
+                .append(",\"ts\":").append(microseconds(event.ts - baseTime));
+            if(event.phase == 'X'){
+                line.append(",\"dur\":").append(microseconds(event.dur));
+            }else{
+                line.append(",\"s\":\"t\"");
+            }
+            if(event.argName1){
+                line.append(",\"args\":{").append(jsonString(event.argName1)).append(":").append(QByteArray::number(event.arg1));
+                if(event.argName2){
+                    line.append(",").append(jsonString(event.argName2)).append(":").append(QByteArray::number(event.arg2));
+                }
+                line.append("}");
+            }
+            line.append("}");
+            file.write(line);
+            first = false;
+        }
+    }
+
+    file.write("\n]}\n");
+    return true;
+}
+
+void Tracer::start(const QString &filePath){
+    s_outputFile = filePath;
+    setEnabled(true);
+}
+
+bool Tracer::flush(){
+    if(!isEnabled() || s_outputFile.isEmpty()){
+        return false;
+    }
+    return writeJson(s_outputFile);
+}
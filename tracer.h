@@ -0,0 +1,79 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+
+// 记录录制和播放过程的时间线, 导出为 Chrome trace-event json, 可用 Perfetto 或 chrome://tracing 查看
+// 每个线程使用预先分配的环形缓冲区, 写入时不加锁不分配内存, 缓冲区满后覆盖最早的事件
+// 线程结束后缓冲区留给之后创建的线程使用, 频繁创建线程时缓冲区数不会一直增加
+// 未启用时每个记录点只有一次原子读取
+class Tracer
+{
+public:
+    // 每个线程缓冲区的事件数, 必须是2的幂
+    static constexpr int BUFFER_SIZE = 1 << 16;
+
+    static void setEnabled(bool val) { s_enabled.store(val, std::memory_order_release); }
+    static bool isEnabled() { return s_enabled.load(std::memory_order_acquire); }
+
+    // 当前时间 ns, 所有线程共用同一时钟
+    static qint64 now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 设置当前线程在时间线上显示的名称, name 必须是静态字符串
+    static void setThreadName(const char *name);
+
+    // 记录一段时间 [start, end], 名称和参数名必须是静态字符串
+    static void complete(const char *name, qint64 start, qint64 end,
+                         const char *argName1 = nullptr, qint64 arg1 = 0,
+                         const char *argName2 = nullptr, qint64 arg2 = 0);
+    // 记录一个时间点
+    static void instant(const char *name, const char *argName1 = nullptr, qint64 arg1 = 0);
+
+    // 将所有线程缓冲区中的事件写入文件, 可在任意线程调用, 多个线程同时调用时依次写入
+    // 导出时其它线程仍可继续记录, 正在写入或已被覆盖的事件跳过
+    static bool writeJson(const QString &filePath);
+
+    // 启用跟踪并设置输出文件, 在启动时调用
+    static void start(const QString &filePath);
+    // 写入输出文件, 未启用时不做任何事
+    static bool flush();
+
+private:
+    static std::atomic<bool> s_enabled;
+    static QString s_outputFile;
+};
+
+// 记录一个作用域的耗时
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, const char *argName = nullptr, qint64 arg = 0)
+        : m_name(Tracer::isEnabled() ? name : nullptr)
+        , m_argName(argName)
+        , m_arg(arg)
+        , m_start(m_name ? Tracer::now() : 0)
+    {
+    }
+
+    ~TraceScope(){
+        if(m_name){
+            Tracer::complete(m_name, m_start, Tracer::now(), m_argName, m_arg);
+        }
+    }
+
+    void setArg(qint64 arg) { m_arg = arg; }
+
+private:
+    const char *m_name;
+    const char *m_argName;
+    qint64 m_arg;
+    qint64 m_start;
+};
+
+#endif // TRACER_H
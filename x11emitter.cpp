@@ -0,0 +1,369 @@
+#include "x11emitter.h"
+#include "key_map.h"
+#include "tracer.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <iterator>
+
+// Xlib 的宏(Bool、Status 等)会与 Qt 冲突, 放在所有 Qt 头文件之后
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+// 扫描码对应的 Linux evdev 按键码, X 服务器使用 evdev 键码时键码为其加8
+// 0x01-0x58 与 evdev 相同, 扩展键的扫描码为 0x80 加原扫描码, 需要逐个对应
+// 日文键盘的 ^ @ : (0x90-0x92) 没有固定的 evdev 按键, 按键盘布局查找键码时结果随布局变化, 不对应, 计入未对应的按键
+static int evdevCode(int scanCode){
+    if(scanCode > 0 && scanCode <= 0x58){
+        return scanCode;
+    }
+
+    switch(scanCode){
+    case 0x64: return 183;// F13
+    case 0x65: return 184;// F14
+    case 0x66: return 185;// F15
+    case 0x7D: return 124;// 日文键盘 ¥
+    case 0x8D: return 117;// 小键盘 =
+    case 0x93: return 89;// 日文键盘 _
+    case 0x9C: return 96;// 小键盘 Enter
+    case 0x9D: return 97;// 右 Ctrl
+    case 0xB3: return 121;// 小键盘 ,
+    case 0xB5: return 98;// 小键盘 /
+    case 0xB7: return 99;// Sys Rq
+    case 0xB8: return 100;// 右 Alt
+    case 0xC5: return 119;// Pause
+    case 0xC7: return 102;// Home
+    case 0xC8: return 103;// ↑
+    case 0xC9: return 104;// Page Up
+    case 0xCB: return 105;// ←
+    case 0xCD: return 106;// →
+    case 0xCF: return 107;// End
+    case 0xD0: return 108;// ↓
+    case 0xD1: return 109;// Page Down
+    case 0xD2: return 110;// Insert
+    case 0xD3: return 111;// Delete
+    case 0xDB: return 125;// 左 Windows
+    case 0xDC: return 126;// 右 Windows
+    case 0xDD: return 127;// Menu
+    case 0xDE: return 116;// Power
+    case 0xDF: return 142;// Sleep
+    default: return 0;
+    }
+}
+
+// X 按键序号在 XQueryPointer 返回的状态中的位, 侧键没有状态位
+static unsigned int buttonMask(unsigned int button){
+    switch(button){
+    case 1: return Button1Mask;
+    case 2: return Button2Mask;
+    case 3: return Button3Mask;
+    default: return 0;
+    }
+}
+
+X11Emitter::~X11Emitter(){
+    restorePointerAcceleration();
+    if(m_display){
+        // 关闭连接时会送出缓冲区中的操作
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+    }
+}
+
+bool X11Emitter::open(const QString &displayName, QString *errorMsg){
+    if(m_display){
+        return true;
+    }
+
+    QByteArray name = displayName.toLocal8Bit();
+    m_display = XOpenDisplay(displayName.isEmpty() ? nullptr : name.constData());
+    if(!m_display){
+        if(errorMsg){
+            *errorMsg = "无法连接 X 服务器:" + (displayName.isEmpty() ? qEnvironmentVariable("DISPLAY") : displayName);
+        }
+        return false;
+    }
+
+    int eventBase, errorBase, majorVersion, minorVersion;
+    if(!XTestQueryExtension(m_display, &eventBase, &errorBase, &majorVersion, &minorVersion)){
+        XCloseDisplay(m_display);
+        m_display = nullptr;
+        if(errorMsg){
+            *errorMsg = "X 服务器不支持 XTest 扩展";
+        }
+        return false;
+    }
+
+    // 屏幕大小只读取一次, 绝对移动时不再查询
+    m_screen = DefaultScreen(m_display);
+    m_root = RootWindow(m_display, m_screen);
+    m_screenWidth = DisplayWidth(m_display, m_screen);
+    m_screenHeight = DisplayHeight(m_display, m_screen);
+
+    // 按键表中的扫描码一次全部转换为键码, 超出服务器键码范围的按键不发送
+    int minKeycode, maxKeycode;
+    XDisplayKeycodes(m_display, &minKeycode, &maxKeycode);
+    std::fill(std::begin(m_keycodes), std::end(m_keycodes), 0);
+    m_unmappedKeys = 0;
+    for(const KeyInfo &key : KEYBOARD_KEYS){
+        int evdev = evdevCode(key.code);
+        int keycode = evdev > 0 ? evdev + 8 : 0;
+        if(keycode == 0 || keycode < minKeycode || keycode > maxKeycode){
+            m_unmappedKeys++;
+            continue;
+        }
+        m_keycodes[key.code & 0xFF] = (unsigned char)keycode;
+    }
+
+    // 其它客户端抓取服务器时仍可发送
+    XTestGrabControl(m_display, True);
+    m_queued = 0;
+    return true;
+}
+
+void X11Emitter::disablePointerAcceleration(){
+    if(!m_display || m_accelerationSaved){
+        return;
+    }
+
+    XGetPointerControl(m_display, &m_accelNumerator, &m_accelDenominator, &m_accelThreshold);
+    m_accelerationSaved = true;
+    XChangePointerControl(m_display, True, False, 1, 1, m_accelThreshold);
+    // 修改在之后的移动之前生效
+    XSync(m_display, False);
+}
+
+void X11Emitter::restorePointerAcceleration(){
+    if(!m_display || !m_accelerationSaved){
+        return;
+    }
+
+    XChangePointerControl(m_display, True, False, m_accelNumerator, m_accelDenominator, m_accelThreshold);
+    XSync(m_display, False);
+    m_accelerationSaved = false;
+}
+
+bool X11Emitter::getCursorPos(int *x, int *y){
+    if(!m_display){
+        return false;
+    }
+
+    // 查询会先送出缓冲区中的操作, 读到的是已发送操作之后的位置
+    Window root, child;
+    int rootX, rootY, winX, winY;
+    unsigned int mask;
+    if(!XQueryPointer(m_display, m_root, &root, &child, &rootX, &rootY, &winX, &winY, &mask)){
+        return false;
+    }
+
+    *x = rootX;
+    *y = rootY;
+    return true;
+}
+
+void X11Emitter::flush(){
+    if(!m_display || m_queued == 0){
+        return;
+    }
+
+    TraceScope scope("x11Flush", "count", m_queued);
+    if(m_sync){
+        XSync(m_display, False);
+    }else{
+        XFlush(m_display);
+    }
+    m_queued = 0;
+    m_flushCount++;
+}
+
+unsigned int X11Emitter::buttonOf(short mouseVK){
+    switch(mouseVK){
+    case 0x01: return 1;// 左键
+    case 0x02: return 3;// 右键
+    case 0x04: return 2;// 中键
+    case 0x05: return 8;// 侧键1（后退）
+    case 0x06: return 9;// 侧键2（前进）
+    default: return 0;
+    }
+}
+
+void X11Emitter::sendKey(short scanCode, bool isKeyRelease){
+    unsigned char keycode = keycodeOf(scanCode);
+    if(!m_display || keycode == 0){
+        return;
+    }
+
+    XTestFakeKeyEvent(m_display, keycode, isKeyRelease ? False : True, CurrentTime);
+    m_queued++;
+}
+
+void X11Emitter::sendMouseButton(short mouseVK, bool isKeyRelease){
+    unsigned int button = buttonOf(mouseVK);
+    if(!m_display || button == 0){
+        return;
+    }
+
+    XTestFakeButtonEvent(m_display, button, isKeyRelease ? False : True, CurrentTime);
+    m_queued++;
+}
+
+void X11Emitter::sendMouseMove(int dx, int dy){
+    if(!m_display){
+        return;
+    }
+
+    XTestFakeRelativeMotionEvent(m_display, dx, dy, CurrentTime);
+    m_queued++;
+}
+
+void X11Emitter::sendMouseMoveTo(int x, int y){
+    if(!m_display){
+        return;
+    }
+
+    // 使用连接时读取的屏幕大小
+    x = qBound(0, x, m_screenWidth - 1);
+    y = qBound(0, y, m_screenHeight - 1);
+    XTestFakeMotionEvent(m_display, m_screen, x, y, CurrentTime);
+    m_queued++;
+}
+
+bool X11Emitter::isKeyDown(unsigned char keycode){
+    char keys[32];
+    XQueryKeymap(m_display, keys);
+    return (keys[keycode / 8] >> (keycode % 8)) & 1;
+}
+
+bool X11Emitter::selfTest(QString *report, QString *errorMsg){
+    if(!m_display){
+        if(errorMsg){
+            *errorMsg = "未连接 X 服务器";
+        }
+        return false;
+    }
+
+    // 每个按键按下后服务器中为按下状态, 松开后为松开状态
+    int keyCount = 0, keyOk = 0;
+    QStringList failedKeys;
+    for(const KeyInfo &key : KEYBOARD_KEYS){
+        unsigned char keycode = keycodeOf(key.code);
+        if(keycode == 0){
+            continue;
+        }
+        keyCount++;
+
+        simulateKeyPress(key.code, false);
+        flush();
+        bool down = isKeyDown(keycode);
+        simulateKeyPress(key.code, true);
+        flush();
+        bool up = !isKeyDown(keycode);
+
+        if(down && up){
+            keyOk++;
+        }else{
+            failedKeys.append(QString::fromUtf16(key.name));
+        }
+    }
+
+    // 侧键没有状态位, 只检查左、中、右键
+    int buttonCount = 0, buttonOk = 0;
+    for(const KeyInfo &button : MOUSE_BUTTONS){
+        unsigned int mask = buttonMask(buttonOf(button.code));
+        if(mask == 0){
+            continue;
+        }
+        buttonCount++;
+
+        Window root, child;
+        int rootX, rootY, winX, winY;
+        unsigned int downState = 0, upState = 0;
+        simulateMouseAction(button.code, false);
+        flush();
+        XQueryPointer(m_display, m_root, &root, &child, &rootX, &rootY, &winX, &winY, &downState);
+        simulateMouseAction(button.code, true);
+        flush();
+        XQueryPointer(m_display, m_root, &root, &child, &rootX, &rootY, &winX, &winY, &upState);
+
+        if((downState & mask) && !(upState & mask)){
+            buttonOk++;
+        }else{
+            failedKeys.append(QString::fromUtf16(button.name));
+        }
+    }
+
+    // 绝对移动: 四角、中心和超出屏幕的位置, 超出时停在边缘
+    struct MoveCase { int x, y, expectX, expectY; };
+    const int right = m_screenWidth - 1, bottom = m_screenHeight - 1;
+    const MoveCase moves[] = {
+        {0, 0, 0, 0},
+        {right, bottom, right, bottom},
+        {right, 0, right, 0},
+        {0, bottom, 0, bottom},
+        {m_screenWidth / 2, m_screenHeight / 2, m_screenWidth / 2, m_screenHeight / 2},
+        {-50, m_screenHeight + 50, 0, bottom},
+    };
+    int moveOk = 0;
+    for(const MoveCase &move : moves){
+        int x = -1, y = -1;
+        simulateMouseAbsolutelyMove(move.x, move.y);
+        flush();
+        if(getCursorPos(&x, &y) && x == move.expectX && y == move.expectY){
+            moveOk++;
+        }
+    }
+
+    // 相对移动: 从中心连续小幅移动几次后一起送出, 以及一次远超加速阈值的大幅移动
+    // 检查期间关闭指针加速, 与播放时相同
+    bool restoreAcceleration = !m_accelerationSaved;
+    disablePointerAcceleration();
+
+    struct RelativeCase { int steps, stepX, stepY; };
+    const RelativeCase relativeMoves[] = {
+        {4, 3, -2},
+        {1, qMin(200, m_screenWidth / 2 - 1), -qMin(150, m_screenHeight / 2 - 1)},
+    };
+    int relativeOk = 0;
+    QStringList relativeErrors;
+    for(const RelativeCase &move : relativeMoves){
+        int startX = m_screenWidth / 2, startY = m_screenHeight / 2;
+        simulateMouseAbsolutelyMove(startX, startY);
+        for(int i = 0; i < move.steps; i++){
+            simulateMouseRelativeMove(move.stepX, move.stepY);
+        }
+        flush();
+
+        int endX = -1, endY = -1;
+        if(getCursorPos(&endX, &endY) && endX == startX + move.steps * move.stepX && endY == startY + move.steps * move.stepY){
+            relativeOk++;
+        }else{
+            relativeErrors.append(QString("(%1,%2) 移动为 (%3,%4)").arg(move.steps * move.stepX).arg(move.steps * move.stepY)
+                                      .arg(endX - startX).arg(endY - startY));
+        }
+    }
+
+    if(restoreAcceleration){
+        restorePointerAcceleration();
+    }
+
+    if(report){
+        *report = QString("屏幕 %1x%2, 未对应键码的按键 %3 个\n").arg(m_screenWidth).arg(m_screenHeight).arg(m_unmappedKeys);
+        *report += QString("按键 %1/%2, 鼠标按键 %3/%4, 绝对移动 %5/%6, 相对移动 %7/%8\n")
+                       .arg(keyOk).arg(keyCount).arg(buttonOk).arg(buttonCount)
+                       .arg(moveOk).arg(int(std::size(moves)))
+                       .arg(relativeOk).arg(int(std::size(relativeMoves)));
+        if(!failedKeys.isEmpty()){
+            *report += "状态不一致: " + failedKeys.join(", ") + "\n";
+        }
+        if(!relativeErrors.isEmpty()){
+            *report += "相对移动不一致: " + relativeErrors.join(", ") + "\n";
+        }
+    }
+
+    bool ok = keyOk == keyCount && buttonOk == buttonCount && moveOk == int(std::size(moves)) && relativeOk == int(std::size(relativeMoves));
+    if(!ok && errorMsg){
+        *errorMsg = "X 服务器中的状态与发送的操作不一致";
+    }
+    return ok;
+}
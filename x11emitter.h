@@ -0,0 +1,88 @@
+#ifndef X11EMITTER_H
+#define X11EMITTER_H
+
+#include "inputemitter.h"
+
+#include <QString>
+
+// 不在头文件中包含 Xlib, 避免其宏与 Qt 冲突
+struct _XDisplay;
+
+// 通过 XTest 扩展发送到 X 服务器, 用于不能使用 uinput 的 Linux 桌面, 也可以发送到 Xvfb
+// 操作先写入 Xlib 的发送缓冲区, 在 flush 时一次送出, 同一时刻到期的操作只需要一次系统调用
+class X11Emitter : public InputEmitter
+{
+public:
+    X11Emitter() = default;
+    // 恢复指针加速设置, 送出排队中的操作并关闭连接
+    ~X11Emitter() override;
+
+    X11Emitter(const X11Emitter &) = delete;
+    X11Emitter &operator=(const X11Emitter &) = delete;
+
+    // 连接 X 服务器, displayName 为空时使用 DISPLAY 环境变量
+    // 连接时把扫描码转换为键码, 并读取屏幕大小, 之后发送时不再查询
+    bool open(const QString &displayName = QString(), QString *errorMsg = nullptr);
+    bool isOpen() const { return m_display != nullptr; }
+
+    // flush 时等待服务器处理完(XSync), 默认只写出(XFlush)
+    void setSync(bool val) { m_sync = val; }
+
+    // 相对移动会被服务器按指针加速放大, 播放期间把加速设为 1/1, 移动量与录制一致
+    // 保存原来的设置, restorePointerAcceleration 或析构时恢复
+    void disablePointerAcceleration();
+    void restorePointerAcceleration();
+
+    const char *backendName() const override { return "x11"; }
+    bool getCursorPos(int *x, int *y) override;
+    void flush() override;
+
+    // 送出的次数, 与发送的操作数比较可看出合并的效果
+    qint64 flushCount() const { return m_flushCount; }
+
+    // 没有对应键码的按键数, 这些按键不会发送
+    int unmappedKeyCount() const { return m_unmappedKeys; }
+    int screenWidth() const { return m_screenWidth; }
+    int screenHeight() const { return m_screenHeight; }
+
+    // 发送按键、鼠标按键和移动, 再从服务器读回状态检查是否一致
+    // 会移动鼠标并按下松开所有按键, 只应在 Xvfb 等测试用的服务器上运行
+    bool selfTest(QString *report, QString *errorMsg = nullptr);
+
+protected:
+    void sendKey(short scanCode, bool isKeyRelease) override;
+    void sendMouseButton(short mouseVK, bool isKeyRelease) override;
+    void sendMouseMove(int dx, int dy) override;
+    void sendMouseMoveTo(int x, int y) override;
+
+private:
+    // 鼠标按键虚拟键码对应的 X 按键序号, 无效的按键返回0
+    static unsigned int buttonOf(short mouseVK);
+    // 扫描码对应的键码, 0表示没有
+    unsigned char keycodeOf(short scanCode) const { return m_keycodes[scanCode & 0xFF]; }
+    // 读取服务器中按键是否按下
+    bool isKeyDown(unsigned char keycode);
+
+    _XDisplay *m_display = nullptr;
+    int m_screen = 0;
+    unsigned long m_root = 0;
+    int m_screenWidth = 0;
+    int m_screenHeight = 0;
+
+    // 扫描码 -> 键码, 连接时生成
+    unsigned char m_keycodes[256] = {};
+    int m_unmappedKeys = 0;
+
+    // 修改前的指针加速设置
+    bool m_accelerationSaved = false;
+    int m_accelNumerator = 0;
+    int m_accelDenominator = 0;
+    int m_accelThreshold = 0;
+
+    // 上次 flush 后写入缓冲区的操作数, 没有时 flush 不做任何事
+    int m_queued = 0;
+    qint64 m_flushCount = 0;
+    bool m_sync = false;
+};
+
+#endif // X11EMITTER_H